@@ -1,11 +1,7 @@
 #!/bin/sh
 . ./functions/global.sh
 CPWD=`pwd`
-cd objects/formatter/
-ensure `./rebuildll.sh`
-cd ../speller
-ensure `./rebuildll.sh`
-cd ../stripper
-ensure `./rebuildll.sh`
+cd objects/
+ensure `make install`
 cd "$CPWD"
 exit 0
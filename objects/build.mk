@@ -0,0 +1,47 @@
+# Compiler settings shared by the native libraries and their tools.
+# Choose the kind of build with BUILD=
+#   release  optimised with link-time optimisation across all the sources
+#            compiled in, including the bundled expat and cJSON (default)
+#   checked  address and undefined-behaviour sanitizers; a JVM loading
+#            the libraries needs LD_PRELOAD=$(gcc -print-file-name=libasan.so)
+#   debug    -O0 -g3, as rebuildll.sh builds
+#   pgo-gen  instrumented to record a profile in $(PGO_DIR)
+#   pgo-use  release, optimised with the profile in $(PGO_DIR)
+# "make pgo" in this directory runs the benchmarks to make the profile.
+BUILD ?= release
+TOP := $(dir $(lastword $(MAKEFILE_LIST)))
+PREFIX ?= /usr/local
+# where the profile of each library is kept, by source file name
+PGO_NAME ?= $(notdir $(CURDIR))
+PGO_DIR ?= $(abspath $(TOP))/pgo-data/$(PGO_NAME)
+ifeq ($(BUILD),release)
+OPTFLAGS = -O2 -g -flto=auto
+else ifeq ($(BUILD),checked)
+OPTFLAGS = -O1 -g3 -fno-omit-frame-pointer -fsanitize=address,undefined
+else ifeq ($(BUILD),debug)
+OPTFLAGS = -O0 -g3
+else ifeq ($(BUILD),pgo-gen)
+OPTFLAGS = -O2 -g -fprofile-generate -fprofile-update=atomic \
+	-dumpdir $(PGO_DIR)/
+else ifeq ($(BUILD),pgo-use)
+# the benchmarks are built with other defines than the libraries, so
+# functions that differ between them are compiled without a profile
+OPTFLAGS = -O2 -g -flto=auto -fprofile-use -fprofile-partial-training \
+	-fprofile-correction -Wno-coverage-mismatch -Wno-missing-profile \
+	-dumpdir $(PGO_DIR)/
+else
+$(error BUILD must be release, checked, debug, pgo-gen or pgo-use)
+endif
+CFLAGS += $(OPTFLAGS) -Wall
+LDFLAGS += $(OPTFLAGS)
+ifeq ($(shell uname),Darwin)
+LIBSUFFIX = dylib
+JDKINCLUDEDIRNAME = Headers
+else
+LIBSUFFIX = so
+JDKINCLUDEDIRNAME = include
+endif
+JAVAC := $(shell which javac 2>/dev/null)
+JAVA_HOME ?= $(if $(JAVAC),$(shell dirname $$(dirname $$(readlink -f $(JAVAC)))))
+JDKINC ?= $(JAVA_HOME)/$(JDKINCLUDEDIRNAME)
+JNIFLAGS = -DJNI -I$(JDKINC) -I$(JDKINC)/linux -I$(JDKINC)/darwin -fPIC -shared
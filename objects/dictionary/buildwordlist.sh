@@ -0,0 +1,3 @@
+# build the word list compiler in the current directory
+gcc -DWORDLIST_TOOL -Iinclude -O2 -Wall -o wordlist src/wordlist_tool.c \
+  src/wordlist.c
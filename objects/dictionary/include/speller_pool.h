@@ -0,0 +1,26 @@
+/* 
+ * File:   speller_pool.h
+ * Author: desmond
+ *
+ * Process-wide pools of aspell spellers, one pool per language, shared
+ * by libAeseStripper and libAeseSpeller
+ */
+
+#ifndef SPELLER_POOL_H
+#define	SPELLER_POOL_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+typedef struct speller_struct speller;
+speller *speller_pool_checkout( const char *language );
+void speller_pool_checkin( speller *s );
+int speller_check( speller *s, const char *word, int len );
+int speller_is_hh_exception( speller *s, const char *word, int len );
+int speller_pool_prewarm( const char **languages, int n );
+void speller_pool_clear();
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* SPELLER_POOL_H */
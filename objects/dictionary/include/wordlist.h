@@ -0,0 +1,28 @@
+/* 
+ * File:   wordlist.h
+ * Author: desmond
+ *
+ * A compiled, memory-mapped list of the words in a language
+ */
+
+#ifndef WORDLIST_H
+#define	WORDLIST_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+/** the word is in the list */
+#define WORDLIST_WORD 1
+/** the word is a hard-hyphen exception */
+#define WORDLIST_HH_EXCEPTION 2
+typedef struct wordlist_struct wordlist;
+wordlist *wordlist_open( const char *path );
+void wordlist_close( wordlist *wl );
+int wordlist_lookup( wordlist *wl, const char *word, int len );
+int wordlist_size( wordlist *wl );
+int wordlist_compile( FILE *words, FILE *excepts, const char *path );
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* WORDLIST_H */
@@ -0,0 +1,14 @@
+if [ $USER = "root" ]; then
+  if [ `uname` = "Darwin" ]; then
+    LIBSUFFIX="dylib"
+  else
+    LIBSUFFIX="so"
+  fi
+  gcc -c -Iinclude -O0 -Wall -g3 -fPIC src/*.c
+  gcc *.o -shared -laspell -lpthread -o libAeseDictionary.$LIBSUFFIX
+  cp libAeseDictionary.$LIBSUFFIX /usr/local/lib
+  rm libAeseDictionary.$LIBSUFFIX
+  rm *.o
+else
+	echo "Need to be root. Did you use sudo?"
+fi
@@ -0,0 +1,416 @@
+/* This file is part of dictionary.
+ *
+ *  dictionary is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dictionary is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dictionary.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "aspell.h"
+#include "wordlist.h"
+#include "speller_pool.h"
+/** the most languages we keep spellers for */
+#define MAX_POOLS 64
+/** the most spellers per language */
+#define MAX_POOL_SIZE 32
+/** where compiled word lists are found, overridden by AESE_WORDLISTS */
+#define WORDLIST_DIR "/usr/local/share/aese"
+/** one aspell speller, used by one thread at a time */
+struct speller_struct
+{
+    AspellSpeller *spell_checker;
+    AspellConfig *spell_config;
+    /** its index in its pool */
+    int slot;
+    /** the pool it belongs to */
+    struct pool_struct *owner;
+};
+/**
+ * Loading a dictionary is slow and big, so spellers are kept for the 
+ * life of the process and shared by every library that links to this 
+ * one: the stripper lends them to each strip and the speller to each 
+ * check. Spellers are created on first checkout, up to one per core.
+ */
+typedef struct pool_struct pool;
+struct pool_struct
+{
+    char *lang;
+    /** 1 if there is no dictionary for the language, so lookups fail */
+    int missing;
+    int size;
+    speller *members[MAX_POOL_SIZE];
+    int busy[MAX_POOL_SIZE];
+    /** the compiled word list for the language or NULL */
+    wordlist *words;
+    /** the number of threads waiting for a speller */
+    int waiting;
+    pthread_mutex_t lock;
+    pthread_cond_t freed;
+};
+/** pools by hash of language, published once and read without locking */
+static pool *pools[MAX_POOLS];
+/** serialises the loading of dictionaries so each is loaded only once */
+static pthread_mutex_t pools_lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * Dispose of a speller
+ * @param s the speller
+ */
+static void speller_dispose( speller *s )
+{
+    if ( s->spell_config != NULL )
+        delete_aspell_config( s->spell_config );
+    if ( s->spell_checker != NULL )
+        delete_aspell_speller( s->spell_checker );
+    free( s );
+}
+/**
+ * Create a speller for a language
+ * @param language the language code e.g. en_GB
+ * @return the speller or NULL
+ */
+static speller *speller_create( const char *language )
+{
+    int err = 0;
+    speller *s = calloc( 1, sizeof(speller) );
+    if ( s != NULL )
+    {
+        s->spell_config = new_aspell_config();
+        if ( s->spell_config != NULL )
+        {
+            AspellCanHaveError *possible_err;
+            aspell_config_replace( s->spell_config, "lang", language );
+            possible_err = new_aspell_speller( s->spell_config );
+            if ( aspell_error_number(possible_err) != 0 )
+            {
+                fprintf(stderr,"%s\n",aspell_error_message(possible_err));
+                delete_aspell_can_have_error( possible_err );
+                err = 1;
+            }
+            else
+            {
+                s->spell_checker = to_aspell_speller( possible_err );
+                if ( s->spell_checker == NULL )
+                {
+                    fprintf(stderr,"speller: failed to initialise speller\n");
+                    err = 1;
+                }
+            }
+        }
+        else
+        {
+            fprintf(stderr,"speller: failed to create config\n");
+            err = 1;
+        }
+        if ( err )
+        {
+            speller_dispose( s );
+            s = NULL;
+        }
+    }
+    else
+        fprintf(stderr,"speller: failed to allocate object\n");
+    return s;
+}
+/**
+ * Dispose of a pool and all its spellers
+ * @param p the pool, which must not be in use
+ */
+static void pool_dispose( pool *p )
+{
+    int i;
+    for ( i=0;i<MAX_POOL_SIZE;i++ )
+        if ( p->members[i] != NULL )
+            speller_dispose( p->members[i] );
+    if ( p->words != NULL )
+        wordlist_close( p->words );
+    if ( p->lang != NULL )
+        free( p->lang );
+    pthread_cond_destroy( &p->freed );
+    pthread_mutex_destroy( &p->lock );
+    free( p );
+}
+/**
+ * Map the compiled word list for a language, if there is one
+ * @param language the language code
+ * @return the word list or NULL
+ */
+static wordlist *pool_open_wordlist( const char *language )
+{
+    char path[FILENAME_MAX];
+    const char *dir = getenv( "AESE_WORDLISTS" );
+    snprintf( path, FILENAME_MAX, "%s/%s.awl", (dir==NULL)?WORDLIST_DIR:dir, 
+        language );
+    return wordlist_open( path );
+}
+/**
+ * Create a pool for a language and load its dictionary. If there is no 
+ * dictionary the pool is kept anyway, marked missing, so that later 
+ * lookups for the language fail without trying to load it again.
+ * @param language the language code
+ * @return the pool or NULL if it couldn't be allocated
+ */
+static pool *pool_create( const char *language )
+{
+    pool *p = calloc( 1, sizeof(pool) );
+    if ( p != NULL )
+    {
+        long ncores = sysconf( _SC_NPROCESSORS_ONLN );
+        p->size = (ncores<1)?1:(ncores>MAX_POOL_SIZE)?MAX_POOL_SIZE:ncores;
+        pthread_mutex_init( &p->lock, NULL );
+        pthread_cond_init( &p->freed, NULL );
+        p->lang = strdup( language );
+        if ( p->lang == NULL )
+        {
+            pool_dispose( p );
+            p = NULL;
+        }
+        else
+        {
+            p->members[0] = speller_create( language );
+            if ( p->members[0] != NULL )
+                p->words = pool_open_wordlist( language );
+            else
+            {
+                fprintf(stderr,"speller: no dict for language %s\n",
+                    language);
+                p->missing = 1;
+            }
+        }
+    }
+    if ( p == NULL )
+        fprintf(stderr,"speller: failed to create pool\n");
+    return p;
+}
+/**
+ * Hash a language code
+ * @param language the language code
+ * @return its first slot in the pool table
+ */
+static unsigned pool_hash( const char *language )
+{
+    unsigned h = 5381;
+    while ( *language )
+        h = h*33 + (unsigned char)*language++;
+    return h % MAX_POOLS;
+}
+/**
+ * Find the pool for a language, loading it if need be. Lookups don't 
+ * lock, even for languages with no dictionary. A thread that asks for a 
+ * language while it is being loaded, e.g. by the prewarm thread, waits 
+ * on pools_lock for that load to finish rather than starting its own.
+ * @param language the language code
+ * @return the pool or NULL if there is no dictionary for the language
+ */
+static pool *pool_find( const char *language )
+{
+    unsigned i,h = pool_hash( language );
+    pool *p = NULL;
+    for ( i=0;i<MAX_POOLS;i++ )
+    {
+        p = __atomic_load_n( &pools[(h+i)%MAX_POOLS], __ATOMIC_ACQUIRE );
+        if ( p == NULL || strcmp(p->lang,language)==0 )
+            break;
+    }
+    if ( p == NULL )
+    {
+        pthread_mutex_lock( &pools_lock );
+        for ( i=0;i<MAX_POOLS;i++ )
+        {
+            pool **slot = &pools[(h+i)%MAX_POOLS];
+            p = *slot;
+            if ( p == NULL )
+            {
+                p = pool_create( language );
+                if ( p != NULL )
+                    __atomic_store_n( slot, p, __ATOMIC_RELEASE );
+                break;
+            }
+            else if ( strcmp(p->lang,language)==0 )
+                break;
+        }
+        if ( i == MAX_POOLS )
+        {
+            fprintf(stderr,"speller: too many languages\n");
+            p = NULL;
+        }
+        pthread_mutex_unlock( &pools_lock );
+    }
+    return (p==NULL||p->missing)?NULL:p;
+}
+/**
+ * Try to claim an idle speller, making it if it doesn't exist yet. A 
+ * slot whose speller can't be made stays busy so it isn't tried again.
+ * @param p the pool
+ * @return the claimed speller or NULL if all are busy
+ */
+static speller *pool_claim( pool *p )
+{
+    int i;
+    for ( i=0;i<p->size;i++ )
+    {
+        int idle = 0;
+        if ( !__atomic_load_n(&p->busy[i],__ATOMIC_RELAXED) 
+            && __atomic_compare_exchange_n(&p->busy[i],&idle,1,0,
+            __ATOMIC_SEQ_CST,__ATOMIC_RELAXED) )
+        {
+            if ( p->members[i] == NULL )
+            {
+                p->members[i] = speller_create( p->lang );
+                if ( p->members[i] == NULL )
+                    continue;
+            }
+            p->members[i]->slot = i;
+            p->members[i]->owner = p;
+            return p->members[i];
+        }
+    }
+    return NULL;
+}
+/**
+ * Borrow a speller for a language, waiting if they are all in use
+ * @param language the language code e.g. en_GB
+ * @return the speller, which must be checked in again, or NULL if there 
+ * is no dictionary for the language
+ */
+speller *speller_pool_checkout( const char *language )
+{
+    speller *s = NULL;
+    pool *p = pool_find( language );
+    if ( p != NULL )
+    {
+        s = pool_claim( p );
+        if ( s == NULL )
+        {
+            pthread_mutex_lock( &p->lock );
+            __atomic_add_fetch( &p->waiting, 1, __ATOMIC_SEQ_CST );
+            while ( (s=pool_claim(p)) == NULL )
+                pthread_cond_wait( &p->freed, &p->lock );
+            __atomic_sub_fetch( &p->waiting, 1, __ATOMIC_SEQ_CST );
+            pthread_mutex_unlock( &p->lock );
+        }
+    }
+    return s;
+}
+/**
+ * Return a speller to its pool
+ * @param s the speller from speller_pool_checkout
+ */
+void speller_pool_checkin( speller *s )
+{
+    pool *p = s->owner;
+    __atomic_store_n( &p->busy[s->slot], 0, __ATOMIC_SEQ_CST );
+    if ( __atomic_load_n(&p->waiting,__ATOMIC_SEQ_CST) > 0 )
+    {
+        pthread_mutex_lock( &p->lock );
+        pthread_cond_signal( &p->freed );
+        pthread_mutex_unlock( &p->lock );
+    }
+}
+/**
+ * Is a word in the dictionary?
+ * @param s the checked out speller
+ * @param word the word in UTF-8
+ * @param len its length in bytes
+ * @return 1 if it is, else 0
+ */
+int speller_check( speller *s, const char *word, int len )
+{
+    wordlist *words = s->owner->words;
+    if ( words != NULL && (wordlist_lookup(words,word,len)&WORDLIST_WORD) )
+        return 1;
+    // the list may not have every form aspell would accept
+    return aspell_speller_check( s->spell_checker, word, len ) == 1;
+}
+/**
+ * Is a joined word listed as a hard-hyphen exception in the compiled 
+ * word list?
+ * @param s the checked out speller
+ * @param word the word in UTF-8
+ * @param len its length in bytes
+ * @return 1 if it is, else 0
+ */
+int speller_is_hh_exception( speller *s, const char *word, int len )
+{
+    wordlist *words = s->owner->words;
+    return words != NULL 
+        && (wordlist_lookup(words,word,len)&WORDLIST_HH_EXCEPTION) != 0;
+}
+/**
+ * Load the dictionaries in the list, one after the other
+ * @param arg a NULL-terminated array of language codes, which we free
+ * @return NULL
+ */
+static void *prewarm_thread( void *arg )
+{
+    char **languages = arg;
+    int i;
+    for ( i=0;languages[i]!=NULL;i++ )
+    {
+        pool_find( languages[i] );
+        free( languages[i] );
+    }
+    free( languages );
+    return NULL;
+}
+/**
+ * Start loading some dictionaries on a background thread, so that the 
+ * first requests for them don't have to
+ * @param languages the language codes
+ * @param n the number of codes
+ * @return 1 if the thread was started, else 0
+ */
+int speller_pool_prewarm( const char **languages, int n )
+{
+    int i,m=0,res = 0;
+    char **copy = calloc( n+1, sizeof(char*) );
+    if ( copy != NULL )
+    {
+        pthread_t thread;
+        pthread_attr_t attr;
+        // a code that can't be copied is left for its first request
+        for ( i=0;i<n;i++ )
+            if ( (copy[m]=strdup(languages[i])) != NULL )
+                m++;
+        pthread_attr_init( &attr );
+        pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+        res = pthread_create( &thread, &attr, prewarm_thread, copy ) == 0;
+        pthread_attr_destroy( &attr );
+        if ( !res )
+        {
+            for ( i=0;i<m;i++ )
+                free( copy[i] );
+            free( copy );
+            fprintf(stderr,"speller: failed to start prewarm thread\n");
+        }
+    }
+    return res;
+}
+/**
+ * Dispose of all the spellers. No other thread may be using them.
+ */
+void speller_pool_clear()
+{
+    int i;
+    pthread_mutex_lock( &pools_lock );
+    for ( i=0;i<MAX_POOLS;i++ )
+    {
+        if ( pools[i] != NULL )
+        {
+            pool_dispose( pools[i] );
+            __atomic_store_n( &pools[i], NULL, __ATOMIC_RELEASE );
+        }
+    }
+    pthread_mutex_unlock( &pools_lock );
+}
@@ -0,0 +1,329 @@
+/* This file is part of dictionary.
+ *
+ *  dictionary is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dictionary is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dictionary.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "wordlist.h"
+/*
+ * A compiled word list is an open-addressed hash table, written once by
+ * wordlist_compile and then mapped read-only, so every process that 
+ * opens it shares the same pages. The layout, in host byte order, is:
+ *   "AEWL" version nslots nwords
+ *   nslots 32-bit offsets into the pool, 0 meaning an empty slot
+ *   the pool: a flags byte then each word NUL-terminated
+ * nslots is a power of 2 at least twice nwords, so probes are short.
+ */
+#define WORDLIST_MAGIC "AEWL"
+#define WORDLIST_VERSION 1
+#define HEADER_LEN 16
+#define MAX_WORD_LEN 256
+struct wordlist_struct
+{
+    char *data;
+    size_t len;
+    uint32_t mask;
+    int nwords;
+    const uint32_t *slots;
+    const char *pool;
+};
+/**
+ * Hash a word, FNV-1a
+ * @param word the word
+ * @param len its length in bytes
+ * @return its hash
+ */
+static uint32_t wordlist_hash( const char *word, int len )
+{
+    uint32_t h = 2166136261u;
+    int i;
+    for ( i=0;i<len;i++ )
+    {
+        h ^= (unsigned char)word[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+/**
+ * Check that a mapped word list can be probed safely: every slot must 
+ * point inside the pool, the pool must end with a NUL and at least one 
+ * slot must be empty, so that probes stop
+ * @param data the mapped file, whose header has been checked
+ * @param len its length in bytes
+ * @return 1 if it is sound, else 0
+ */
+static int wordlist_valid( const char *data, size_t len )
+{
+    uint32_t i,nslots,empty = 0;
+    size_t pool_len;
+    const uint32_t *slots = (const uint32_t*)(data+HEADER_LEN);
+    memcpy( &nslots, data+8, 4 );
+    pool_len = len-HEADER_LEN-(size_t)nslots*4;
+    if ( data[len-1] != 0 )
+        return 0;
+    for ( i=0;i<nslots;i++ )
+    {
+        if ( slots[i] == 0 )
+            empty++;
+        else if ( slots[i] >= pool_len-1 )
+            return 0;
+    }
+    return empty > 0;
+}
+/**
+ * Map a compiled word list
+ * @param path the file to map
+ * @return the word list or NULL if it is missing or invalid
+ */
+wordlist *wordlist_open( const char *path )
+{
+    wordlist *wl = NULL;
+    int fd = open( path, O_RDONLY );
+    if ( fd != -1 )
+    {
+        struct stat st;
+        if ( fstat(fd,&st) == 0 && st.st_size > HEADER_LEN )
+        {
+            char *data = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+            if ( data != MAP_FAILED )
+            {
+                uint32_t hdr[4];
+                memcpy( hdr, data, HEADER_LEN );
+                wl = calloc( 1, sizeof(wordlist) );
+                if ( wl != NULL && memcmp(data,WORDLIST_MAGIC,4)==0
+                    && hdr[1] == WORDLIST_VERSION && hdr[2] > 0
+                    && (hdr[2]&(hdr[2]-1)) == 0
+                    && HEADER_LEN+(size_t)hdr[2]*4 < (size_t)st.st_size
+                    && wordlist_valid(data,st.st_size) )
+                {
+                    wl->data = data;
+                    wl->len = st.st_size;
+                    wl->mask = hdr[2]-1;
+                    wl->nwords = hdr[3];
+                    wl->slots = (const uint32_t*)(data+HEADER_LEN);
+                    wl->pool = data+HEADER_LEN+hdr[2]*4;
+                }
+                else
+                {
+                    fprintf(stderr,"wordlist: %s is not a word list\n",path);
+                    if ( wl != NULL )
+                        free( wl );
+                    wl = NULL;
+                    munmap( data, st.st_size );
+                }
+            }
+        }
+        close( fd );
+    }
+    return wl;
+}
+/**
+ * Unmap a word list
+ * @param wl the word list
+ */
+void wordlist_close( wordlist *wl )
+{
+    munmap( wl->data, wl->len );
+    free( wl );
+}
+/**
+ * Look up a word
+ * @param wl the word list
+ * @param word the word, not necessarily NUL-terminated
+ * @param len its length in bytes
+ * @return its flags, WORDLIST_WORD etc., or 0 if it is not in the list
+ */
+int wordlist_lookup( wordlist *wl, const char *word, int len )
+{
+    uint32_t n,i = wordlist_hash( word, len ) & wl->mask;
+    for ( n=0;n<=wl->mask && wl->slots[i]!=0;n++ )
+    {
+        const char *entry = wl->pool+wl->slots[i];
+        if ( strncmp(entry+1,word,len)==0 && entry[1+len]==0 )
+            return (unsigned char)entry[0];
+        i = (i+1) & wl->mask;
+    }
+    return 0;
+}
+/**
+ * Get the number of words in a list
+ * @param wl the word list
+ * @return the number of distinct words
+ */
+int wordlist_size( wordlist *wl )
+{
+    return wl->nwords;
+}
+/** a word list being compiled */
+typedef struct
+{
+    uint32_t *slots;
+    uint32_t mask;
+    char *pool;
+    size_t pool_len;
+    size_t pool_size;
+    int nwords;
+} builder;
+/**
+ * Add a word to a builder, or add flags to it if it is already there
+ * @param b the builder
+ * @param word the NUL-terminated word
+ * @param flags its flags
+ * @return 1 if it worked, else 0
+ */
+static int builder_add( builder *b, const char *word, int flags )
+{
+    int len = strlen( word );
+    uint32_t i = wordlist_hash( word, len ) & b->mask;
+    while ( b->slots[i] != 0 )
+    {
+        char *entry = b->pool+b->slots[i];
+        if ( strcmp(entry+1,word)==0 )
+        {
+            entry[0] |= flags;
+            return 1;
+        }
+        i = (i+1) & b->mask;
+    }
+    if ( b->pool_len+len+2 > b->pool_size )
+    {
+        size_t new_size = (b->pool_size+len+2)*2;
+        char *bigger = realloc( b->pool, new_size );
+        if ( bigger == NULL || new_size > UINT32_MAX )
+        {
+            fprintf(stderr,"wordlist: failed to grow pool\n");
+            return 0;
+        }
+        b->pool = bigger;
+        b->pool_size = new_size;
+    }
+    b->slots[i] = b->pool_len;
+    b->pool[b->pool_len++] = flags;
+    memcpy( &b->pool[b->pool_len], word, len+1 );
+    b->pool_len += len+1;
+    b->nwords++;
+    return 1;
+}
+/**
+ * Read words one per line and add them to a builder
+ * @param b the builder
+ * @param src the file to read
+ * @param flags the flags for each word
+ * @return 1 if it worked, else 0
+ */
+static int builder_read( builder *b, FILE *src, int flags )
+{
+    char line[MAX_WORD_LEN];
+    int res = 1;
+    while ( res && fgets(line,MAX_WORD_LEN,src) != NULL )
+    {
+        int len = strlen( line );
+        while ( len > 0 && (line[len-1]=='\n'||line[len-1]=='\r'
+            ||line[len-1]==' ') )
+            line[--len] = 0;
+        if ( len > 0 )
+            res = builder_add( b, line, flags );
+    }
+    return res;
+}
+/**
+ * Count the lines in a file and rewind it
+ * @param src the file
+ * @return the number of lines
+ */
+static int count_lines( FILE *src )
+{
+    int c,n = 0;
+    while ( (c=fgetc(src)) != EOF )
+        if ( c == '\n' )
+            n++;
+    rewind( src );
+    return n+1;
+}
+/**
+ * Compile a word list, e.g. the output of aspell dump master | aspell 
+ * expand split one word per line, and the project's hard-hyphen 
+ * exceptions into a file that wordlist_open can map. The list is 
+ * written beside path and renamed over it, so processes that have the 
+ * old list mapped keep reading it intact.
+ * @param words the words, one per line
+ * @param excepts hard-hyphen exceptions one per line or NULL
+ * @param path the file to write
+ * @return 1 if it worked, else 0
+ */
+int wordlist_compile( FILE *words, FILE *excepts, const char *path )
+{
+    int res = 0;
+    builder b;
+    uint32_t nslots = 1;
+    int nlines = count_lines( words );
+    if ( excepts != NULL )
+        nlines += count_lines( excepts );
+    while ( nslots < (uint32_t)nlines*2 )
+        nslots <<= 1;
+    memset( &b, 0, sizeof(builder) );
+    b.mask = nslots-1;
+    b.slots = calloc( nslots, sizeof(uint32_t) );
+    b.pool_size = 1<<16;
+    b.pool = malloc( b.pool_size );
+    if ( b.slots != NULL && b.pool != NULL )
+    {
+        // offset 0 marks an empty slot so the pool starts with a pad byte
+        b.pool[b.pool_len++] = 0;
+        res = builder_read( &b, words, WORDLIST_WORD );
+        if ( res && excepts != NULL )
+            res = builder_read( &b, excepts, WORDLIST_HH_EXCEPTION );
+        if ( res )
+        {
+            char tmp[FILENAME_MAX];
+            FILE *dst = NULL;
+            if ( snprintf(tmp,FILENAME_MAX,"%s.tmp",path) < FILENAME_MAX )
+                dst = fopen( tmp, "w" );
+            if ( dst != NULL )
+            {
+                uint32_t hdr[4];
+                memcpy( hdr, WORDLIST_MAGIC, 4 );
+                hdr[1] = WORDLIST_VERSION;
+                hdr[2] = nslots;
+                hdr[3] = b.nwords;
+                res = fwrite( hdr, 4, 4, dst ) == 4
+                    && fwrite( b.slots, 4, nslots, dst ) == nslots
+                    && fwrite( b.pool, 1, b.pool_len, dst ) == b.pool_len;
+                if ( fclose(dst) != 0 )
+                    res = 0;
+                if ( res && rename(tmp,path) != 0 )
+                    res = 0;
+                if ( !res )
+                    unlink( tmp );
+            }
+            else
+                res = 0;
+            if ( !res )
+                fprintf(stderr,"wordlist: failed to write %s\n",path);
+        }
+    }
+    else
+        fprintf(stderr,"wordlist: failed to allocate tables\n");
+    if ( b.slots != NULL )
+        free( b.slots );
+    if ( b.pool != NULL )
+        free( b.pool );
+    return res;
+}
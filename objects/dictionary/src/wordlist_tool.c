@@ -0,0 +1,81 @@
+/* This file is part of dictionary.
+ *
+ *  dictionary is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dictionary is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dictionary.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * Compile a word list for a language so the stripper can answer its 
+ * hyphenation questions without aspell. Build it with buildwordlist.sh.
+ * For example:
+ *   aspell -l en_GB dump master | aspell -l en_GB expand | tr ' ' '\n' \
+ *     > en_GB.txt
+ *   wordlist -x hh_exceptions.txt en_GB.txt /usr/local/share/aese/en_GB.awl
+ */
+#ifdef WORDLIST_TOOL
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "wordlist.h"
+/**
+ * Print a simple help message
+ */
+static void usage()
+{
+    fprintf( stderr, "usage: wordlist [-x hh-exceptions] words out.awl\n"
+        "words is a file of words one per line. hh-exceptions lists "
+        "joined words\n(e.g. underfoot) whose line-end hyphen is always "
+        "kept.\n" );
+}
+/**
+ * Compile a word list
+ * @param argc the number of arguments+1
+ * @param argv the arguments
+ * @return 0 if it worked, else 1
+ */
+int main( int argc, char **argv )
+{
+    int res = 1;
+    const char *excepts_file = NULL;
+    int first = 1;
+    if ( argc == 5 && strcmp(argv[1],"-x")==0 )
+    {
+        excepts_file = argv[2];
+        first = 3;
+    }
+    if ( argc == first+2 )
+    {
+        FILE *words = fopen( argv[first], "r" );
+        FILE *excepts = (excepts_file==NULL)?NULL:fopen(excepts_file,"r");
+        if ( words == NULL || (excepts_file != NULL && excepts == NULL) )
+            fprintf( stderr, "wordlist: failed to open input\n" );
+        else if ( wordlist_compile(words,excepts,argv[first+1]) )
+        {
+            wordlist *wl = wordlist_open( argv[first+1] );
+            if ( wl != NULL )
+            {
+                fprintf( stderr, "wordlist: wrote %d words to %s\n", 
+                    wordlist_size(wl), argv[first+1] );
+                wordlist_close( wl );
+                res = 0;
+            }
+        }
+        if ( words != NULL )
+            fclose( words );
+        if ( excepts != NULL )
+            fclose( excepts );
+    }
+    else
+        usage();
+    return res;
+}
+#endif
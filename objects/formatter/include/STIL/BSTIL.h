@@ -0,0 +1,18 @@
+/* 
+ * File:   BSTIL.h
+ * Author: desmond
+ *
+ * Binary STIL, as written by the stripper's BSTIL format
+ */
+
+#ifndef BSTIL_H
+#define	BSTIL_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+int load_bstil_markup( const char *data, int len, range_array *ranges, 
+    hashset *props );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* BSTIL_H */
@@ -0,0 +1,35 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+
+#ifndef BSON_H
+#define	BSON_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+typedef struct bson_file_struct bson_file;
+bson_file *bson_file_open( const char *path );
+void bson_file_close( bson_file *bf );
+const char *bson_file_next( bson_file *bf, int *len );
+const char *bson_get_string( const char *doc, int len, const char *key,
+    int *slen );
+int bson_write_strings( FILE *dst, const char **keys, const char **values,
+    const int *lens, int n );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* BSON_H */
@@ -1,19 +1,67 @@
 /* DO NOT EDIT THIS FILE - it is machine generated */
 #include <jni.h>
-/* Header for class hritserver_AeseFormatter */
+/* Header for class calliope_AeseFormatter */
 
-#ifndef _Included_hritserver_AeseFormatter
-#define _Included_hritserver_AeseFormatter
+#ifndef _Included_calliope_AeseFormatter
+#define _Included_calliope_AeseFormatter
 #ifdef __cplusplus
 extern "C" {
 #endif
 /*
- * Class:     hritserver_AeseFormatter
+ * Class:     calliope_AeseFormatter
  * Method:    format
- * Signature: (Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;Lhritserver/json/JSONResponse;)I
+ * Signature: ([B[Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;Lcalliope/json/JSONResponse;)I
  */
-JNIEXPORT jint JNICALL Java_hritserver_AeseFormatter_format
-  (JNIEnv *, jobject, jstring, jobjectArray, jobjectArray, jobjectArray, jobject);
+JNIEXPORT jint JNICALL Java_calliope_AeseFormatter_format
+  (JNIEnv *, jobject, jbyteArray, jobjectArray, jobjectArray, jobjectArray, jobject);
+
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    formatRange
+ * Signature: ([B[Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;IILcalliope/json/JSONResponse;)I
+ */
+JNIEXPORT jint JNICALL Java_calliope_AeseFormatter_formatRange
+  (JNIEnv *, jobject, jbyteArray, jobjectArray, jobjectArray, jobjectArray, jint, jint, jobject);
+
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    openIndex
+ * Signature: ([B[Ljava/lang/String;[Ljava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_calliope_AeseFormatter_openIndex
+  (JNIEnv *, jobject, jbyteArray, jobjectArray, jobjectArray);
+
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    queryRanges
+ * Signature: (JII)[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL Java_calliope_AeseFormatter_queryRanges
+  (JNIEnv *, jobject, jlong, jint, jint);
+
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    closeIndex
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_calliope_AeseFormatter_closeIndex
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    formatXML
+ * Signature: (Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;[Ljava/lang/String;Lcalliope/json/JSONResponse;Lcalliope/json/JSONResponse;)I
+ */
+JNIEXPORT jint JNICALL Java_calliope_AeseFormatter_formatXML
+  (JNIEnv *, jobject, jstring, jstring, jstring, jstring, jstring, jobjectArray, jobject, jobject);
+
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    getStats
+ * Signature: ()Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_calliope_AeseFormatter_getStats
+  (JNIEnv *, jobject);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,33 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+
+#ifndef CSS_SHEET_H
+#define	CSS_SHEET_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+typedef struct css_sheet_struct css_sheet;
+css_sheet *css_sheet_create();
+void css_sheet_dispose( css_sheet *cs );
+int css_sheet_parse( css_sheet *cs, const char *data, int len, 
+    hashset *props );
+hashmap *css_sheet_rules( css_sheet *cs );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* CSS_SHEET_H */
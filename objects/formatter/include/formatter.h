@@ -38,12 +38,21 @@ typedef struct formatter_struct formatter;
 formatter *formatter_create( int len );
 void formatter_dispose( formatter *f );
 int formatter_css_parse( formatter *f, const char *data, int len );
+void formatter_use_css( formatter *f, css_sheet *cs );
 int formatter_load_markup( formatter *f, load_markup_func mfunc, 
     const char *data, int len );
+int formatter_load_layers( formatter *f, load_markup_func *mfuncs, 
+    const char **data, int *lens, int n );
 int formatter_make_html( formatter *f, const char *text, int len );
 int formatter_save_html( formatter *f, char *file );
 char *formatter_get_html( formatter *f, int *len );
 int formatter_cull_ranges( formatter *f, char *text, int *len );
+int formatter_select_window( formatter *f, int from, int to, 
+    range_array **full );
+void formatter_restore_ranges( formatter *f, range_array *full );
+range_array *formatter_get_ranges( formatter *f );
+int formatter_add_range( formatter *f, range *r );
+void formatter_sort_ranges( formatter *f );
 #ifdef	__cplusplus
 }
 #endif
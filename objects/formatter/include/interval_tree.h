@@ -0,0 +1,35 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+
+#ifndef INTERVAL_TREE_H
+#define	INTERVAL_TREE_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef struct interval_tree_struct interval_tree;
+interval_tree *interval_tree_create( range **ranges, int len );
+void interval_tree_dispose( interval_tree *t );
+int interval_tree_size( interval_tree *t );
+int interval_tree_query( interval_tree *t, int from, int to, 
+    range_array *results );
+int interval_tree_stab( interval_tree *t, int offset, range_array *results );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* INTERVAL_TREE_H */
@@ -0,0 +1,32 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+
+#ifndef MAP_FILE_H
+#define	MAP_FILE_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+typedef struct map_file_struct map_file;
+map_file *map_file_open( const char *path );
+void map_file_close( map_file *mf );
+char *map_file_data( map_file *mf );
+int map_file_len( map_file *mf );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* MAP_FILE_H */
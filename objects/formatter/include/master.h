@@ -13,11 +13,22 @@ typedef struct master_struct master;
 
 master *master_create( char *text, int len );
 void master_dispose( master *hf );
+/* all markup must be loaded before the first render or query, which 
+   culls the text: later loads fail */
 int master_load_markup( master *hf, const char *markup, int len, 
     const char *fmt ); 
+int master_load_layers( master *hf, const char **markup, int *mlens, 
+    const char **fmts, int n );
+int master_add_range( master *hf, const char *name, char **atts, 
+    int removed, int start, int len );
 int master_get_html_len( master *hf );
 int master_load_css( master *hf, const char *css, int len );
+void master_use_css( master *hf, css_sheet *cs );
 char *master_convert( master *hf );
+char *master_convert_range( master *hf, int from, int to );
+int master_query_ranges( master *hf, int from, int to, 
+    range_array *results );
+int master_stab_ranges( master *hf, int offset, range_array *results );
 char *master_list();
 #ifdef	__cplusplus
 }
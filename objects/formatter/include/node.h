@@ -21,8 +21,11 @@
 #define	NODE_H
 
 typedef struct node_struct node;
-node *node_create( char *name, char *html_name, int offset, int len, 
-     int empty, int rightmost );
+typedef struct node_pool_struct node_pool;
+node_pool *node_pool_create( int size_hint );
+void node_pool_dispose( node_pool *p );
+node *node_create( node_pool *p, char *name, char *html_name, int offset, 
+     int len, int empty, int rightmost );
 void node_dispose( node *n );
 void node_add_child( node *n, node *c );
 void node_add_sibling( node *n, node *sibling );
@@ -0,0 +1,23 @@
+/* 
+ * File:   pipeline.h
+ * Author: desmond
+ *
+ * Strip XML straight into a master via libAeseStripper
+ */
+
+#ifndef PIPELINE_H
+#define	PIPELINE_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+typedef struct pipeline_struct pipeline;
+pipeline *pipeline_create( const char *xml, int xlen, const char *rules, 
+    int rlen, const char *style, const char *language, 
+    const char *hh_excepts, int want_stil );
+void pipeline_dispose( pipeline *p );
+master *pipeline_master( pipeline *p );
+char *pipeline_stil( pipeline *p, int *len );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* PIPELINE_H */
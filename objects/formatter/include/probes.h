@@ -0,0 +1,44 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+/*
+ * USDT probes for perf and bpftrace, e.g. 
+ * bpftrace -e 'usdt:libAeseFormatter.so:formatter:convert__return { ... }'
+ * They are built in whenever <sys/sdt.h> is found (systemtap-sdt-dev) 
+ * and are a single nop each until something attaches to them. Build with
+ * -DNO_PROBES to leave them out.
+ */
+#ifndef PROBES_H
+#define	PROBES_H
+#if !defined(NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_PROBES 1
+#endif
+#endif
+#ifdef HAVE_PROBES
+#define PROBE0(name) STAP_PROBE(formatter,name)
+#define PROBE1(name,a) STAP_PROBE1(formatter,name,a)
+#define PROBE2(name,a,b) STAP_PROBE2(formatter,name,a,b)
+#define PROBE3(name,a,b,c) STAP_PROBE3(formatter,name,a,b,c)
+#else
+#define PROBE0(name)
+#define PROBE1(name,a)
+#define PROBE2(name,a,b)
+#define PROBE3(name,a,b,c)
+#endif
+#endif	/* PROBES_H */
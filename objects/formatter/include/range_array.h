@@ -19,6 +19,7 @@ range **range_array_ranges( range_array *ra );
 int range_array_add( range_array *ra, range *r );
 int range_array_insert( range_array *ra, int at, range *r );
 void range_array_sort( range_array *ra );
+int range_array_merge( range_array *ra, range_array **runs, int n );
 range *range_array_get( range_array *ra, int i );
 int range_array_has_removed( range_array *ra );
 void range_array_remove( range_array *ra, int i, int dispose );
@@ -0,0 +1,65 @@
+/* 
+ * File:   range_sink.h
+ * Author: desmond
+ *
+ * Interface between the stripper and a consumer of its output that 
+ * wants the text and closed ranges directly instead of as STIL. It 
+ * is shared by the stripper and formatter sources, which are built as 
+ * separate libraries, so it only uses plain C types.
+ */
+
+#ifndef RANGE_SINK_H
+#define	RANGE_SINK_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+/** name of the entry point exported by libAeseStripper */
+#define STRIPPER_SCAN_SYMBOL "stripper_scan"
+/**
+ * Receive the stripped text. Called once, before any ranges.
+ * @param arg the sink's user argument
+ * @param text the text, valid only during the call
+ * @param len its length in bytes
+ * @return 1 to continue, 0 to abort
+ */
+typedef int (*range_sink_text)( void *arg, const char *text, int len );
+/**
+ * Receive one closed range, in order of increasing start offset then 
+ * decreasing length
+ * @param arg the sink's user argument
+ * @param name the name of the range
+ * @param atts NULL-terminated array of attribute name/value pairs
+ * @param removed 1 if the range's text is to be removed
+ * @param start its absolute offset in the text
+ * @param len its length
+ * @return 1 to continue, 0 to abort
+ */
+typedef int (*range_sink_range)( void *arg, const char *name, char **atts,
+    int removed, int start, int len );
+typedef struct
+{
+    void *arg;
+    range_sink_text text;
+    range_sink_range range;
+} range_sink;
+/**
+ * Strip an XML document straight into a sink
+ * @param xml the XML source
+ * @param xlen its length
+ * @param rules the recipe in XML or JSON or NULL
+ * @param rlen its length
+ * @param style the style name for a STIL copy
+ * @param language the language code for hyphenation or NULL
+ * @param hh_excepts space-delimited hard-hyphen exceptions or NULL
+ * @param sink the sink to deliver the text and default-layer ranges to
+ * @param stil if not NULL set to an allocated STIL copy of the markup
+ * @param stil_len if not NULL set to the length of the STIL copy
+ * @return 1 if it worked, else 0
+ */
+typedef int (*stripper_scan_func)( const char *xml, int xlen, 
+    const char *rules, int rlen, const char *style, const char *language, 
+    const char *hh_excepts, range_sink *sink, char **stil, int *stil_len );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* RANGE_SINK_H */
@@ -0,0 +1,41 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+
+#ifndef RANGE_TABLE_H
+#define	RANGE_TABLE_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+/** flags of a range in a table */
+#define RANGE_TABLE_REMOVED 1
+/** set by formatter_cull_ranges on a range that was wholly removed */
+#define CULL_DROPPED 2
+typedef struct range_table_struct range_table;
+range_table *range_table_create( range_array *ra, hashset *names );
+void range_table_dispose( range_table *rt );
+int range_table_size( range_table *rt );
+int *range_table_starts( range_table *rt );
+int *range_table_lens( range_table *rt );
+int *range_table_names( range_table *rt );
+unsigned char *range_table_flags( range_table *rt );
+range **range_table_ranges( range_table *rt );
+int range_table_is_sorted( range_table *rt );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* RANGE_TABLE_H */
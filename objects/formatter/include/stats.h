@@ -0,0 +1,71 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+
+#ifndef STATS_H
+#define	STATS_H
+#include <stddef.h>
+#ifdef	__cplusplus
+extern "C" {
+#endif
+/** timed phases of a format call */
+#define STATS_STRIP 0
+#define STATS_CSS 1
+#define STATS_MARKUP 2
+#define STATS_CULL 3
+#define STATS_MATRIX 4
+#define STATS_BUILD 5
+#define STATS_PRINT 6
+#define STATS_NUM_PHASES 7
+/** allocations made outside any phase */
+#define STATS_OTHER STATS_NUM_PHASES
+/** counters */
+#define STATS_RANGES 0
+#define STATS_NODES 1
+#define STATS_SPLITS 2
+#define STATS_DROPS 3
+#define STATS_OUTPUT_BYTES 4
+#define STATS_NUM_COUNTERS 5
+/** the timings, counters and allocations of a call */
+typedef struct
+{
+    long long ns[STATS_NUM_PHASES];
+    long long counts[STATS_NUM_COUNTERS];
+    long long alloc_bytes[STATS_NUM_PHASES+1];
+    long long alloc_count[STATS_NUM_PHASES+1];
+    long long live;
+    long long peak;
+} stats_block;
+void stats_begin();
+void stats_end();
+long long stats_now();
+long long stats_enter( int phase );
+void stats_time( int phase, long long since );
+void stats_count( int counter, long n );
+void stats_current( stats_block *b );
+void stats_adopt( stats_block *b );
+void stats_last( stats_block *b );
+int stats_json( char *buf, int len );
+void *stats_malloc( size_t size );
+void *stats_calloc( size_t n, size_t size );
+void *stats_realloc( void *ptr, size_t size );
+char *stats_strdup( const char *str );
+void stats_free( void *ptr );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* STATS_H */
@@ -0,0 +1,35 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+/*
+ * Include this after memwatch.h to count the allocations of a source 
+ * file against the phase that made them. Build with -DSTATS_ALLOC. 
+ * It is ignored when MEMWATCH is on.
+ */
+#if defined(STATS_ALLOC) && !defined(MEMWATCH)
+#ifndef STATS_ALLOC_H
+#define	STATS_ALLOC_H
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+#define malloc(a) stats_malloc(a)
+#define calloc(a,b) stats_calloc(a,b)
+#define realloc(a,b) stats_realloc(a,b)
+#define strdup(a) stats_strdup(a)
+#define free(a) stats_free(a)
+#endif	/* STATS_ALLOC_H */
+#endif
@@ -22,8 +22,8 @@ if [ $USER = "root" ]; then
     JDKINCLUDEDIRNAME="include"
   fi
   JDKINC=`getjdkinclude`
-  gcc -c -DHAVE_EXPAT_CONFIG_H -DHAVE_MEMMOVE -DJNI -I$JDKINC -Iinclude -Iinclude/STIL -Iinclude/AESE -O0 -Wall -g3 -fPIC src/*.c src/AESE/*.c src/STIL/*.c 
-  gcc *.o -shared -o libAeseFormatter.$LIBSUFFIX
+  gcc -c -DHAVE_EXPAT_CONFIG_H -DHAVE_MEMMOVE -DJNI -DSTATS_ALLOC -I$JDKINC -Iinclude -Iinclude/STIL -Iinclude/AESE -O0 -Wall -g3 -fPIC src/*.c src/AESE/*.c src/STIL/*.c 
+  gcc *.o -shared -ldl -o libAeseFormatter.$LIBSUFFIX
   mv libAeseFormatter.$LIBSUFFIX /usr/local/lib/
   rm *.o
 else
@@ -30,6 +30,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include "expat.h"
+#include "xml_pool.h"
 #include "css_property.h"
 #include "css_selector.h"
 #include "hashmap.h"
@@ -39,6 +40,7 @@
 #include "css_rule.h"
 #include "range_array.h"
 #include "hashset.h"
+#include "css_sheet.h"
 #include "formatter.h"
 #include "AESE/AESE.h"
 #include "plain_text.h"
@@ -61,8 +63,6 @@ struct userdata_struct
     int absolute_off;
     range *current;
 };
-/** the parser */
-static XML_Parser parser;
 
 
 /**
@@ -164,11 +164,12 @@ static void XMLCALL end_element_scan( void *userData, const char *name )
 int load_aese_markup( const char *mdata, int mlen, range_array *ranges, hashset *props )
 {
     int res = 0;
+    XML_Parser parser;
     struct userdata_struct userdata;
     userdata.props = props;
     userdata.ranges = ranges;
     userdata.absolute_off = 0;
-    parser = XML_ParserCreate( NULL );
+    parser = xml_pool_checkout();
     if ( parser != NULL )
     {
         XML_SetElementHandler( parser, start_element_scan, end_element_scan );
@@ -182,7 +183,7 @@ int load_aese_markup( const char *mdata, int mlen, range_array *ranges, hashset
         }
         else
             res = 1;
-        XML_ParserFree( parser );
+        xml_pool_checkin( parser );
     }
     else
         warning("AESE: failed to create parser\n");
@@ -26,6 +26,7 @@
 #include "HTML.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 /* this has to be so, because of the bit vectors below */
 #if UINT_MAX > 4294967295
 	#error "sizeof unsigned int not equal to 4!"
@@ -0,0 +1,306 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+/**
+ * Load binary STIL. The layout is described in the stripper's BSTIL.c. 
+ * Markup passed through Java arrives base64-encoded, so we accept that 
+ * too.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hashmap.h"
+#include "attribute.h"
+#include "annotation.h"
+#include "range.h"
+#include "range_array.h"
+#include "hashset.h"
+#include "STIL/BSTIL.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+#include "error.h"
+#define BSTIL_MAGIC "BSTL"
+#define BSTIL_MAGIC_LEN 4
+/** "BSTL" in base64 */
+#define BSTIL_MAGIC64 "QlNUT"
+#define BSTIL_MAGIC64_LEN 5
+#define BSTIL_VERSION 1
+#define BSTIL_REMOVED 1
+#define BSTIL_CONTENT 2
+#define BSTIL_ANNOTATIONS 4
+#define BSTIL_END 0xFF
+#define VARINT_MAX 5
+/**
+ * State of a load: the data and the string table
+ */
+typedef struct
+{
+    const unsigned char *data;
+    int len;
+    int pos;
+    char **strings;
+    int n_strings;
+    int allocated;
+} reader;
+/**
+ * Read an unsigned varint
+ * @param r the reader
+ * @param value VAR param the value read
+ * @return 1 if it worked, 0 if the data was truncated
+ */
+static int read_varint( reader *r, unsigned *value )
+{
+    int shift = 0;
+    *value = 0;
+    while ( r->pos < r->len && shift < 7*VARINT_MAX )
+    {
+        unsigned char c = r->data[r->pos++];
+        *value |= (unsigned)(c & 0x7F) << shift;
+        if ( (c & 0x80) == 0 )
+            return 1;
+        shift += 7;
+    }
+    return 0;
+}
+/**
+ * Copy a string of known length out of the data
+ * @param r the reader
+ * @param slen the string's length
+ * @return an allocated NUL-terminated string or NULL
+ */
+static char *read_chars( reader *r, unsigned slen )
+{
+    char *str = NULL;
+    if ( slen <= (unsigned)(r->len-r->pos) )
+    {
+        str = malloc( slen+1 );
+        if ( str != NULL )
+        {
+            memcpy( str, &r->data[r->pos], slen );
+            str[slen] = 0;
+            r->pos += slen;
+        }
+    }
+    return str;
+}
+/**
+ * Read a reference into the string table, defining new strings
+ * @param r the reader
+ * @return the string, which belongs to the table, or NULL
+ */
+static char *read_ref( reader *r )
+{
+    unsigned v;
+    if ( !read_varint(r,&v) )
+        return NULL;
+    else if ( v & 1 )
+    {
+        char *str;
+        if ( r->n_strings == r->allocated )
+        {
+            int new_size = (r->allocated==0)?32:r->allocated*2;
+            char **tmp = realloc( r->strings, new_size*sizeof(char*) );
+            if ( tmp == NULL )
+                return NULL;
+            r->strings = tmp;
+            r->allocated = new_size;
+        }
+        str = read_chars( r, v>>1 );
+        if ( str != NULL )
+            r->strings[r->n_strings++] = str;
+        return str;
+    }
+    else if ( (v>>1) < (unsigned)r->n_strings )
+        return r->strings[v>>1];
+    else
+        return NULL;
+}
+/**
+ * Read one range record
+ * @param r the reader
+ * @param absolute_off VAR param the running absolute offset
+ * @return the range or NULL on error
+ */
+static range *read_range( reader *r, int *absolute_off )
+{
+    unsigned flags = r->data[r->pos++];
+    unsigned reloff,len,slen,count,i;
+    range *rng = NULL;
+    char *name = read_ref( r );
+    if ( name != NULL && read_varint(r,&reloff) && read_varint(r,&len) )
+    {
+        int rel = (int)(reloff>>1)^-(int)(reloff&1);
+        rng = range_create( name, NULL, *absolute_off+rel, (int)len );
+        if ( rng == NULL )
+            return NULL;
+        *absolute_off += rel;
+        range_set_reloff( rng, rel );
+        if ( flags & BSTIL_REMOVED )
+            range_set_removed( rng, 1 );
+        // content is ignored, as in STIL
+        if ( flags & BSTIL_CONTENT )
+        {
+            if ( read_varint(r,&slen) && slen <= (unsigned)(r->len-r->pos) )
+                r->pos += slen;
+            else
+            {
+                range_dispose( rng );
+                return NULL;
+            }
+        }
+        if ( flags & BSTIL_ANNOTATIONS )
+        {
+            unsigned block;
+            if ( !read_varint(r,&block) || !read_varint(r,&count) )
+            {
+                range_dispose( rng );
+                return NULL;
+            }
+            for ( i=0;i<count;i++ )
+            {
+                char *key = read_ref( r );
+                char *value = NULL;
+                if ( key != NULL && read_varint(r,&slen) )
+                    value = read_chars( r, slen );
+                if ( value == NULL )
+                {
+                    range_dispose( rng );
+                    return NULL;
+                }
+                else
+                {
+                    annotation *a = annotation_create_simple( key, value );
+                    if ( a != NULL )
+                        range_add_annotation( rng, a );
+                    free( value );
+                }
+            }
+        }
+    }
+    return rng;
+}
+/**
+ * Decode base64 markup that came through Java
+ * @param data the encoded data
+ * @param len its length
+ * @param dlen VAR param set to the decoded length
+ * @return an allocated buffer or NULL
+ */
+static unsigned char *decode_base64( const char *data, int len, int *dlen )
+{
+    unsigned char *out = malloc( (len/4)*3+3 );
+    if ( out != NULL )
+    {
+        int i,bits = 0,n = 0;
+        unsigned acc = 0;
+        for ( i=0;i<len;i++ )
+        {
+            int c = data[i],v;
+            if ( c >= 'A' && c <= 'Z' )
+                v = c-'A';
+            else if ( c >= 'a' && c <= 'z' )
+                v = c-'a'+26;
+            else if ( c >= '0' && c <= '9' )
+                v = c-'0'+52;
+            else if ( c == '+' )
+                v = 62;
+            else if ( c == '/' )
+                v = 63;
+            else // padding or white space
+                continue;
+            acc = (acc<<6)|v;
+            bits += 6;
+            if ( bits >= 8 )
+            {
+                bits -= 8;
+                out[n++] = (acc>>bits)&0xFF;
+            }
+        }
+        *dlen = n;
+    }
+    return out;
+}
+/**
+ * Load binary STIL markup
+ * @param data the BSTIL data, raw or base64-encoded
+ * @param len its length
+ * @param ranges add the loaded ranges to this array
+ * @param props store in here the names of all the properties
+ * @return 1 if it loaded successfully, else 0
+ */
+int load_bstil_markup( const char *data, int len, range_array *ranges, 
+    hashset *props )
+{
+    int res = 0;
+    unsigned char *decoded = NULL;
+    reader r;
+    memset( &r, 0, sizeof(reader) );
+    if ( len >= BSTIL_MAGIC64_LEN 
+        && strncmp(data,BSTIL_MAGIC64,BSTIL_MAGIC64_LEN)==0 )
+    {
+        decoded = decode_base64( data, len, &r.len );
+        r.data = decoded;
+    }
+    else
+    {
+        r.data = (const unsigned char*)data;
+        r.len = len;
+    }
+    if ( r.data != NULL && r.len > BSTIL_MAGIC_LEN 
+        && memcmp(r.data,BSTIL_MAGIC,BSTIL_MAGIC_LEN)==0
+        && r.data[BSTIL_MAGIC_LEN] == BSTIL_VERSION )
+    {
+        unsigned slen;
+        r.pos = BSTIL_MAGIC_LEN+1;
+        // skip the style
+        if ( read_varint(&r,&slen) && slen <= (unsigned)(r.len-r.pos) )
+        {
+            int absolute_off = 0;
+            r.pos += slen;
+            res = 1;
+            while ( r.pos < r.len && r.data[r.pos] != BSTIL_END )
+            {
+                range *rng = read_range( &r, &absolute_off );
+                if ( rng == NULL )
+                {
+                    warning("BSTIL: corrupt range at byte %d\n",r.pos);
+                    res = 0;
+                    break;
+                }
+                if ( !hashset_contains(props,range_name(rng)) )
+                    hashset_put( props, range_name(rng) );
+                range_array_add( ranges, rng );
+            }
+            if ( res && r.pos >= r.len )
+            {
+                warning("BSTIL: markup ends before its END byte\n");
+                res = 0;
+            }
+        }
+        else
+            warning("BSTIL: truncated header\n");
+    }
+    else
+        warning("BSTIL: not BSTIL version %d\n",BSTIL_VERSION);
+    while ( r.n_strings > 0 )
+        free( r.strings[--r.n_strings] );
+    if ( r.strings != NULL )
+        free( r.strings );
+    if ( decoded != NULL )
+        free( decoded );
+    return res;
+}
@@ -36,11 +36,13 @@
 #include "css_rule.h"
 #include "range_array.h"
 #include "hashset.h"
+#include "css_sheet.h"
 #include "formatter.h"
 #include "cJSON.h"
 #include "STIL/STIL.h"
 #include "plain_text.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 #include "error.h"
 
 #ifdef XML_LARGE_SIZE
@@ -32,8 +32,9 @@
 #include <ctype.h>
 #include "cJSON.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
-static const char *ep;
+static __thread const char *ep;
 
 const char *cJSON_GetErrorPtr() {return ep;}
 
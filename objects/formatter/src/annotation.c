@@ -26,6 +26,7 @@
 #include "css_rule.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
 /**
  * An annotation is a former XML attribute, applied to a range.
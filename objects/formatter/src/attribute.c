@@ -22,6 +22,7 @@
 #include "attribute.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 struct attribute_struct
 {
     char *name;
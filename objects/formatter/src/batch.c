@@ -0,0 +1,450 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+#if COMMANDLINE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "hashmap.h"
+#include "attribute.h"
+#include "annotation.h"
+#include "range.h"
+#include "range_array.h"
+#include "hashset.h"
+#include "css_sheet.h"
+#include "master.h"
+#include "file_list.h"
+#include "map_file.h"
+#include "stats.h"
+#include "error.h"
+#include "batch.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+/*
+ * Render many texts in one run of the formatter, e.g. a whole edition.
+ * The manifest has one job per line: the text file, a colon-separated
+ * list of markup files, a colon-separated list of css files and the
+ * HTML file to write, separated by spaces or tabs. Blank lines and
+ * lines starting with # are ignored. Each distinct css list is parsed
+ * once and shared by every job that names it. The jobs are split among
+ * the threads, and a thread that runs out steals half of the remaining
+ * jobs of another.
+ */
+#define ERROR_PREFIX "<html><body><p>Error:"
+#define BATCH_FIELDS 4
+/** one text to render */
+typedef struct
+{
+    char *text_name;
+    file_list *markup_files;
+    char *html_name;
+    /** the parsed css, shared with other jobs */
+    css_sheet *css;
+    /** the input bytes, text plus markup */
+    long long bytes;
+    /** the wall time of the job */
+    long long ns;
+    stats_block stats;
+    int res;
+} batch_job;
+/** the jobs a thread still owns: it takes from next, thieves from end */
+typedef struct
+{
+    int next;
+    int end;
+    pthread_mutex_t lock;
+} batch_deque;
+/** state shared by the batch threads */
+typedef struct
+{
+    batch_job *jobs;
+    int num_jobs;
+    batch_deque *deques;
+    int num_threads;
+    const char *format;
+} batch_state;
+/** what a thread needs to know about itself */
+typedef struct
+{
+    batch_state *bs;
+    int id;
+} batch_thread;
+/**
+ * Load the css files of a job, or find them if already loaded
+ * @param sheets the parsed css indexed by the list of css files
+ * @param css_names the colon-separated list of css files
+ * @return the parsed css or NULL
+ */
+static css_sheet *batch_css( hashmap *sheets, char *css_names )
+{
+    css_sheet *cs = hashmap_get( sheets, css_names );
+    if ( cs == NULL )
+    {
+        char *names = strdup( css_names );
+        file_list *fl = (names==NULL)?NULL:file_list_create( names );
+        cs = css_sheet_create();
+        if ( fl != NULL && cs != NULL )
+        {
+            int i;
+            long long start = stats_enter( STATS_CSS );
+            for ( i=0;i<file_list_size(fl);i++ )
+            {
+                map_file *mf = map_file_open( file_list_get(fl,i) );
+                if ( mf == NULL || !css_sheet_parse(cs,map_file_data(mf),
+                    map_file_len(mf),NULL) )
+                {
+                    warning("formatter: failed to load css %s\n",
+                        file_list_get(fl,i));
+                    css_sheet_dispose( cs );
+                    cs = NULL;
+                }
+                if ( mf != NULL )
+                    map_file_close( mf );
+                if ( cs == NULL )
+                    break;
+            }
+            stats_time( STATS_CSS, start );
+            if ( cs != NULL && !hashmap_put(sheets,css_names,cs) )
+            {
+                css_sheet_dispose( cs );
+                cs = NULL;
+            }
+        }
+        else if ( cs != NULL )
+        {
+            css_sheet_dispose( cs );
+            cs = NULL;
+        }
+        if ( fl != NULL )
+            file_list_delete( fl );
+        if ( names != NULL )
+            free( names );
+    }
+    return cs;
+}
+/**
+ * Read the jobs from the manifest
+ * @param data the manifest, which is split up in place
+ * @param sheets store the parsed css here
+ * @param num_jobs set to the number of jobs read
+ * @return an array of jobs or NULL
+ */
+static batch_job *batch_read( char *data, hashmap *sheets, int *num_jobs )
+{
+    int n = 0,size = 64,line_no = 0;
+    char *line_save,*line = strtok_r( data, "\n", &line_save );
+    batch_job *jobs = calloc( size, sizeof(batch_job) );
+    while ( jobs != NULL && line != NULL )
+    {
+        int i;
+        char *field_save,*fields[BATCH_FIELDS];
+        line_no++;
+        fields[0] = strtok_r( line, " \t\r", &field_save );
+        for ( i=1;i<BATCH_FIELDS&&fields[i-1]!=NULL;i++ )
+            fields[i] = strtok_r( NULL, " \t\r", &field_save );
+        if ( fields[0] != NULL && fields[0][0] != '#' )
+        {
+            batch_job *j;
+            if ( i < BATCH_FIELDS || fields[BATCH_FIELDS-1] == NULL )
+            {
+                warning("formatter: manifest line %d needs text, markup, "
+                    "css and html files\n",line_no);
+                free( jobs );
+                return NULL;
+            }
+            if ( n == size )
+            {
+                batch_job *bigger = realloc( jobs, size*2*sizeof(batch_job) );
+                if ( bigger == NULL )
+                {
+                    free( jobs );
+                    return NULL;
+                }
+                jobs = bigger;
+                size *= 2;
+            }
+            j = &jobs[n];
+            memset( j, 0, sizeof(batch_job) );
+            j->text_name = fields[0];
+            j->css = batch_css( sheets, fields[2] );
+            j->markup_files = file_list_create( fields[1] );
+            j->html_name = fields[3];
+            n++;
+            if ( j->css == NULL || j->markup_files == NULL )
+            {
+                *num_jobs = n;
+                return jobs;
+            }
+        }
+        line = strtok_r( NULL, "\n", &line_save );
+    }
+    *num_jobs = n;
+    return jobs;
+}
+/**
+ * Render one job and write its HTML
+ * @param j the job
+ * @param format the markup format
+ * @return 1 if it worked, else 0
+ */
+static int batch_render( batch_job *j, const char *format )
+{
+    int i,res = 0;
+    // the text is culled in place, but the mapping is private
+    map_file *text = map_file_open( j->text_name );
+    if ( text != NULL )
+    {
+        master *hf = master_create( map_file_data(text), map_file_len(text) );
+        j->bytes = map_file_len( text );
+        if ( hf != NULL )
+        {
+            res = 1;
+            for ( i=0;i<file_list_size(j->markup_files)&&res;i++ )
+            {
+                map_file *mf = map_file_open( 
+                    file_list_get(j->markup_files,i) );
+                res = mf != NULL && master_load_markup( hf, 
+                    map_file_data(mf), map_file_len(mf), format );
+                if ( mf != NULL )
+                {
+                    j->bytes += map_file_len( mf );
+                    map_file_close( mf );
+                }
+            }
+            if ( res )
+            {
+                char *html;
+                int hlen;
+                master_use_css( hf, j->css );
+                html = master_convert( hf );
+                hlen = master_get_html_len( hf );
+                res = html != NULL 
+                    && strncmp(html,ERROR_PREFIX,strlen(ERROR_PREFIX))!=0;
+                if ( res )
+                {
+                    FILE *dst = fopen( j->html_name, "w" );
+                    res = dst != NULL && fwrite(html,1,hlen,dst) == hlen;
+                    if ( dst != NULL )
+                        fclose( dst );
+                }
+            }
+            master_dispose( hf );
+        }
+        map_file_close( text );
+    }
+    if ( !res )
+        warning("formatter: failed to render %s\n",j->text_name);
+    return res;
+}
+/**
+ * Take the next job of this thread, or steal half of another's
+ * @param bs the shared batch state
+ * @param id the index of this thread
+ * @return the index of the job to do or -1 if there are none left
+ */
+static int batch_next( batch_state *bs, int id )
+{
+    int i,job = -1;
+    batch_deque *own = &bs->deques[id];
+    pthread_mutex_lock( &own->lock );
+    if ( own->next < own->end )
+        job = own->next++;
+    pthread_mutex_unlock( &own->lock );
+    for ( i=1;i<bs->num_threads&&job==-1;i++ )
+    {
+        batch_deque *victim = &bs->deques[(id+i)%bs->num_threads];
+        int from=0,to=0;
+        pthread_mutex_lock( &victim->lock );
+        if ( victim->next < victim->end )
+        {
+            to = victim->end;
+            from = to-(to-victim->next+1)/2;
+            victim->end = from;
+        }
+        pthread_mutex_unlock( &victim->lock );
+        if ( from < to )
+        {
+            job = from;
+            pthread_mutex_lock( &own->lock );
+            own->next = from+1;
+            own->end = to;
+            pthread_mutex_unlock( &own->lock );
+        }
+    }
+    return job;
+}
+/**
+ * Render jobs until there are none left to do or steal
+ * @param arg this thread's batch_thread
+ * @return NULL
+ */
+static void *batch_thread_run( void *arg )
+{
+    batch_thread *bt = arg;
+    int job;
+    while ( (job=batch_next(bt->bs,bt->id)) != -1 )
+    {
+        batch_job *j = &bt->bs->jobs[job];
+        long long start = stats_now();
+        stats_begin();
+        j->res = batch_render( j, bt->bs->format );
+        stats_end();
+        stats_last( &j->stats );
+        j->ns = stats_now()-start;
+    }
+    return NULL;
+}
+/**
+ * Render every job on several threads
+ * @param bs the shared batch state
+ * @return 1 if all the threads ran, else 0
+ */
+static int batch_all( batch_state *bs )
+{
+    int i,started = 0;
+    pthread_t *threads = calloc( bs->num_threads, sizeof(pthread_t) );
+    batch_thread *bts = calloc( bs->num_threads, sizeof(batch_thread) );
+    bs->deques = calloc( bs->num_threads, sizeof(batch_deque) );
+    if ( threads != NULL && bts != NULL && bs->deques != NULL )
+    {
+        // each thread starts with an equal share of the jobs
+        for ( i=0;i<bs->num_threads;i++ )
+        {
+            bs->deques[i].next = (int)((long long)bs->num_jobs*i
+                /bs->num_threads);
+            bs->deques[i].end = (int)((long long)bs->num_jobs*(i+1)
+                /bs->num_threads);
+            pthread_mutex_init( &bs->deques[i].lock, NULL );
+            bts[i].bs = bs;
+            bts[i].id = i;
+        }
+        for ( i=0;i<bs->num_threads;i++ )
+        {
+            if ( pthread_create(&threads[i],NULL,batch_thread_run,&bts[i]) 
+                != 0 )
+                break;
+            started++;
+        }
+        // if no thread started render on this one
+        if ( started == 0 )
+            batch_thread_run( &bts[0] );
+        for ( i=0;i<started;i++ )
+            pthread_join( threads[i], NULL );
+        for ( i=0;i<bs->num_threads;i++ )
+            pthread_mutex_destroy( &bs->deques[i].lock );
+    }
+    if ( threads != NULL )
+        free( threads );
+    if ( bts != NULL )
+        free( bts );
+    if ( bs->deques != NULL )
+        free( bs->deques );
+    return threads != NULL && bts != NULL && bs->deques != NULL;
+}
+/**
+ * Print the timing of each job in manifest order and a summary
+ * @param bs the finished batch
+ * @param ns the wall time of the whole batch
+ * @return the number of jobs that failed
+ */
+static int batch_report( batch_state *bs, long long ns )
+{
+    int i,failed = 0;
+    long long bytes = 0;
+    fprintf( stderr, "html\tbytes\tms\tmarkup_ms\tcull_ms\tmatrix_ms"
+        "\tbuild_ms\tprint_ms\tresult\n" );
+    for ( i=0;i<bs->num_jobs;i++ )
+    {
+        batch_job *j = &bs->jobs[i];
+        stats_block *s = &j->stats;
+        fprintf( stderr, "%s\t%lld\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t%s\n",
+            j->html_name, j->bytes, j->ns/1e6, s->ns[STATS_MARKUP]/1e6,
+            s->ns[STATS_CULL]/1e6, s->ns[STATS_MATRIX]/1e6, 
+            s->ns[STATS_BUILD]/1e6, s->ns[STATS_PRINT]/1e6,
+            j->res?"ok":"failed" );
+        bytes += j->bytes;
+        if ( !j->res )
+            failed++;
+    }
+    fprintf( stderr, "formatter: rendered %d, failed %d, %.1f MB in "
+        "%.1f ms on %d threads (%.1f MB/s)\n", bs->num_jobs-failed, failed, 
+        bytes/1e6, ns/1e6, bs->num_threads, (ns>0)?bytes*1e3/ns:0.0 );
+    return failed;
+}
+/**
+ * Render every job in a manifest
+ * @param manifest the path to the manifest
+ * @param format the markup format of every job
+ * @param threads the number of threads or 0 for one per core
+ * @return 1 if every job was rendered, else 0
+ */
+int batch_run( const char *manifest, const char *format, int threads )
+{
+    int i,res = 0;
+    map_file *mf = map_file_open( manifest );
+    hashmap *sheets = hashmap_create();
+    if ( mf != NULL && sheets != NULL )
+    {
+        batch_state bs;
+        memset( &bs, 0, sizeof(batch_state) );
+        bs.format = format;
+        bs.num_threads = (threads>0)?threads
+            :(int)sysconf( _SC_NPROCESSORS_ONLN );
+        if ( bs.num_threads <= 0 )
+            bs.num_threads = 1;
+        bs.jobs = batch_read( map_file_data(mf), sheets, &bs.num_jobs );
+        if ( bs.jobs != NULL )
+        {
+            int complete = 1;
+            for ( i=0;i<bs.num_jobs;i++ )
+                if ( bs.jobs[i].css == NULL || bs.jobs[i].markup_files == NULL )
+                    complete = 0;
+            if ( bs.num_jobs > 0 && bs.num_threads > bs.num_jobs )
+                bs.num_threads = bs.num_jobs;
+            if ( complete )
+            {
+                long long start = stats_now();
+                if ( batch_all(&bs) )
+                    res = batch_report( &bs, stats_now()-start ) == 0;
+            }
+            for ( i=0;i<bs.num_jobs;i++ )
+                if ( bs.jobs[i].markup_files != NULL )
+                    file_list_delete( bs.jobs[i].markup_files );
+            free( bs.jobs );
+        }
+    }
+    else
+        warning("formatter: failed to read manifest %s\n",manifest);
+    if ( sheets != NULL )
+    {
+        hashmap_iterator *iter = hashmap_iterator_create( sheets );
+        if ( iter != NULL )
+        {
+            while ( hashmap_iterator_has_next(iter) )
+                css_sheet_dispose( hashmap_get(sheets,
+                    hashmap_iterator_next(iter)) );
+            hashmap_iterator_dispose( iter );
+        }
+        hashmap_dispose( sheets );
+    }
+    if ( mf != NULL )
+        map_file_close( mf );
+    return res;
+}
+#endif
@@ -0,0 +1,253 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bson.h"
+#include "error.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+/**
+ * Read the documents of a mongodump .bson file one at a time. The file
+ * is mapped, not read, so the documents and the strings found in them
+ * point into the mapping and stay valid until the file is closed.
+ */
+struct bson_file_struct
+{
+    int fd;
+    char *data;
+    int len;
+    int pos;
+};
+/**
+ * Read a little-endian 32-bit integer
+ * @param p the first of its 4 bytes
+ * @return its value
+ */
+static int bson_int32( const char *p )
+{
+    const unsigned char *u = (const unsigned char*)p;
+    return (int)(u[0]|(u[1]<<8)|(u[2]<<16)|((unsigned)u[3]<<24));
+}
+/**
+ * Map a bson file
+ * @param path the path to the file
+ * @return an open bson_file or NULL on failure
+ */
+bson_file *bson_file_open( const char *path )
+{
+    bson_file *bf = calloc( 1, sizeof(bson_file) );
+    if ( bf != NULL )
+    {
+        struct stat st;
+        bf->fd = open( path, O_RDONLY );
+        if ( bf->fd == -1 || fstat(bf->fd,&st) != 0 )
+        {
+            warning("bson: failed to open %s\n",path);
+            if ( bf->fd != -1 )
+                close( bf->fd );
+            free( bf );
+            return NULL;
+        }
+        bf->len = (int)st.st_size;
+        if ( bf->len > 0 )
+        {
+            bf->data = mmap( NULL, bf->len, PROT_READ, MAP_PRIVATE, bf->fd, 0 );
+            if ( bf->data == MAP_FAILED )
+            {
+                warning("bson: failed to map %s\n",path);
+                close( bf->fd );
+                free( bf );
+                return NULL;
+            }
+        }
+    }
+    else
+        warning("bson: failed to allocate file\n");
+    return bf;
+}
+/**
+ * Unmap a bson file. Documents returned from it are no longer valid.
+ * @param bf the file to close
+ */
+void bson_file_close( bson_file *bf )
+{
+    if ( bf->data != NULL )
+        munmap( bf->data, bf->len );
+    close( bf->fd );
+    free( bf );
+}
+/**
+ * Get the next document from the file
+ * @param bf the bson file
+ * @param len set to the length of the document in bytes
+ * @return the start of the document or NULL at the end or on error
+ */
+const char *bson_file_next( bson_file *bf, int *len )
+{
+    if ( bf->pos+5 <= bf->len )
+    {
+        int dlen = bson_int32( bf->data+bf->pos );
+        if ( dlen >= 5 && dlen <= bf->len-bf->pos )
+        {
+            const char *doc = bf->data+bf->pos;
+            bf->pos += dlen;
+            *len = dlen;
+            return doc;
+        }
+        else
+            warning("bson: bad document length %d at %d\n",dlen,bf->pos);
+    }
+    return NULL;
+}
+/**
+ * Work out the size of an element's value so it can be skipped
+ * @param type the element type
+ * @param value the start of its value
+ * @param left the number of bytes left in the document
+ * @return the size of the value or -1 if it is unknown or too long
+ */
+static int bson_value_size( int type, const char *value, int left )
+{
+    int size = -1;
+    switch ( type )
+    {
+        case 0x01: case 0x09: case 0x11: case 0x12:
+            size = 8;
+            break;
+        case 0x02: case 0x0D: case 0x0E:
+            if ( left >= 4 )
+                size = 4+bson_int32(value);
+            break;
+        case 0x03: case 0x04: case 0x0F:
+            if ( left >= 4 )
+                size = bson_int32(value);
+            break;
+        case 0x05:
+            if ( left >= 4 )
+                size = 5+bson_int32(value);
+            break;
+        case 0x07:
+            size = 12;
+            break;
+        case 0x08:
+            size = 1;
+            break;
+        case 0x0A: case 0x7F: case 0xFF:
+            size = 0;
+            break;
+        case 0x0B:
+        {
+            const char *end = memchr( value, 0, left );
+            if ( end != NULL )
+            {
+                const char *end2 = memchr( end+1, 0, left-(end+1-value) );
+                if ( end2 != NULL )
+                    size = end2+1-value;
+            }
+            break;
+        }
+        case 0x10:
+            size = 4;
+            break;
+        case 0x13:
+            size = 16;
+            break;
+    }
+    return (size<0||size>left)?-1:size;
+}
+/**
+ * Find a top-level string field in a document
+ * @param doc the document
+ * @param len its length in bytes
+ * @param key the name of the field
+ * @param slen set to the length of the string without its terminator
+ * @return the NUL-terminated string in the document or NULL if the key
+ * is absent or not a string
+ */
+const char *bson_get_string( const char *doc, int len, const char *key,
+    int *slen )
+{
+    int pos = 4;
+    while ( pos < len-1 )
+    {
+        int type = (unsigned char)doc[pos++];
+        const char *name = doc+pos;
+        const char *name_end = memchr( name, 0, len-pos );
+        int size;
+        if ( name_end == NULL )
+            break;
+        pos = name_end+1-doc;
+        size = bson_value_size( type, doc+pos, len-pos );
+        if ( size < 0 )
+        {
+            warning("bson: can't skip element type %d\n",type);
+            break;
+        }
+        if ( type == 0x02 && strcmp(name,key)==0 && size > 4 )
+        {
+            *slen = size-5;
+            return doc+pos+4;
+        }
+        pos += size;
+    }
+    return NULL;
+}
+/**
+ * Write a little-endian 32-bit integer
+ * @param dst the file to write to
+ * @param value the value to write
+ */
+static void bson_put_int32( FILE *dst, int value )
+{
+    fputc( value&0xFF, dst );
+    fputc( (value>>8)&0xFF, dst );
+    fputc( (value>>16)&0xFF, dst );
+    fputc( (value>>24)&0xFF, dst );
+}
+/**
+ * Append a document of string fields to a bson file
+ * @param dst the file open for writing
+ * @param keys the field names
+ * @param values their values
+ * @param lens the lengths of the values
+ * @param n the number of fields
+ * @return 1 if it was written, else 0
+ */
+int bson_write_strings( FILE *dst, const char **keys, const char **values,
+    const int *lens, int n )
+{
+    int i,len = 5;
+    for ( i=0;i<n;i++ )
+        len += 1+strlen(keys[i])+1+4+lens[i]+1;
+    bson_put_int32( dst, len );
+    for ( i=0;i<n;i++ )
+    {
+        fputc( 0x02, dst );
+        fwrite( keys[i], 1, strlen(keys[i])+1, dst );
+        bson_put_int32( dst, lens[i]+1 );
+        fwrite( values[i], 1, lens[i], dst );
+        fputc( 0, dst );
+    }
+    fputc( 0, dst );
+    return !ferror( dst );
+}
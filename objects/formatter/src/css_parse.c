@@ -33,10 +33,12 @@
 #include "hashset.h"
 #include "range.h"
 #include "range_array.h"
+#include "css_sheet.h"
 #include "formatter.h"
 #include "css_parse.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
 
 /**
@@ -177,7 +179,8 @@ static void print_css_rule( void *key )
  * properties in the markup file.
  * @param data the css data to parse
  * @param len its length
- * @param props the properties from all the markup files
+ * @param props the properties from all the markup files or NULL to 
+ * keep every rule
  * @param css store the css rules in here
  * @return 1 if it succeeded, else 0
  */
@@ -191,7 +194,7 @@ int css_parse( const char *data, int len, hashset *props, hashmap *css )
         {
             char *class_name = css_rule_get_class(rule);
             // only put into the css properties seen in the markup
-            if ( hashset_contains(props,class_name) )
+            if ( props == NULL || hashset_contains(props,class_name) )
             {
                 //fprintf(stderr,"adding class %s\n",class_name);
                 if ( hashmap_contains(css,class_name) )
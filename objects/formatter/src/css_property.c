@@ -22,6 +22,7 @@
 #include "css_property.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
 #define AESE_PREFIX "-aese-"
 #define AESE_PREFIX_LEN 6
@@ -30,6 +30,7 @@
 #include "css_rule.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
 struct css_rule_struct
 {
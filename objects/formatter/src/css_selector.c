@@ -22,6 +22,7 @@
 #include "css_selector.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
 /**
  * Represent a css selector (bit on the left of a css rule)
@@ -0,0 +1,118 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include "hashmap.h"
+#include "hashset.h"
+#include "css_selector.h"
+#include "css_property.h"
+#include "css_rule.h"
+#include "css_parse.h"
+#include "css_sheet.h"
+#include "error.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+/**
+ * The parsed rules of one or more css files, indexed by class name.
+ * Once parsed the rules are only read, so one sheet can be shared by 
+ * formatters on several threads.
+ */
+struct css_sheet_struct
+{
+    hashmap *rules;
+};
+/**
+ * Create a css sheet containing just the root rule
+ * @return the sheet or NULL
+ */
+css_sheet *css_sheet_create()
+{
+    css_sheet *cs = calloc( 1, sizeof(css_sheet) );
+    if ( cs != NULL )
+    {
+        cs->rules = hashmap_create();
+        if ( cs->rules == NULL )
+        {
+            css_sheet_dispose( cs );
+            return NULL;
+        }
+        else
+        {
+            css_rule *root = css_rule_create();
+            css_selector *sel = css_selector_create( NULL, "root");
+            if ( root==NULL || sel==NULL || !css_rule_add_selector(root,sel) )
+            {
+                warning("could not add root selector to css rules\n");
+                css_sheet_dispose( cs );
+                return NULL;
+            }
+            else
+                hashmap_put( cs->rules, "root", root );
+        }
+    }
+    else
+        warning("css_sheet: failed to allocate sheet\n");
+    return cs;
+}
+/**
+ * Dispose of a css sheet and all its rules
+ * @param cs the sheet to free
+ */
+void css_sheet_dispose( css_sheet *cs )
+{
+    if ( cs->rules != NULL )
+    {
+        hashmap_iterator *iter = hashmap_iterator_create( cs->rules );
+        if ( iter != NULL )
+        {
+            while ( hashmap_iterator_has_next(iter) )
+            {
+                char *key = hashmap_iterator_next( iter );
+                css_rule *rule = hashmap_get( cs->rules, key );
+                css_rule_dispose( rule );
+            }
+            hashmap_iterator_dispose(iter);
+        }
+        hashmap_dispose( cs->rules );
+    }
+    free( cs );
+}
+/**
+ * Add the rules of a css file to the sheet. Later rules replace 
+ * earlier ones for the same class.
+ * @param cs the sheet
+ * @param data the css data
+ * @param len its length
+ * @param props keep only rules for these properties, or NULL to keep 
+ * them all, e.g. for a sheet shared by several texts
+ * @return 1 if it succeeded, else 0
+ */
+int css_sheet_parse( css_sheet *cs, const char *data, int len, 
+    hashset *props )
+{
+    return css_parse( data, len, props, cs->rules );
+}
+/**
+ * Get the rules for the dom, which must not change them
+ * @param cs the sheet
+ * @return the rules indexed by class name
+ */
+hashmap *css_sheet_rules( css_sheet *cs )
+{
+    return cs->rules;
+}
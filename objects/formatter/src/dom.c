@@ -38,11 +38,15 @@
 #include "css_selector.h"
 #include "css_rule.h"
 #include "error.h"
+#include "stats.h"
+#include "probes.h"
 #include "HTML.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
 #define BUFLEN 1024
 #define TEXT_BUF_SIZE 10000
+#define DOM_STACK_SIZE 32
 
 /**
  * Represent a document object model to test the dom-building algorithm 
@@ -59,8 +63,28 @@ struct dom_struct
     range_array *ranges;
     /** css rules indexed by class name */
     hashmap *css_rules;
+    /** storage for all the nodes of the tree */
+    node_pool *nodes;
     node *root;
 };
+/**
+ * A node being traversed: the last child visited and the next one
+ */
+typedef struct dom_frame_struct
+{
+    node *n;
+    node *prev;
+    node *c;
+} dom_frame;
+/**
+ * Explicit stack of frames for walking the tree without recursion
+ */
+typedef struct dom_stack_struct
+{
+    dom_frame *frames;
+    int top;
+    int size;
+} dom_stack;
 static void dom_add_node( dom *d, node *n, node *r );
 static void dom_range_inside_node( dom *d, node *n, node *r );
 
@@ -181,8 +205,9 @@ static int dom_filter_ranges( dom *d, range_array *ranges )
 static node *dom_range_to_node( dom *d, range *r )
 {
     char *html_name = range_html_name(r);
-    node *n = node_create( range_name(r),range_html_name(r),range_start(r),
-        range_len(r), (html_name==NULL)?0:html_is_empty(html_name), 
+    node *n = node_create( d->nodes, range_name(r), range_html_name(r),
+        range_start(r), range_len(r), 
+        (html_name==NULL)?0:html_is_empty(html_name), 
         range_get_rightmost(r) );
     if ( n != NULL )
     {
@@ -247,7 +272,9 @@ dom *dom_create( const char *text, int len, range_array *ranges,
                 if ( range_array_size(ranges) > 0 )
                 {
                     d->q = queue_create();
-                    if ( d->q == NULL || !dom_filter_ranges(d,ranges) )
+                    d->nodes = node_pool_create( range_array_size(ranges) );
+                    if ( d->q == NULL || d->nodes == NULL 
+                        || !dom_filter_ranges(d,ranges) )
                     {
                         dom_dispose( d );
                         return NULL;
@@ -265,9 +292,11 @@ dom *dom_create( const char *text, int len, range_array *ranges,
                     }
                     else
                     {
+                        long long start = stats_enter( STATS_MATRIX );
                         range_array_sort( d->ranges );
                         matrix_init( d->pm, d->ranges );
                         matrix_update_html( d->pm );
+                        stats_time( STATS_MATRIX, start );
                     }
                 }
                 else
@@ -294,18 +323,44 @@ dom *dom_create( const char *text, int len, range_array *ranges,
     return d;
 }
 /**
- * Dispose of the whole tree recursively. node_dispose just kills one node
- * @param n the node to start from
+ * Create an empty stack of traversal frames
+ * @param s the stack to initialise
+ * @return 1 if it worked else 0
  */
-static void dom_dispose_node( node *n )
+static int dom_stack_init( dom_stack *s )
 {
-    node *next = node_next_sibling( n );
-    node *child = node_first_child( n );
-    node_dispose( n );
-    if ( next != NULL )
-        dom_dispose_node( next );
-    if ( child != NULL )
-        dom_dispose_node( child );
+    s->top = 0;
+    s->size = DOM_STACK_SIZE;
+    s->frames = malloc( s->size*sizeof(dom_frame) );
+    if ( s->frames == NULL )
+        warning("dom: failed to allocate traversal stack\n");
+    return s->frames != NULL;
+}
+/**
+ * Push a node onto the traversal stack, ready to visit its children
+ * @param s the stack to push it onto
+ * @param n the node whose children are next
+ * @return 1 if it worked else 0
+ */
+static int dom_stack_push( dom_stack *s, node *n )
+{
+    if ( s->top == s->size )
+    {
+        int new_size = s->size*2;
+        dom_frame *frames = realloc( s->frames, new_size*sizeof(dom_frame) );
+        if ( frames == NULL )
+        {
+            warning("dom: failed to grow traversal stack\n");
+            return 0;
+        }
+        s->frames = frames;
+        s->size = new_size;
+    }
+    s->frames[s->top].n = n;
+    s->frames[s->top].prev = NULL;
+    s->frames[s->top].c = node_first_child( n );
+    s->top++;
+    return 1;
 }
 /**
  * Dispose of the dom
@@ -315,8 +370,8 @@ void dom_dispose( dom *d )
 {
     if ( d->ranges != NULL )
         range_array_dispose( d->ranges, 1 );
-    if ( d->root != NULL )
-        dom_dispose_node( d->root );
+    if ( d->nodes != NULL )
+        node_pool_dispose( d->nodes );
     if ( d->pm != NULL )
         matrix_dispose( d->pm );
     if ( d->buf != NULL  )
@@ -333,6 +388,7 @@ void dom_dispose( dom *d )
 int dom_build( dom *d )
 {
     int res = 1;
+    PROBE1( build__entry, d->text_len );
     while ( !queue_empty(d->q) )
     {
         range *rx = queue_pop( d->q );
@@ -352,6 +408,7 @@ int dom_build( dom *d )
         }
     }
     //matrix_dump( d->pm );
+    PROBE2( build__return, d->text_len, res );
     return res;
 }
 /**
@@ -397,14 +454,12 @@ static void dom_print_text( dom *d, int offset, int len )
         warning("dom: failed to allocate string for printing\n");
 }
 /**
- * Print a single node and its children, siblings
+ * Print the start of a node: its opening tag
  * @param d the dom in question
- * @param n the node to print
+ * @param n the node to open
  */
-static void dom_print_node( dom *d, node *n )
+static void dom_print_open( dom *d, node *n )
 {
-	node *c;
-    int start,end;
     char *html_name = node_html_name(n);
     char *class_name = node_name(n);
     char attrs[128];
@@ -416,20 +471,15 @@ static void dom_print_node( dom *d, node *n )
                 +strlen(class_name)+strlen(attrs)+11, html_name, 
                 attrs, class_name );
     }
-    c = node_first_child(n);
-    start = node_offset(n);
-    end = node_end(n);
-    while ( c != NULL )
-    {
-        int pos = node_offset( c );
-        if ( pos > start )
-            dom_print_text( d, start, pos-start );
-        dom_print_node( d, c );
-        start = node_end( c );
-        c = node_next_sibling( c );
-    }
-    if ( end > start )
-        dom_print_text( d, start, end-start );
+}
+/**
+ * Print the end of a node: its closing tag or empty element
+ * @param d the dom in question
+ * @param n the node to close
+ */
+static void dom_print_close( dom *d, node *n )
+{
+    char *html_name = node_html_name(n);
     if ( !node_is_root(n) )
     {
         if ( !node_empty(n) )
@@ -438,6 +488,49 @@ static void dom_print_node( dom *d, node *n )
             dom_concat(d,"<%s>",strlen(html_name)+2,html_name);
     }
 }
+/**
+ * Print a node and all its descendants, using an explicit stack so that 
+ * neither deep nor long flat trees can overflow the native stack
+ * @param d the dom in question
+ * @param n the node to print
+ */
+static void dom_print_node( dom *d, node *n )
+{
+    dom_stack s;
+    if ( dom_stack_init(&s) )
+    {
+        dom_print_open( d, n );
+        if ( dom_stack_push(&s,n) )
+        {
+            while ( s.top > 0 )
+            {
+                dom_frame *f = &s.frames[s.top-1];
+                int start = (f->prev!=NULL)?node_end(f->prev):node_offset(f->n);
+                if ( f->c != NULL )
+                {
+                    node *c = f->c;
+                    int pos = node_offset( c );
+                    if ( pos > start )
+                        dom_print_text( d, start, pos-start );
+                    f->prev = c;
+                    f->c = node_next_sibling( c );
+                    dom_print_open( d, c );
+                    if ( !dom_stack_push(&s,c) )
+                        break;
+                }
+                else
+                {
+                    int end = node_end( f->n );
+                    if ( end > start )
+                        dom_print_text( d, start, end-start );
+                    dom_print_close( d, f->n );
+                    s.top--;
+                }
+            }
+        }
+        free( s.frames );
+    }
+}
 /**
  * Print the entire tree
  * @param d the tree to print
@@ -594,6 +687,8 @@ static void dom_make_parent( dom *d, node *n, node *r )
  */
 static void dom_drop_notify( dom *d, node *r, node *n )
 {
+    PROBE2( drop__entry, node_offset(r), node_end(r) );
+    stats_count( STATS_DROPS, 1 );
     warning("dom: dropping %s at %d:%d - %s and %s incompatible\n",
         node_name(r),node_offset(r),
         node_end(r),node_html_name(r),node_html_name(n));
@@ -605,6 +700,7 @@ static void dom_drop_notify( dom *d, node *r, node *n )
             printf( "aha! dropping id %s\n",value );
     }
     node_dispose( r );
+    PROBE0( drop__return );
 }
 /**
  * Handle the case where node and range are equal
@@ -796,30 +892,33 @@ static void dom_range_overlaps_right( dom *d, node *n, node *r )
  */
 static void dom_add_node( dom *d, node *n, node *r )
 {
+    PROBE2( add_node__entry, node_offset(r), node_end(r) );
     n = node_align_sibling( n, r );
-    if ( n == NULL )
-        return;
-    else if ( node_encloses_range(n,r) )
-    {
-        dom_range_inside_node(d,n,r);
-    }
-    else if ( range_encloses_node(n,r) )
-    {
-        dom_node_inside_range( d, n, r );
-    }
-    else if ( node_overlaps_on_right(n,r) )
-    {
-        dom_range_overlaps_right( d, n, r );
-    }
-    else if ( node_overlaps_on_left(n,r) )
-    {
-        dom_range_overlaps_left( d, n, r );
-    }
-    else
+    if ( n != NULL )
     {
-        dom_node_equals( d, n, r );
+        if ( node_encloses_range(n,r) )
+        {
+            dom_range_inside_node(d,n,r);
+        }
+        else if ( range_encloses_node(n,r) )
+        {
+            dom_node_inside_range( d, n, r );
+        }
+        else if ( node_overlaps_on_right(n,r) )
+        {
+            dom_range_overlaps_right( d, n, r );
+        }
+        else if ( node_overlaps_on_left(n,r) )
+        {
+            dom_range_overlaps_left( d, n, r );
+        }
+        else
+        {
+            dom_node_equals( d, n, r );
+        }
     }
     //dom_check_tree( d );
+    PROBE0( add_node__return );
 }
 /**
  * Debug routine: check output to see if well-formed
@@ -865,47 +964,61 @@ text_buf *dom_get_text_buf( dom *d )
     return d->buf;
 }
 /**
- * Check a single tree-node, recursively
+ * Check a tree-node and all its descendants. Stops at the first error.
+ * @param n the node to start from
+ * @return 1 if the subtree was OK, 0 otherwise
  */
 static int dom_check_node( node *n )
 {
     int res = 1;
-    int start = node_offset(n);
-    int end = node_end(n);
-    node *c = node_first_child(n);
-    node *prev = NULL;
-    while ( c != NULL )
+    dom_stack s;
+    if ( !dom_stack_init(&s) || !dom_stack_push(&s,n) )
+        res = 0;
+    while ( res && s.top > 0 )
     {
-        node *next = node_next_sibling( c );
-        if ( node_offset(c)<start )
-        {
-            warning("dom: invalid offset %d < parent start %d\n",node_offset(c),
-                start);
-            return 0;
-        }
-        else if ( node_end(c)>end )
+        dom_frame *f = &s.frames[s.top-1];
+        node *c = f->c;
+        if ( c != NULL )
         {
-            warning("dom: invalid end %d (%s) > parent end %d (%s)\n",
-                node_end(c), node_name(c), end, node_name(n) );
-            return 0;
-        }
-        else if ( prev != NULL && node_end(prev)>node_offset(c) )
-        {
-            warning("dom: prev node ending %d encroaches on child node at %d\n",
-                node_end(prev), node_offset(c));
-            return 0;
-        }
-        else if ( next != NULL && node_end(c)>node_offset(next) )
-        {
-            warning("dom: next node starting %d encroaches on child node ending at %d\n",
-                node_offset(next), node_end(c));
-            return 0;
+            node *p = f->n;
+            node *prev = f->prev;
+            node *next = node_next_sibling( c );
+            if ( node_offset(c)<node_offset(p) )
+            {
+                warning("dom: invalid offset %d < parent start %d\n",
+                    node_offset(c),node_offset(p));
+                res = 0;
+            }
+            else if ( node_end(c)>node_end(p) )
+            {
+                warning("dom: invalid end %d (%s) > parent end %d (%s)\n",
+                    node_end(c), node_name(c), node_end(p), node_name(p) );
+                res = 0;
+            }
+            else if ( prev != NULL && node_end(prev)>node_offset(c) )
+            {
+                warning("dom: prev node ending %d encroaches on child node at %d\n",
+                    node_end(prev), node_offset(c));
+                res = 0;
+            }
+            else if ( next != NULL && node_end(c)>node_offset(next) )
+            {
+                warning("dom: next node starting %d encroaches on child node ending at %d\n",
+                    node_offset(next), node_end(c));
+                res = 0;
+            }
+            else
+            {
+                f->prev = c;
+                f->c = next;
+                res = dom_stack_push( &s, c );
+            }
         }
         else
-            res = dom_check_node( c );
-        prev = c;
-        c = node_next_sibling( c );
+            s.top--;
     }
+    if ( s.frames != NULL )
+        free( s.frames );
     return res;
 }
 /**
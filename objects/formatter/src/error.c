@@ -20,7 +20,7 @@
 #include <stdio.h>
 #include "error.h"
 #include "memwatch.h"
-static char message[256];
+#include "stats_alloc.h"
 /**
  * Report an error. 
  * @param fmt the format of the error message
@@ -28,6 +28,7 @@ static char message[256];
  */
 static void display_error( const char *fmt, va_list l )
 {
+    char message[256];
     vsnprintf( message, 255, fmt, l );
     fprintf( stderr, "%s", message );
 }
@@ -23,6 +23,7 @@
 #include "file_list.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 #define BLOCK_SIZE 8
 /**
  A file list can be used as here for storing and maintaining a list of files 
@@ -220,7 +221,8 @@ int file_list_load( file_list *fl, int index, char **data, int *len )
                 int flen = get_file_length( fp );
                 if ( flen > 0 )
                 {
-                    *data = malloc( flen );
+                    // terminate it for parsers that need a C string
+                    *data = malloc( flen+1 );
                     if ( *data == NULL )
                         error( "file_list: no memory for markup\n" );
                     else
@@ -236,6 +238,7 @@ int file_list_load( file_list *fl, int index, char **data, int *len )
                         }
                         else
                         {
+                            (*data)[n] = 0;
                             *len = n;
                             res = 1;
                         }
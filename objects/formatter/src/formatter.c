@@ -19,12 +19,15 @@
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
 #include "hashmap.h"
 #include "attribute.h"
 #include "annotation.h"
 #include "range.h"
 #include "hashset.h"
 #include "range_array.h"
+#include "range_table.h"
+#include "css_sheet.h"
 #include "formatter.h"
 #include "css_selector.h"
 #include "css_property.h"
@@ -35,7 +38,9 @@
 #include "text_buf.h"
 #include "dom.h"
 #include "error.h"
+#include "stats.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
 
 #define RANGES_BLOCK_SIZE 256
@@ -43,7 +48,9 @@
 struct formatter_struct
 {
     range_array *ranges;
-    hashmap *css_rules;
+    css_sheet *css;
+    /** set if the css belongs to someone else */
+    int shared_css;
     hashset *properties;
     dom *tree;
 };
@@ -62,25 +69,12 @@ formatter *formatter_create( int len )
             formatter_dispose( f );
             return NULL;
         }
-        f->css_rules = hashmap_create();
-        if ( f->css_rules == NULL )
+        f->css = css_sheet_create();
+        if ( f->css == NULL )
         {
             formatter_dispose( f );
             return NULL;
         }
-        else
-        {
-            css_rule *root = css_rule_create();
-            css_selector *sel = css_selector_create( NULL, "root");
-            if ( root==NULL || sel==NULL || !css_rule_add_selector(root,sel) )
-            {
-                warning("could not add root selector to css rules\n");
-                formatter_dispose( f );
-                return NULL;
-            }
-            else
-                hashmap_put( f->css_rules, "root", root );
-        }
         f->properties = hashset_create();
         if ( f->properties == NULL )
         {
@@ -102,21 +96,8 @@ void formatter_dispose( formatter *f )
 {
     if ( f->ranges != NULL )
         range_array_dispose( f->ranges, 1 );
-    if ( f->css_rules != NULL )
-    {
-        hashmap_iterator *iter = hashmap_iterator_create( f->css_rules );
-        if ( iter != NULL )
-        {
-            while ( hashmap_iterator_has_next(iter) )
-            {
-                char *key = hashmap_iterator_next( iter );
-                css_rule *rule = hashmap_get( f->css_rules, key );
-                css_rule_dispose( rule );
-            }
-            hashmap_dispose( f->css_rules );
-            hashmap_iterator_dispose(iter);
-        }
-    }
+    if ( f->css != NULL && !f->shared_css )
+        css_sheet_dispose( f->css );
     if ( f->properties != NULL )
         hashset_dispose( f->properties );
     if ( f->tree != NULL )
@@ -132,7 +113,20 @@ void formatter_dispose( formatter *f )
  */
 int formatter_css_parse( formatter *f, const char *data, int len )
 {
-    return css_parse( data, len, f->properties, f->css_rules );
+    return css_sheet_parse( f->css, data, len, f->properties );
+}
+/**
+ * Use a sheet of already parsed css instead of parsing it again. Any 
+ * css parsed so far is discarded.
+ * @param f the formatter to apply it to
+ * @param cs the sheet, which must outlive the formatter
+ */
+void formatter_use_css( formatter *f, css_sheet *cs )
+{
+    if ( f->css != NULL && !f->shared_css )
+        css_sheet_dispose( f->css );
+    f->css = cs;
+    f->shared_css = 1;
 }
 /**
  * Load the markup of a single file contents
@@ -150,6 +144,184 @@ int formatter_load_markup( formatter *f, load_markup_func mfunc,
         range_array_sort( f->ranges );
     return res;
 }
+/** one markup layer being loaded on its own thread */
+typedef struct
+{
+    load_markup_func mfunc;
+    const char *data;
+    int len;
+    range_array *ranges;
+    hashset *props;
+    int res;
+    int started;
+    pthread_t thread;
+    /** what the layer's thread allocated */
+    stats_block stats;
+} layer_load;
+/**
+ * Parse and sort one layer into its own ranges
+ * @param l the layer
+ */
+static void formatter_layer_load( layer_load *l )
+{
+    l->res = (l->mfunc)( l->data, l->len, l->ranges, l->props );
+    if ( l->res )
+        range_array_sort( l->ranges );
+}
+/**
+ * Load one layer on a thread of its own
+ * @param arg the layer_load
+ * @return NULL
+ */
+static void *formatter_layer_thread( void *arg )
+{
+    layer_load *l = arg;
+    stats_begin();
+    stats_enter( STATS_MARKUP );
+    formatter_layer_load( l );
+    stats_current( &l->stats );
+    return NULL;
+}
+/**
+ * Add a layer's property names in the order the layer found them, so 
+ * their ids are the same as if it had been loaded on its own
+ * @param f the formatter in question
+ * @param props the layer's property names
+ * @return 1 if it worked, else 0
+ */
+static int formatter_add_properties( formatter *f, hashset *props )
+{
+    int i,n = hashset_size( props );
+    char **items = calloc( (n>0)?n:1, sizeof(char*) );
+    if ( items != NULL )
+    {
+        char **ordered = calloc( (n>0)?n:1, sizeof(char*) );
+        if ( ordered != NULL )
+        {
+            hashset_to_array( props, items );
+            for ( i=0;i<n;i++ )
+            {
+                int id = hashset_get( props, items[i] );
+                if ( id > 0 && id <= n )
+                    ordered[id-1] = items[i];
+            }
+            for ( i=0;i<n;i++ )
+                if ( ordered[i] != NULL 
+                    && !hashset_contains(f->properties,ordered[i]) )
+                    hashset_put( f->properties, ordered[i] );
+            free( ordered );
+        }
+        free( items );
+        return ordered != NULL;
+    }
+    return 0;
+}
+/**
+ * Load several markup layers of the same text at once. Each is parsed 
+ * and sorted on its own thread, then the sorted layers are merged in one 
+ * pass, so the whole takes about as long as the biggest layer.
+ * @param f the formatter in question
+ * @param mfuncs the markup function for loading each layer
+ * @param data the data of each layer
+ * @param lens their lengths
+ * @param n the number of layers
+ * @return 1 if they all loaded, else 0 and none are added
+ */
+int formatter_load_layers( formatter *f, load_markup_func *mfuncs, 
+    const char **data, int *lens, int n )
+{
+    int i,res = 1;
+    layer_load *layers = calloc( (n>0)?n:1, sizeof(layer_load) );
+    if ( layers == NULL )
+    {
+        warning("formatter: failed to allocate layers\n");
+        return 0;
+    }
+    for ( i=0;i<n&&res;i++ )
+    {
+        layers[i].mfunc = mfuncs[i];
+        layers[i].data = data[i];
+        layers[i].len = lens[i];
+        layers[i].ranges = range_array_create();
+        layers[i].props = hashset_create();
+        res = layers[i].ranges != NULL && layers[i].props != NULL;
+    }
+    if ( res )
+    {
+        // the calling thread loads the first layer itself
+        for ( i=1;i<n;i++ )
+            layers[i].started = pthread_create( &layers[i].thread, NULL, 
+                formatter_layer_thread, &layers[i] ) == 0;
+        for ( i=0;i<n;i++ )
+        {
+            if ( i == 0 || !layers[i].started )
+                formatter_layer_load( &layers[i] );
+            else
+            {
+                pthread_join( layers[i].thread, NULL );
+                stats_adopt( &layers[i].stats );
+            }
+        }
+        for ( i=0;i<n&&res;i++ )
+            res = layers[i].res;
+        for ( i=0;i<n&&res;i++ )
+            res = formatter_add_properties( f, layers[i].props );
+        if ( res )
+        {
+            range_array **runs = calloc( (n>0)?n:1, sizeof(range_array*) );
+            if ( runs != NULL )
+            {
+                for ( i=0;i<n;i++ )
+                    runs[i] = layers[i].ranges;
+                res = range_array_merge( f->ranges, runs, n );
+                free( runs );
+            }
+            else
+                res = 0;
+        }
+    }
+    for ( i=0;i<n;i++ )
+    {
+        // merged ranges now belong to f, so this frees only failed loads
+        if ( layers[i].ranges != NULL )
+            range_array_dispose( layers[i].ranges, 1 );
+        if ( layers[i].props != NULL )
+            hashset_dispose( layers[i].props );
+    }
+    free( layers );
+    return res;
+}
+/**
+ * Add a single range that didn't come from a markup file. The ranges 
+ * must be sorted with formatter_sort_ranges before use.
+ * @param f the formatter in question
+ * @param r the range, which now belongs to the formatter
+ * @return 1 if it was added, else 0
+ */
+int formatter_add_range( formatter *f, range *r )
+{
+    char *r_name = range_name( r );
+    if ( !hashset_contains(f->properties,r_name) )
+        hashset_put( f->properties, r_name );
+    return range_array_add( f->ranges, r );
+}
+/**
+ * Sort the ranges after adding them one at a time
+ * @param f the formatter in question
+ */
+void formatter_sort_ranges( formatter *f )
+{
+    range_array_sort( f->ranges );
+}
+/**
+ * Get the loaded ranges
+ * @param f the formatter in question
+ * @return the ranges sorted on start offset
+ */
+range_array *formatter_get_ranges( formatter *f )
+{
+    return f->ranges;
+}
 /**
  * Make HTML using the already loaded markup and css data
  * @param f the formatter in question
@@ -160,10 +332,19 @@ int formatter_load_markup( formatter *f, load_markup_func mfunc,
 int formatter_make_html( formatter *f, const char *text, int len )
 {
     int res = 0;
-    f->tree = dom_create( text, len, f->ranges, f->css_rules, f->properties );
+    // a master may render a window and then the whole text
+    if ( f->tree != NULL )
+    {
+        dom_dispose( f->tree );
+        f->tree = NULL;
+    }
+    f->tree = dom_create( text, len, f->ranges, 
+        css_sheet_rules(f->css), f->properties );
     if ( f->tree != NULL )
     {
+        long long start = stats_enter( STATS_BUILD );
         res = dom_build( f->tree );
+        stats_time( STATS_BUILD, start );
     }
     return res;
 }
@@ -192,11 +373,14 @@ int formatter_save_html( formatter *f, char *file )
  */
 char *formatter_get_html( formatter *f, int *len )
 {
+    long long start = stats_enter( STATS_PRINT );
     dom_print( f->tree );
+    stats_time( STATS_PRINT, start );
     text_buf *tb = dom_get_text_buf( f->tree );
     if ( tb != NULL )
     {
         *len = text_buf_len( tb );
+        stats_count( STATS_OUTPUT_BYTES, *len );
         return text_buf_get_buf( tb );
     }
     else
@@ -211,48 +395,33 @@ static int MAX( int a, int b )
     return (a>b)?a:b;
 }
 /**
- * How many characters overlap between ranges a and b?
- * @param a the first range
- * @param b the second range
- * @return the number of overlapping chars
- */
-static int overlap( range *a, range *b )
-{
-    int overlap = MIN(range_end(a),range_end(b))
-        -MAX(range_start(a),range_start(b));
-    return (overlap>0)?overlap:0;
-}
-/**
- * Remove a set of ranges from the text. The ranges might overlap.
- * @param removals the array of removals
+ * Remove a set of cuts from the text
+ * @param cuts the starts and ends of the cuts, sorted and separated by gaps
+ * @param n_cuts the number of cuts
  * @param text the text to adjust
  * @param len its length on entry; its new length on exit
  * @return the modified text (not a copy)
  */
-static char *remove_text( range_array *removals, char *text, int *len )
+static char *remove_text( int *cuts, int n_cuts, char *text, int *len )
 {
     int from = 0;
     int to = 0;
     int i;
-    for ( i=0;i<range_array_size(removals);i++ )
+    for ( i=0;i<n_cuts;i++ )
     {
-        range *r = range_array_get( removals, i );
-        if ( from < range_start(r) )
+        int prefix_len = cuts[2*i]-from;
+        if ( prefix_len > 0 )
         {
-            int prefix_len = range_start(r)-from;
-            if ( prefix_len > 0 )
-            {
-                if ( from > to )
-                    memcpy( &text[to], &text[from], prefix_len );
-                to += prefix_len;
-            }
-            from = range_end( r );
+            if ( from > to )
+                memmove( &text[to], &text[from], prefix_len );
+            to += prefix_len;
         }
+        from = cuts[2*i+1];
     }
     // copy bit left over at end
     if ( from > to )
     {
-        memcpy( &text[to], &text[from], *len-from );
+        memmove( &text[to], &text[from], *len-from );
         to += *len-from;
         *len = to;
         text[*len] = 0;
@@ -299,8 +468,34 @@ static int formatter_add_root_range( formatter *f, int tlen )
     }
     return res;
 }
+/**
+ * Find how many cuts end at or before an offset
+ * @param cuts the starts and ends of the cuts, sorted and separated by gaps
+ * @param n_cuts the number of cuts
+ * @param offset the offset
+ * @param ends 1 to search the cut ends, 0 to count cuts starting before it
+ * @return the number of cuts
+ */
+static int cuts_before( int *cuts, int n_cuts, int offset, int ends )
+{
+    int bot = 0;
+    int top = n_cuts;
+    while ( bot < top )
+    {
+        int mid = (bot+top)/2;
+        if ( (ends && cuts[2*mid+1] <= offset) 
+            || (!ends && cuts[2*mid] < offset) )
+            bot = mid+1;
+        else
+            top = mid;
+    }
+    return bot;
+}
 /**
  * Actually remove ranges and any overlapping parts of non-removed ranges.
+ * The removed ranges are first merged into cuts separated by gaps. Then 
+ * each kept range is moved left by the cuts before it and shortened by 
+ * those inside it, found by binary search over the cuts.
  * @param f the formatter instance
  * @param text the text to update
  * @param len its length
@@ -308,73 +503,191 @@ static int formatter_add_root_range( formatter *f, int tlen )
  */
 static int formatter_remove_ranges( formatter *f, char *text, int *len )
 {
-    range_array *removals = range_array_create();
-    if ( removals != NULL )
+    int res = 0;
+    range_table *rt = range_table_create( f->ranges, NULL );
+    int n = (rt==NULL)?0:range_table_size( rt );
+    int *cuts = calloc( 2*n+1, sizeof(int) );
+    int *cut_lens = calloc( n+1, sizeof(int) );
+    range_array *kept = range_array_create();
+    if ( rt != NULL && !range_table_is_sorted(rt) )
     {
-        int i,j,N;
-        for ( i=0;i<range_array_size(f->ranges);i++ )
-        {
-            range *r = range_array_get( f->ranges, i );
-            if ( range_get_removed(r) )
-                range_array_add( removals, range_copy(r) );
-        }
-        // now we have foreknowledge of all the removals
-        // merge them wherever possible
-        range_array_sort( removals );
-        i = 0;
-        // all ranges in removals must be separated by gaps
-        while ( i < range_array_size(removals)-1 )
+        // ranges were added singly and not sorted
+        range_table_dispose( rt );
+        range_array_sort( f->ranges );
+        rt = range_table_create( f->ranges, NULL );
+    }
+    if ( rt != NULL && cuts != NULL && cut_lens != NULL && kept != NULL )
+    {
+        int i,n_cuts = 0;
+        int *starts = range_table_starts( rt );
+        int *lens = range_table_lens( rt );
+        unsigned char *flags = range_table_flags( rt );
+        range **ranges = range_table_ranges( rt );
+        // the ranges are sorted, so the removals are in order
+        for ( i=0;i<n;i++ )
         {
-            range *r = range_array_get( removals, i );
-            range *s = range_array_get( removals, i+1 );
-            if ( range_end(r)>=range_start(s) )
+            if ( flags[i]&RANGE_TABLE_REMOVED )
             {
-                range_set_len( r,MAX(range_end(r),range_end(s))-range_start(r));
-                range_array_remove( removals, i+1, 1 );
+                int end = starts[i]+lens[i];
+                if ( n_cuts > 0 && cuts[2*n_cuts-1] >= starts[i] )
+                    cuts[2*n_cuts-1] = MAX(cuts[2*n_cuts-1],end);
+                else
+                {
+                    cuts[2*n_cuts] = starts[i];
+                    cuts[2*n_cuts+1] = end;
+                    n_cuts++;
+                }
             }
-            else
-                i++;
         }
-        N=range_array_size( removals );
-        i = 0;
-        //range_array_print( removals, -1 );
-        while ( i < range_array_size(f->ranges) )
+        // cut_lens[k] is the length of the first k cuts
+        for ( i=0;i<n_cuts;i++ )
+            cut_lens[i+1] = cut_lens[i]+cuts[2*i+1]-cuts[2*i];
+        res = 1;
+        for ( i=0;i<n&&res;i++ )
         {
-            range *r = range_array_get(f->ranges,i);
-            if ( !range_get_removed(r) )
+            range *r = ranges[i];
+            if ( !(flags[i]&RANGE_TABLE_REMOVED) )
             {
+                int start = starts[i];
+                int end = start+lens[i];
+                // only cut k can hold the start, only cut j-1 the end
+                int k = cuts_before( cuts, n_cuts, start, 1 );
+                int j = cuts_before( cuts, n_cuts, end, 0 );
+                // number of chars to move r left
+                int move_left = cut_lens[k];
                 // how much needs to be removed from r
                 int removal = 0;
-                // number of chars to move r left
-                int move_left = 0;
-                for ( j=0;j<N;j++ )
+                if ( k < n_cuts && cuts[2*k] < start )
+                    move_left += start-cuts[2*k];
+                if ( j > k )
+                {
+                    removal = cut_lens[j]-cut_lens[k];
+                    removal -= MAX(0,start-cuts[2*k]);
+                    removal -= MAX(0,cuts[2*(j-1)+1]-end);
+                }
+                // r is freed once the cull has succeeded
+                if ( removal == lens[i] )
                 {
-                    range *q = range_array_get( removals, j );
-                    if ( range_end(q) <= range_start(r) )
-                        move_left += range_len(q);
-                    else if ( range_start(q)<range_start(r) )
-                        move_left += range_start(r)-range_start(q);
-                    removal += overlap( q, r );
+                    flags[i] |= CULL_DROPPED;
+                    continue;
                 }
-                if ( removal == range_len(r) )
-                    range_array_remove( f->ranges, i--, 1 );
-                else if ( removal > 0 )
-                    range_set_len( r, range_len(r)-removal );
+                if ( removal > 0 )
+                    range_set_len( r, lens[i]-removal );
                 if ( move_left > 0 )
-                    range_set_absolute( r, range_start(r)-move_left );
+                    range_set_absolute( r, start-move_left );
             }
-            i++;
+            res = range_array_add( kept, r );
         }
-        //range_array_print( f->ranges, i );
-        text = remove_text( removals, text, len );
-        range_array_dispose( removals, 1 );
-        range_array_sort( f->ranges );
-        // add root range
-        return formatter_add_root_range( f, *len );
+        if ( res )
+        {
+            for ( i=0;i<n;i++ )
+                if ( flags[i]&CULL_DROPPED )
+                    range_dispose( ranges[i] );
+            text = remove_text( cuts, n_cuts, text, len );
+            range_array_dispose( f->ranges, 0 );
+            f->ranges = kept;
+            kept = NULL;
+            range_array_sort( f->ranges );
+            // add root range
+            res = formatter_add_root_range( f, *len );
+        }
+    }
+    else
+        warning("formatter: failed to allocate cull\n");
+    if ( kept != NULL )
+        range_array_dispose( kept, 0 );
+    if ( cuts != NULL )
+        free( cuts );
+    if ( cut_lens != NULL )
+        free( cut_lens );
+    if ( rt != NULL )
+        range_table_dispose( rt );
+    return res;
+}
+/**
+ * Restrict the culled ranges to a window of the text. Only ranges that 
+ * intersect [from,to) are kept. They are clipped to the window and moved 
+ * so that the window starts at 0. Since clipping preserves containment 
+ * ancestry is the same as in the full document. Call this after 
+ * formatter_cull_ranges, which has already added the root range. Give 
+ * the full ranges back with formatter_restore_ranges when done.
+ * @param f the formatter in question
+ * @param from the first character offset of the window
+ * @param to the offset of the first character after the window
+ * @param full set to the full ranges the window replaced
+ * @return 1 if it worked, else 0
+ */
+int formatter_select_window( formatter *f, int from, int to, 
+    range_array **full )
+{
+    range_array *window = range_array_create();
+    if ( window != NULL )
+    {
+        int i,res = 1;
+        range *root;
+        // skip the old root at index 0
+        for ( i=1;i<range_array_size(f->ranges);i++ )
+        {
+            range *r = range_array_get( f->ranges, i );
+            if ( range_start(r) >= to )
+                break;
+            else if ( range_end(r) > from )
+            {
+                int start = MAX(range_start(r),from);
+                int end = MIN(range_end(r),to);
+                range *clip = range_copy( r );
+                if ( clip == NULL || !range_array_add(window,clip) )
+                {
+                    warning("formatter: failed to clip range %s\n",
+                        range_name(r));
+                    if ( clip != NULL )
+                        range_dispose( clip );
+                    res = 0;
+                    break;
+                }
+                range_set_absolute( clip, start-from );
+                range_set_len( clip, end-start );
+                // empty elements only print on their last fragment
+                if ( range_end(r) > to )
+                    range_set_rightmost( clip, 0 );
+            }
+        }
+        if ( res )
+        {
+            // clipped starts may have changed the order of equal starts
+            range_array_sort( window );
+            // the root goes first even if a clip spans the whole window
+            root = range_create( "root", NULL, 0, to-from );
+            if ( root == NULL || !range_array_insert(window,0,root) )
+            {
+                warning("formatter: failed to create window root\n");
+                if ( root != NULL )
+                    range_dispose( root );
+                res = 0;
+            }
+        }
+        if ( res )
+        {
+            *full = f->ranges;
+            f->ranges = window;
+        }
+        else
+            range_array_dispose( window, 1 );
+        return res;
     }
     else
         return 0;
 }
+/**
+ * Put back the full ranges after rendering a window
+ * @param f the formatter in question
+ * @param full the ranges formatter_select_window replaced
+ */
+void formatter_restore_ranges( formatter *f, range_array *full )
+{
+    range_array_dispose( f->ranges, 1 );
+    f->ranges = full;
+}
 /**
  * Remove all ranges and portions of other ranges that overlap with them
  * @param f the formatter
@@ -0,0 +1,600 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+#if FORMATTER_BENCH
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hashmap.h"
+#include "attribute.h"
+#include "annotation.h"
+#include "range.h"
+#include "range_array.h"
+#include "hashset.h"
+#include "css_sheet.h"
+#include "master.h"
+#include "stats.h"
+#include "error.h"
+#include "STIL/cJSON.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+/*
+ * Time the formatter on a synthetic document. The text, STIL markup
+ * and CSS are generated from a seed, so the same parameters always give
+ * the same input. Each phase of a format call is timed separately over
+ * a number of runs and the results are printed as JSON, which can be
+ * saved and passed back with -B to catch regressions.
+ */
+#define ERROR_PREFIX "<html><body><p>Error:"
+#define BENCH_CREATE 0
+#define BENCH_DISPOSE (STATS_NUM_PHASES+1)
+#define BENCH_TOTAL (STATS_NUM_PHASES+2)
+#define BENCH_NUM_PHASES (STATS_NUM_PHASES+3)
+/** phases shorter than this never count as regressions */
+#define NOISE_NS 20000
+/** bench phases: create, then the stats phases, then dispose */
+static const char *bench_names[BENCH_NUM_PHASES] = {"create","strip","css",
+    "markup","cull","matrix","build","print","dispose","total"};
+static const char *words[] = {"the","quick","brown","fox","jumps","over",
+    "lazy","dog","sea","moon","liberty","poetry","and","of","a",
+    "thereupon","notwithstanding","I"};
+#define NUM_WORDS (sizeof(words)/sizeof(char*))
+/** what to generate and how often to run it */
+static int doc_size = 100000;
+static int num_ranges = 2000;
+static int max_depth = 4;
+static double overlap = 0.1;
+static double removed = 0.0;
+static int num_props = 20;
+static unsigned seed = 1;
+static int iterations = 20;
+static char *write_dir = NULL;
+static char *baseline = NULL;
+static double tolerance = 10.0;
+/**
+ * Print a simple help message
+ */
+static void print_help()
+{
+    fprintf( stderr,
+        "usage: formatter-bench [-h] [-s size] [-r ranges] [-d depth] "
+            "[-o overlap] [-x removed] [-p props] [-S seed] [-n runs] "
+            "[-w dir] [-B baseline.json] [-T percent]\n"
+        "formatter-bench times the formatter on a generated document and "
+            "prints the\nresults as JSON.\n"
+        "Options are: \n"
+        "-h print this help message\n"
+        "-s the size of the text in bytes (default 100000)\n"
+        "-r the number of ranges (default 2000)\n"
+        "-d the deepest nesting of ranges (default 4)\n"
+        "-o the fraction of ranges that overlap their parent (default 0.1)\n"
+        "-x the fraction of ranges that are removed notes (default 0)\n"
+        "-p the number of distinct properties and CSS rules (default 20)\n"
+        "-S the random seed (default 1)\n"
+        "-n the number of timed runs (default 20)\n"
+        "-w dir also save the input as dir/bench.txt, bench.json and "
+            "bench.css\n"
+        "-B file compare with saved results and fail if slower\n"
+        "-T the percentage slowdown allowed against -B (default 10)\n");
+}
+/**
+ * Check the commandline arguments
+ * @param argc number of commandline args+1
+ * @param argv array of arguments, first is program name
+ * @return 1 if they were OK, 0 otherwise
+ */
+static int check_args( int argc, char **argv )
+{
+    int i,sane = 1;
+    for ( i=1;i<argc&&sane;i++ )
+    {
+        if ( strlen(argv[i])==2 && argv[i][0]=='-' )
+        {
+            if ( argv[i][1] == 'h' || i == argc-1 )
+                sane = 0;
+            else
+            {
+                char *arg = argv[++i];
+                switch ( argv[i-1][1] )
+                {
+                    case 's':
+                        doc_size = atoi( arg );
+                        sane = doc_size > 0;
+                        break;
+                    case 'r':
+                        num_ranges = atoi( arg );
+                        sane = num_ranges > 0;
+                        break;
+                    case 'd':
+                        max_depth = atoi( arg );
+                        sane = max_depth > 0;
+                        break;
+                    case 'o':
+                        overlap = atof( arg );
+                        sane = overlap >= 0.0 && overlap <= 1.0;
+                        break;
+                    case 'x':
+                        removed = atof( arg );
+                        sane = removed >= 0.0 && removed <= 1.0;
+                        break;
+                    case 'p':
+                        num_props = atoi( arg );
+                        sane = num_props > 0;
+                        break;
+                    case 'S':
+                        seed = (unsigned)strtoul( arg, NULL, 10 );
+                        sane = seed != 0;
+                        break;
+                    case 'n':
+                        iterations = atoi( arg );
+                        sane = iterations > 0;
+                        break;
+                    case 'w':
+                        write_dir = arg;
+                        break;
+                    case 'B':
+                        baseline = arg;
+                        break;
+                    case 'T':
+                        tolerance = atof( arg );
+                        sane = tolerance >= 0.0;
+                        break;
+                    default:
+                        sane = 0;
+                        break;
+                }
+            }
+        }
+        else
+            sane = 0;
+    }
+    return sane;
+}
+/**
+ * Get the next pseudo-random number (xorshift)
+ * @param state the generator's state, never 0
+ * @return a number in 0..2^32-1
+ */
+static unsigned bench_rand( unsigned *state )
+{
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+/**
+ * Get a pseudo-random number below a limit
+ * @param state the generator's state
+ * @param n the limit
+ * @return a number in 0..n-1 or 0 if n is not positive
+ */
+static int rand_below( unsigned *state, int n )
+{
+    return (n<=0)?0:(int)(bench_rand(state)%(unsigned)n);
+}
+/**
+ * Get a pseudo-random fraction
+ * @param state the generator's state
+ * @return a number in [0,1)
+ */
+static double rand_unit( unsigned *state )
+{
+    return (bench_rand(state)>>8)/16777216.0;
+}
+/**
+ * Make the text: lines of words of varying length
+ * @param state the generator's state
+ * @return the NUL-terminated text, doc_size bytes long, or NULL
+ */
+static char *make_text( unsigned *state )
+{
+    char *text = malloc( doc_size+1 );
+    if ( text != NULL )
+    {
+        int pos = 0,count = 0;
+        while ( pos < doc_size )
+        {
+            const char *w = words[rand_below(state,NUM_WORDS)];
+            int wlen = strlen( w );
+            if ( pos+wlen+1 > doc_size )
+                wlen = doc_size-pos-1;
+            memcpy( text+pos, w, wlen );
+            pos += wlen;
+            if ( pos < doc_size )
+                text[pos++] = (++count%12==0)?'\n':' ';
+        }
+        text[doc_size] = 0;
+    }
+    else
+        warning("formatter-bench: failed to allocate text\n");
+    return text;
+}
+/**
+ * Make the STIL markup. Ranges start in order a random distance apart.
+ * Each one nests inside the innermost range still open or, with
+ * probability overlap, starts inside it but ends after it. Once
+ * max_depth ranges are open the innermost is forgotten, so new ranges
+ * go into its parent instead. Removed ranges are empty and carry their
+ * text as content, like the notes the stripper takes out of the text.
+ * @param state the generator's state
+ * @param mlen set to the length of the markup
+ * @return the NUL-terminated STIL or NULL
+ */
+static char *make_markup( unsigned *state, int *mlen )
+{
+    int size = num_ranges*128+64;
+    char *markup = malloc( size );
+    int *ends = calloc( max_depth, sizeof(int) );
+    if ( markup != NULL && ends != NULL )
+    {
+        int i,top = 0,pos = 0,prev = 0;
+        int avg = (doc_size/num_ranges>0)?doc_size/num_ranges:1;
+        int len = snprintf( markup, size,
+            "{\n \"style\": \"bench\",\n \"ranges\": [\n" );
+        for ( i=0;i<num_ranges;i++ )
+        {
+            int end;
+            pos += rand_below( state, 2*avg+1 );
+            if ( pos > doc_size-1 )
+                pos = doc_size-1;
+            while ( top > 0 && ends[top-1] <= pos )
+                top--;
+            if ( top == max_depth )
+                top--;
+            if ( top > 0 && rand_unit(state) < overlap )
+                end = ends[top-1]+1+rand_below(state,2*avg);
+            else if ( top > 0 )
+                end = pos+1+rand_below(state,ends[top-1]-pos);
+            else
+                end = pos+1+rand_below(state,2*avg*max_depth);
+            if ( end > doc_size )
+                end = doc_size;
+            if ( rand_unit(state) < removed )
+                len += snprintf( markup+len, size-len,
+                    "  {\"name\": \"p%d\", \"reloff\": %d, \"len\": 0, "
+                    "\"content\": \"a note\", \"removed\": true}%s\n",
+                    rand_below(state,num_props), pos-prev,
+                    (i<num_ranges-1)?",":"" );
+            else
+            {
+                ends[top++] = end;
+                len += snprintf( markup+len, size-len,
+                    "  {\"name\": \"p%d\", \"reloff\": %d, \"len\": %d}%s\n",
+                    rand_below(state,num_props), pos-prev, end-pos,
+                    (i<num_ranges-1)?",":"" );
+            }
+            prev = pos;
+        }
+        len += snprintf( markup+len, size-len, " ]\n}\n" );
+        *mlen = len;
+    }
+    else
+    {
+        warning("formatter-bench: failed to allocate markup\n");
+        if ( markup != NULL )
+            free( markup );
+        markup = NULL;
+    }
+    if ( ends != NULL )
+        free( ends );
+    return markup;
+}
+/**
+ * Make one CSS rule per property. Every fourth one is a paragraph, so
+ * some ranges will not nest in their parents and get dropped.
+ * @param clen set to the length of the CSS
+ * @return the NUL-terminated CSS or NULL
+ */
+static char *make_css( int *clen )
+{
+    int i,len = 0,size = num_props*64+1;
+    char *css = malloc( size );
+    if ( css != NULL )
+    {
+        css[0] = 0;
+        for ( i=0;i<num_props;i++ )
+        {
+            if ( i%4 == 0 )
+                len += snprintf( css+len, size-len,
+                    "p.p%d { margin-left: %dpx }\n", i, i );
+            else
+                len += snprintf( css+len, size-len,
+                    "span.p%d { font-style: italic }\n", i );
+        }
+        *clen = len;
+    }
+    else
+        warning("formatter-bench: failed to allocate css\n");
+    return css;
+}
+/**
+ * Save one generated input
+ * @param name the file name inside write_dir
+ * @param data the data to save
+ * @param len its length
+ * @return 1 if it was written, else 0
+ */
+static int save_input( const char *name, const char *data, int len )
+{
+    int res = 0;
+    char *path = malloc( strlen(write_dir)+strlen(name)+2 );
+    if ( path != NULL )
+    {
+        FILE *dst;
+        sprintf( path, "%s/%s", write_dir, name );
+        dst = fopen( path, "w" );
+        if ( dst != NULL )
+        {
+            res = fwrite( data, 1, len, dst ) == (size_t)len;
+            fclose( dst );
+        }
+        if ( !res )
+            warning("formatter-bench: failed to write %s\n",path);
+        free( path );
+    }
+    return res;
+}
+/**
+ * Format the document once
+ * @param text the original text, which is copied because culling
+ * changes it
+ * @param markup the STIL markup
+ * @param mlen its length
+ * @param css the CSS
+ * @param clen its length
+ * @param times set to the time of each bench phase
+ * @param b set to the stats of the call
+ * @return 1 if it worked, else 0
+ */
+static int bench_run( const char *text, const char *markup, int mlen,
+    const char *css, int clen, long long *times, stats_block *b )
+{
+    int i,res = 0;
+    char *copy = malloc( doc_size+1 );
+    if ( copy != NULL )
+    {
+        long long start;
+        master *hf;
+        memcpy( copy, text, doc_size+1 );
+        stats_begin();
+        start = stats_now();
+        hf = master_create( copy, doc_size );
+        times[BENCH_CREATE] = stats_now()-start;
+        if ( hf != NULL )
+        {
+            if ( master_load_markup(hf,markup,mlen,"STIL")
+                && master_load_css(hf,css,clen) )
+            {
+                char *html = master_convert( hf );
+                res = html != NULL && strncmp(html,ERROR_PREFIX,
+                    strlen(ERROR_PREFIX))!=0;
+            }
+            start = stats_now();
+            master_dispose( hf );
+            times[BENCH_DISPOSE] = stats_now()-start;
+        }
+        stats_end();
+        stats_last( b );
+        times[BENCH_TOTAL] = times[BENCH_CREATE]+times[BENCH_DISPOSE];
+        for ( i=0;i<STATS_NUM_PHASES;i++ )
+        {
+            times[i+1] = b->ns[i];
+            times[BENCH_TOTAL] += b->ns[i];
+        }
+        free( copy );
+    }
+    return res;
+}
+/**
+ * Compare two times for qsort
+ */
+static int compare_times( const void *a, const void *b )
+{
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x<y)?-1:(x>y)?1:0;
+}
+/**
+ * Compare one measurement with the baseline
+ * @param name its name
+ * @param base the baseline value
+ * @param value the new value
+ * @param floor differences smaller than this are noise
+ * @return 1 if it is a regression, else 0
+ */
+static int regressed( const char *name, double base, double value,
+    double floor )
+{
+    if ( value > base*(1.0+tolerance/100.0) && value-base > floor )
+    {
+        fprintf( stderr, "formatter-bench: %s regressed: %.0f -> %.0f "
+            "(+%.1f%%)\n", name, base, value,
+            (base>0.0)?(value-base)*100.0/base:100.0 );
+        return 1;
+    }
+    return 0;
+}
+/**
+ * Read a number out of a parsed JSON object
+ * @param obj the object
+ * @param key the key of the number
+ * @return its value or -1 if it is missing
+ */
+static double json_number( cJSON *obj, const char *key )
+{
+    cJSON *item = (obj!=NULL)?cJSON_GetObjectItem(obj,key):NULL;
+    return (item!=NULL)?item->valuedouble:-1.0;
+}
+/**
+ * Check the results against the saved baseline
+ * @param medians the median time of each bench phase
+ * @param b the stats of the last run
+ * @return 1 if nothing regressed, else 0
+ */
+static int check_baseline( long long *medians, stats_block *b )
+{
+    int i,res = 0;
+    FILE *src = fopen( baseline, "r" );
+    if ( src != NULL )
+    {
+        char *data = NULL;
+        long len;
+        fseek( src, 0, SEEK_END );
+        len = ftell( src );
+        fseek( src, 0, SEEK_SET );
+        if ( len > 0 )
+            data = calloc( 1, len+1 );
+        if ( data != NULL && fread(data,1,len,src) == (size_t)len )
+        {
+            cJSON *root = cJSON_Parse( data );
+            if ( root != NULL )
+            {
+                cJSON *params = cJSON_GetObjectItem( root, "params" );
+                cJSON *phases = cJSON_GetObjectItem( root, "phases" );
+                int regressions = 0;
+                if ( json_number(params,"size") != doc_size
+                    || json_number(params,"ranges") != num_ranges
+                    || json_number(params,"seed") != seed )
+                    warning("formatter-bench: %s was made with other "
+                        "parameters\n",baseline);
+                for ( i=0;i<BENCH_NUM_PHASES;i++ )
+                {
+                    cJSON *phase = (phases!=NULL)
+                        ?cJSON_GetObjectItem(phases,bench_names[i]):NULL;
+                    double base = json_number( phase, "median_ns" );
+                    if ( base >= 0.0 )
+                        regressions += regressed( bench_names[i], base,
+                            (double)medians[i], NOISE_NS );
+                }
+                regressions += regressed( "peak_bytes",
+                    json_number(root,"peak_bytes"), (double)b->peak, 0.0 );
+                res = regressions == 0;
+                cJSON_Delete( root );
+            }
+            else
+                warning("formatter-bench: failed to parse %s\n",baseline);
+        }
+        else
+            warning("formatter-bench: failed to read %s\n",baseline);
+        if ( data != NULL )
+            free( data );
+        fclose( src );
+    }
+    else
+        warning("formatter-bench: failed to open %s\n",baseline);
+    return res;
+}
+/**
+ * Print the results as JSON
+ * @param mins the fastest time of each bench phase
+ * @param medians the median time of each bench phase
+ * @param b the stats of the last run
+ */
+static void print_results( long long *mins, long long *medians,
+    stats_block *b )
+{
+    int i;
+    long long alloc_bytes = 0,alloc_count = 0;
+    for ( i=0;i<=STATS_NUM_PHASES;i++ )
+    {
+        alloc_bytes += b->alloc_bytes[i];
+        alloc_count += b->alloc_count[i];
+    }
+    printf( "{\n \"params\": {\"size\": %d, \"ranges\": %d, \"depth\": %d, "
+        "\"overlap\": %g, \"removed\": %g, \"props\": %d, \"seed\": %u, "
+        "\"runs\": %d},\n \"phases\": {\n", doc_size, num_ranges,
+        max_depth, overlap, removed, num_props, seed, iterations );
+    for ( i=0;i<BENCH_NUM_PHASES;i++ )
+        printf( "  \"%s\": {\"min_ns\": %lld, \"median_ns\": %lld}%s\n",
+            bench_names[i], mins[i], medians[i],
+            (i<BENCH_NUM_PHASES-1)?",":"" );
+    printf( " },\n \"mb_per_s\": %.2f,\n \"alloc_bytes\": %lld,\n"
+        " \"alloc_count\": %lld,\n \"peak_bytes\": %lld,\n"
+        " \"nodes\": %lld,\n \"splits\": %lld,\n \"drops\": %lld,\n"
+        " \"output_bytes\": %lld\n}\n",
+        (medians[BENCH_TOTAL]>0)?doc_size*1000.0/medians[BENCH_TOTAL]:0.0,
+        alloc_bytes, alloc_count, b->peak, b->counts[STATS_NODES],
+        b->counts[STATS_SPLITS], b->counts[STATS_DROPS],
+        b->counts[STATS_OUTPUT_BYTES] );
+}
+/**
+ * Main entry point
+ */
+int main( int argc, char **argv )
+{
+    int res = 1;
+    unsigned state;
+    char *text,*markup,*css;
+    int mlen=0,clen=0;
+    long long *samples;
+    if ( !check_args(argc,argv) )
+    {
+        print_help();
+        return res;
+    }
+    state = seed;
+    text = make_text( &state );
+    markup = make_markup( &state, &mlen );
+    css = make_css( &clen );
+    samples = calloc( BENCH_NUM_PHASES*iterations, sizeof(long long) );
+    if ( text != NULL && markup != NULL && css != NULL && samples != NULL )
+    {
+        long long times[BENCH_NUM_PHASES];
+        stats_block b;
+        int i,j,ok = 1;
+        if ( write_dir != NULL )
+            ok = save_input( "bench.txt", text, doc_size )
+                && save_input( "bench.json", markup, mlen )
+                && save_input( "bench.css", css, clen );
+        // one run to warm the caches and the allocator
+        if ( ok )
+            ok = bench_run( text, markup, mlen, css, clen, times, &b );
+        for ( i=0;i<iterations&&ok;i++ )
+        {
+            ok = bench_run( text, markup, mlen, css, clen, times, &b );
+            for ( j=0;j<BENCH_NUM_PHASES;j++ )
+                samples[j*iterations+i] = times[j];
+        }
+        if ( ok )
+        {
+            long long mins[BENCH_NUM_PHASES],medians[BENCH_NUM_PHASES];
+            for ( j=0;j<BENCH_NUM_PHASES;j++ )
+            {
+                long long *s = samples+j*iterations;
+                qsort( s, iterations, sizeof(long long), compare_times );
+                mins[j] = s[0];
+                medians[j] = s[iterations/2];
+            }
+            print_results( mins, medians, &b );
+            res = (baseline==NULL||check_baseline(medians,&b))?0:1;
+        }
+        else
+            warning("formatter-bench: formatting failed\n");
+    }
+    if ( text != NULL )
+        free( text );
+    if ( markup != NULL )
+        free( markup );
+    if ( css != NULL )
+        free( css );
+    if ( samples != NULL )
+        free( samples );
+    return res;
+}
+#endif
@@ -21,6 +21,7 @@
 #include "hashmap.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
 #define INITIAL_BUCKETS 12
 #define MOD_ADLER 65521
@@ -21,6 +21,7 @@
 #include "hashset.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 #define MOD_ADLER 65521
 #define BLOCK_SIZE 24
 #define MAX_RATIO 1.2f
@@ -0,0 +1,217 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include "hashmap.h"
+#include "attribute.h"
+#include "annotation.h"
+#include "range.h"
+#include "range_array.h"
+#include "interval_tree.h"
+#include "error.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+/**
+ * An augmented interval tree laid out implicitly in an array. The 
+ * ranges are sorted on their start offsets and the root of any 
+ * subarray [lo,hi] is its middle element. Each node records the 
+ * greatest end offset in its subtree, so whole subtrees that finish 
+ * before a query can be skipped. Queries cost O(log n + k). The tree 
+ * does not own the ranges: it is only valid while they are.
+ */
+struct interval_tree_struct
+{
+    /** the ranges sorted on start */
+    range **ranges;
+    /** cached start offsets */
+    int *starts;
+    /** cached end offsets */
+    int *ends;
+    /** greatest end in the subtree rooted at each index */
+    int *max_ends;
+    int len;
+};
+/**
+ * Compare two ranges by start offset for sorting
+ * @param a pointer to the first range pointer
+ * @param b pointer to the second range pointer
+ * @return the difference of their starts
+ */
+static int interval_tree_cmp( const void *a, const void *b )
+{
+    range *r1 = *(range**)a;
+    range *r2 = *(range**)b;
+    int diff = range_start(r1)-range_start(r2);
+    return (diff!=0)?diff:range_end(r2)-range_end(r1);
+}
+/**
+ * Compute the maximum ends of a subtree
+ * @param t the tree in question
+ * @param lo the first index of the subtree
+ * @param hi the last index of the subtree
+ * @return the greatest end in the subtree or -1 if it is empty
+ */
+static int interval_tree_augment( interval_tree *t, int lo, int hi )
+{
+    if ( lo > hi )
+        return -1;
+    else
+    {
+        int mid = (lo+hi)/2;
+        int left = interval_tree_augment( t, lo, mid-1 );
+        int right = interval_tree_augment( t, mid+1, hi );
+        int max = t->ends[mid];
+        if ( left > max )
+            max = left;
+        if ( right > max )
+            max = right;
+        t->max_ends[mid] = max;
+        return max;
+    }
+}
+/**
+ * Create an interval tree
+ * @param ranges an array of ranges to index
+ * @param len the number of ranges
+ * @return an interval tree or NULL on failure
+ */
+interval_tree *interval_tree_create( range **ranges, int len )
+{
+    interval_tree *t = calloc( 1, sizeof(interval_tree) );
+    if ( t != NULL )
+    {
+        t->len = len;
+        if ( len > 0 )
+        {
+            int i;
+            t->ranges = malloc( len*sizeof(range*) );
+            t->starts = malloc( len*sizeof(int) );
+            t->ends = malloc( len*sizeof(int) );
+            t->max_ends = malloc( len*sizeof(int) );
+            if ( t->ranges==NULL||t->starts==NULL||t->ends==NULL
+                ||t->max_ends==NULL )
+            {
+                warning("interval_tree: failed to allocate %d nodes\n",len);
+                interval_tree_dispose( t );
+                return NULL;
+            }
+            for ( i=0;i<len;i++ )
+                t->ranges[i] = ranges[i];
+            qsort( t->ranges, len, sizeof(range*), interval_tree_cmp );
+            for ( i=0;i<len;i++ )
+            {
+                t->starts[i] = range_start( t->ranges[i] );
+                t->ends[i] = range_end( t->ranges[i] );
+            }
+            interval_tree_augment( t, 0, len-1 );
+        }
+    }
+    else
+        warning("interval_tree: failed to allocate tree\n");
+    return t;
+}
+/**
+ * Dispose of an interval tree but not the ranges it indexes
+ * @param t the tree to dispose
+ */
+void interval_tree_dispose( interval_tree *t )
+{
+    if ( t->ranges != NULL )
+        free( t->ranges );
+    if ( t->starts != NULL )
+        free( t->starts );
+    if ( t->ends != NULL )
+        free( t->ends );
+    if ( t->max_ends != NULL )
+        free( t->max_ends );
+    free( t );
+}
+/**
+ * Get the number of indexed ranges
+ * @param t the tree in question
+ * @return the number of ranges
+ */
+int interval_tree_size( interval_tree *t )
+{
+    return t->len;
+}
+/**
+ * Collect the ranges of a subtree intersecting [from,to)
+ * @param t the tree in question
+ * @param lo the first index of the subtree
+ * @param hi the last index of the subtree
+ * @param from the start of the query
+ * @param to the end of the query
+ * @param results add found ranges here in start order
+ * @return the number found or -1 on failure
+ */
+static int interval_tree_search( interval_tree *t, int lo, int hi, 
+    int from, int to, range_array *results )
+{
+    int found = 0;
+    while ( lo <= hi )
+    {
+        int res,mid = (lo+hi)/2;
+        // nothing in this subtree reaches the query
+        if ( t->max_ends[mid] <= from )
+            break;
+        res = interval_tree_search( t, lo, mid-1, from, to, results );
+        if ( res < 0 )
+            return -1;
+        found += res;
+        // everything from mid onwards starts after the query
+        if ( t->starts[mid] >= to )
+            break;
+        if ( t->ends[mid] > from )
+        {
+            if ( !range_array_add(results,t->ranges[mid]) )
+                return -1;
+            found++;
+        }
+        lo = mid+1;
+    }
+    return found;
+}
+/**
+ * Find all the ranges that intersect a span of text
+ * @param t the tree in question
+ * @param from the first offset of the span
+ * @param to the offset just past its end
+ * @param results an array to add the ranges to, in start order. Dispose 
+ * it without its contents.
+ * @return the number of ranges found or -1 on failure
+ */
+int interval_tree_query( interval_tree *t, int from, int to, 
+    range_array *results )
+{
+    if ( from >= to )
+        return 0;
+    else
+        return interval_tree_search( t, 0, t->len-1, from, to, results );
+}
+/**
+ * Find all the ranges that cover an offset
+ * @param t the tree in question
+ * @param offset the offset of the character
+ * @param results an array to add the ranges to, in start order
+ * @return the number of ranges found or -1 on failure
+ */
+int interval_tree_stab( interval_tree *t, int offset, range_array *results )
+{
+    return interval_tree_search( t, 0, t->len-1, offset, offset+1, results );
+}
@@ -1,12 +1,32 @@
 #ifdef JNI
 #include <jni.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include "calliope_AeseFormatter.h"
+#include "hashmap.h"
+#include "attribute.h"
+#include "annotation.h"
+#include "range.h"
+#include "range_array.h"
+#include "hashset.h"
+#include "css_sheet.h"
 #include "master.h"
+#include "pipeline.h"
+#include "stats.h"
 #include "memwatch.h"
-
+#include "stats_alloc.h"
+/**
+ * A range index kept alive between JNI calls. The master keeps a 
+ * pointer to the text, so we need our own copy.
+ */
+typedef struct
+{
+    master *hf;
+    char *text;
+} range_index;
 
 static int set_string_field( JNIEnv *env, jobject obj, 
     const char *field_name, char *value )
@@ -46,6 +66,107 @@ void jni_report( const char *fmt, ... )
     va_end( ap );
 }
 
+/**
+ * Create a master and load the markup and css into it
+ * @param env the JNI environment
+ * @param t_data the text bytes
+ * @param t_len their length
+ * @param markup an array of markup strings
+ * @param css an array of css strings
+ * @param formats the names of the markup formats, one per markup string
+ * @return a loaded master or NULL if it failed. Caller must dispose.
+ */
+static master *load_master( JNIEnv *env, jbyte *t_data, int t_len, 
+    jobjectArray markup, jobjectArray css, jobjectArray formats )
+{
+    int res=0;
+    jsize i,len,flen;
+    master *hf = master_create( (char*)t_data, t_len );
+    if ( hf != NULL )
+    {
+        len = (*env)->GetArrayLength(env, markup);
+        flen = (*env)->GetArrayLength(env, formats);
+        if ( flen < len )
+            len = flen;
+        if ( len > 0 )
+        {
+            // fetch every layer first so they can all be parsed at once
+            jstring *markup_strs = calloc( len, sizeof(jstring) );
+            jstring *format_strs = calloc( len, sizeof(jstring) );
+            const char **markup_data = calloc( len, sizeof(char*) );
+            const char **format_data = calloc( len, sizeof(char*) );
+            int *mlens = calloc( len, sizeof(int) );
+            if ( markup_strs != NULL && format_strs != NULL 
+                && markup_data != NULL && format_data != NULL 
+                && mlens != NULL )
+            {
+                res = 1;
+                for ( i=0;i<len&&res;i++ )
+                {
+                    markup_strs[i] = (jstring)(*env)->GetObjectArrayElement(
+                        env, markup, i );
+                    format_strs[i] = (jstring)(*env)->GetObjectArrayElement(
+                        env, formats, i );
+                    markup_data[i] = (*env)->GetStringUTFChars(env, 
+                        markup_strs[i], NULL);
+                    format_data[i] = (*env)->GetStringUTFChars(env, 
+                        format_strs[i], NULL);
+                    res = markup_data[i] != NULL && format_data[i] != NULL;
+                    if ( res )
+                        mlens[i] = (int)strlen(markup_data[i]);
+                }
+                if ( res )
+                    res = master_load_layers( hf, markup_data, mlens, 
+                        format_data, len );
+                for ( i=0;i<len;i++ )
+                {
+                    if ( markup_data[i] != NULL )
+                        (*env)->ReleaseStringUTFChars( env, markup_strs[i], 
+                            markup_data[i] );
+                    if ( format_data[i] != NULL )
+                        (*env)->ReleaseStringUTFChars( env, format_strs[i], 
+                            format_data[i] );
+                }
+            }
+            if ( markup_strs != NULL )
+                free( markup_strs );
+            if ( format_strs != NULL )
+                free( format_strs );
+            if ( markup_data != NULL )
+                free( markup_data );
+            if ( format_data != NULL )
+                free( format_data );
+            if ( mlens != NULL )
+                free( mlens );
+        }
+        if ( res )
+        {
+            len = (*env)->GetArrayLength(env, css);
+            for ( i=0;i<len;i++ )
+            {
+                jboolean isCssCopy;
+                jstring css_str = (jstring)(*env)->GetObjectArrayElement(
+                    env, css, i);
+                const char *css_data = (*env)->GetStringUTFChars(env, css_str, 
+                    &isCssCopy);
+                if ( css_data != NULL )
+                {
+                    res = master_load_css( hf, css_data, (int)strlen(css_data) );
+                    if ( isCssCopy==JNI_TRUE )
+                        (*env)->ReleaseStringUTFChars( env, css_str, css_data );
+                    if ( !res )
+                        break;
+                }
+            }
+        }
+        if ( !res )
+        {
+            master_dispose( hf );
+            hf = NULL;
+        }
+    }
+    return hf;
+}
 /*
  * Class:     calliope_AeseFormatter
  * Method:    format
@@ -56,79 +177,252 @@ JNIEXPORT jint JNICALL Java_calliope_AeseFormatter_format
     jobjectArray css, jobjectArray formats, jobject jsonHtml)
 {
     int res=0;
-    jsize i,len,flen;
     char *html;
     jboolean isCopy=0;
     //jni_report("entered format\n");
+    stats_begin();
     jbyte *t_data = (*env)->GetByteArrayElements(env, text, &isCopy);
     int t_len = (*env)->GetArrayLength( env, text );
     if ( t_data != NULL && markup != NULL && css != NULL && formats != NULL )
     {
-        jboolean isMarkupCopy,isFormatCopy;
-        master *hf = master_create( (char*)t_data, t_len );
+        master *hf = load_master( env, t_data, t_len, markup, css, formats );
         if ( hf != NULL )
         {
-            len = (*env)->GetArrayLength(env, markup);
-            flen = (*env)->GetArrayLength(env, formats);
-            for ( i=0;i<len&&i<flen;i++ )
+            //jni_report( "about to call master_convert\n" );
+            html = master_convert( hf );
+            //jni_report( "finished calling master_convert\n" );
+            if ( html != NULL )
+                res = set_string_field( env, jsonHtml, "body", html );
+            master_dispose( hf );
+        }
+    }
+    if ( t_data != NULL )
+        (*env)->ReleaseByteArrayElements( env, text, t_data, JNI_ABORT );
+    stats_end();
+    return res;
+}
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    formatRange
+ * Signature: ([B[Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;IILcalliope/json/JSONResponse;)I
+ */
+JNIEXPORT jint JNICALL Java_calliope_AeseFormatter_formatRange
+  (JNIEnv *env, jobject obj, jbyteArray text, jobjectArray markup, 
+    jobjectArray css, jobjectArray formats, jint from, jint to, 
+    jobject jsonHtml)
+{
+    int res=0;
+    char *html;
+    jboolean isCopy=0;
+    stats_begin();
+    jbyte *t_data = (*env)->GetByteArrayElements(env, text, &isCopy);
+    int t_len = (*env)->GetArrayLength( env, text );
+    if ( t_data != NULL && markup != NULL && css != NULL && formats != NULL )
+    {
+        master *hf = load_master( env, t_data, t_len, markup, css, formats );
+        if ( hf != NULL )
+        {
+            html = master_convert_range( hf, (int)from, (int)to );
+            if ( html != NULL )
+                res = set_string_field( env, jsonHtml, "body", html );
+            master_dispose( hf );
+        }
+    }
+    if ( t_data != NULL )
+        (*env)->ReleaseByteArrayElements( env, text, t_data, JNI_ABORT );
+    stats_end();
+    return res;
+}
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    openIndex
+ * Signature: ([B[Ljava/lang/String;[Ljava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_calliope_AeseFormatter_openIndex
+  (JNIEnv *env, jobject obj, jbyteArray text, jobjectArray markup, 
+    jobjectArray formats)
+{
+    range_index *ri = NULL;
+    jboolean isCopy=0;
+    jbyte *t_data = (*env)->GetByteArrayElements(env, text, &isCopy);
+    int t_len = (*env)->GetArrayLength( env, text );
+    if ( t_data != NULL && markup != NULL && formats != NULL )
+    {
+        ri = calloc( 1, sizeof(range_index) );
+        if ( ri != NULL )
+        {
+            ri->text = malloc( t_len+1 );
+            if ( ri->text != NULL )
             {
-                res = 1;
-                jstring markup_str = (jstring)(*env)->GetObjectArrayElement(
-                    env, markup, i );
-                jstring format_str = (jstring)(*env)->GetObjectArrayElement(
-                    env, formats, i );
-                const char *markup_data = (*env)->GetStringUTFChars(env, 
-                    markup_str, &isMarkupCopy);
-                const char *format_data = (*env)->GetStringUTFChars(env, 
-                    format_str, &isFormatCopy);
-                if ( markup_data != NULL && format_data != NULL )
-                {
-                    res = master_load_markup( hf, markup_data, 
-                        (int)strlen(markup_data), format_data );
-                }    
-                if ( markup_data != NULL && isMarkupCopy==JNI_TRUE )
-                    (*env)->ReleaseStringUTFChars( env, markup_str, markup_data );
-                if ( format_data != NULL && isFormatCopy==JNI_TRUE )
-                    (*env)->ReleaseStringUTFChars( env, format_str, format_data );
-                if ( !res )
-                    break;
+                jobjectArray css = (*env)->NewObjectArray( env, 0, 
+                    (*env)->FindClass(env,"java/lang/String"), NULL );
+                memcpy( ri->text, t_data, t_len );
+                ri->text[t_len] = 0;
+                if ( css != NULL )
+                    ri->hf = load_master( env, (jbyte*)ri->text, t_len, 
+                        markup, css, formats );
             }
-            if ( res )
+            if ( ri->hf == NULL )
             {
-                len = (*env)->GetArrayLength(env, css);
-                for ( i=0;i<len;i++ )
+                if ( ri->text != NULL )
+                    free( ri->text );
+                free( ri );
+                ri = NULL;
+            }
+        }
+    }
+    if ( t_data != NULL )
+        (*env)->ReleaseByteArrayElements( env, text, t_data, JNI_ABORT );
+    return (jlong)(intptr_t)ri;
+}
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    queryRanges
+ * Signature: (JII)[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL Java_calliope_AeseFormatter_queryRanges
+  (JNIEnv *env, jobject obj, jlong handle, jint from, jint to)
+{
+    jobjectArray res = NULL;
+    range_index *ri = (range_index*)(intptr_t)handle;
+    range_array *found = range_array_create();
+    if ( ri != NULL && found != NULL )
+    {
+        int n = master_query_ranges( ri->hf, (int)from, (int)to, found );
+        if ( n >= 0 )
+        {
+            jclass cls = (*env)->FindClass( env, "java/lang/String" );
+            res = (*env)->NewObjectArray( env, n, cls, NULL );
+            if ( res != NULL )
+            {
+                int i;
+                char line[128];
+                for ( i=0;i<n;i++ )
                 {
-                    jboolean isCssCopy;
-                    jstring css_str = (jstring)(*env)->GetObjectArrayElement(
-                        env, css, i);
-                    const char *css_data = (*env)->GetStringUTFChars(env, css_str, 
-                        &isCssCopy);
-                    if ( css_data != NULL )
-                    {
-                        res = master_load_css( hf, css_data, (int)strlen(css_data) );
-                        if ( isCssCopy==JNI_TRUE )
-                            (*env)->ReleaseStringUTFChars( env, css_str, css_data );
-                        if ( !res )
-                            break;
-                    }
+                    range *r = range_array_get( found, i );
+                    jstring str;
+                    snprintf( line, 128, "%s\t%d\t%d", range_name(r), 
+                        range_start(r), range_len(r) );
+                    str = (*env)->NewStringUTF( env, line );
+                    if ( str == NULL )
+                        break;
+                    (*env)->SetObjectArrayElement( env, res, i, str );
+                    (*env)->DeleteLocalRef( env, str );
                 }
-                if ( res )
+            }
+        }
+    }
+    if ( found != NULL )
+        range_array_dispose( found, 0 );
+    return res;
+}
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    closeIndex
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_calliope_AeseFormatter_closeIndex
+  (JNIEnv *env, jobject obj, jlong handle)
+{
+    range_index *ri = (range_index*)(intptr_t)handle;
+    if ( ri != NULL )
+    {
+        master_dispose( ri->hf );
+        free( ri->text );
+        free( ri );
+    }
+}
+/*
+ * Class:     calliope_AeseFormatter
+ * Method:    formatXML
+ * Signature: (Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;[Ljava/lang/String;Lcalliope/json/JSONResponse;Lcalliope/json/JSONResponse;)I
+ */
+JNIEXPORT jint JNICALL Java_calliope_AeseFormatter_formatXML
+  (JNIEnv *env, jobject obj, jstring xml, jstring rules, jstring style, 
+    jstring language, jstring hexcepts, jobjectArray css, jobject jsonHtml, 
+    jobject jsonStil)
+{
+    int res = 0;
+    jboolean x_copied=JNI_FALSE,r_copied=JNI_FALSE,s_copied=JNI_FALSE;
+    jboolean l_copied=JNI_FALSE,h_copied=JNI_FALSE;
+    const char *x_str = (xml==NULL)?NULL
+        :(*env)->GetStringUTFChars(env, xml, &x_copied);
+    const char *r_str = (rules==NULL)?NULL
+        :(*env)->GetStringUTFChars(env, rules, &r_copied);
+    const char *s_str = (style==NULL)?"TEI"
+        :(*env)->GetStringUTFChars(env, style, &s_copied);
+    const char *l_str = (language==NULL)?NULL
+        :(*env)->GetStringUTFChars(env, language, &l_copied);
+    const char *h_str = (hexcepts==NULL)?NULL
+        :(*env)->GetStringUTFChars(env, hexcepts, &h_copied);
+    stats_begin();
+    if ( x_str != NULL && css != NULL )
+    {
+        long long start = stats_enter( STATS_STRIP );
+        pipeline *p = pipeline_create( x_str, (int)strlen(x_str), r_str, 
+            (r_str==NULL)?0:(int)strlen(r_str), s_str, l_str, h_str, 
+            jsonStil != NULL );
+        stats_time( STATS_STRIP, start );
+        if ( p != NULL )
+        {
+            jsize i,len = (*env)->GetArrayLength(env, css);
+            master *hf = pipeline_master( p );
+            res = 1;
+            for ( i=0;i<len&&res;i++ )
+            {
+                jboolean isCssCopy;
+                jstring css_str = (jstring)(*env)->GetObjectArrayElement(
+                    env, css, i);
+                const char *css_data = (*env)->GetStringUTFChars(env, 
+                    css_str, &isCssCopy);
+                if ( css_data != NULL )
                 {
-                    //jni_report( "about to call master_convert\n" );
-                    html = master_convert( hf );
-                    //jni_report( "finished calling master_convert\n" );
-                    if ( html != NULL )
-                        res = set_string_field( env, jsonHtml, "body", html );
+                    res = master_load_css( hf, css_data, (int)strlen(css_data) );
+                    if ( isCssCopy==JNI_TRUE )
+                        (*env)->ReleaseStringUTFChars( env, css_str, css_data );
                 }
             }
-            master_dispose( hf );
+            if ( res && jsonStil != NULL )
+            {
+                int slen;
+                char *stil = pipeline_stil( p, &slen );
+                res = stil != NULL 
+                    && set_string_field( env, jsonStil, "body", stil );
+            }
+            if ( res )
+            {
+                char *html = master_convert( hf );
+                res = html != NULL 
+                    && set_string_field( env, jsonHtml, "body", html );
+            }
+            pipeline_dispose( p );
         }
     }
-    if ( t_data != NULL )
-        (*env)->ReleaseByteArrayElements( env, text, t_data, JNI_ABORT );
-#ifdef DEBUG_MEMORY
-        memory_print();
-#endif
+    stats_end();
+    if ( x_str != NULL && x_copied==JNI_TRUE )
+        (*env)->ReleaseStringUTFChars( env, xml, x_str );
+    if ( r_str != NULL && r_copied==JNI_TRUE )
+        (*env)->ReleaseStringUTFChars( env, rules, r_str );
+    if ( style != NULL && s_copied==JNI_TRUE )
+        (*env)->ReleaseStringUTFChars( env, style, s_str );
+    if ( l_str != NULL && l_copied==JNI_TRUE )
+        (*env)->ReleaseStringUTFChars( env, language, l_str );
+    if ( h_str != NULL && h_copied==JNI_TRUE )
+        (*env)->ReleaseStringUTFChars( env, hexcepts, h_str );
     return res;
 }
+/*
+ * Get the phase timings and counters of the last format call on this 
+ * thread and the totals for the process, as JSON
+ * Class:     calliope_AeseFormatter
+ * Method:    getStats
+ * Signature: ()Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_calliope_AeseFormatter_getStats
+  (JNIEnv *env, jobject obj)
+{
+    char buf[2048];
+    stats_json( buf, 2048 );
+    return (*env)->NewStringUTF( env, buf );
+}
 #endif
@@ -32,6 +32,7 @@
 #include "css_rule.h"
 #include "hashset.h"
 #include "range_array.h"
+#include "css_sheet.h"
 #include "formatter.h"
 #include "css_parse.h"
 #include "file_list.h"
@@ -39,7 +40,11 @@
 #include "STIL/STIL.h"
 #include "error.h"
 #include "master.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "batch.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 #ifdef XML_LARGE_SIZE
 #if defined(XML_USE_MSC_EXTENSIONS) && _MSC_VER < 1400
 #define XML_FMT_INT_MOD "I64"
@@ -60,8 +65,26 @@
 static file_list *css_files;
 static file_list *markup_files;
 static file_list *text_file;
+/** XML source to strip and render directly */
+static file_list *xml_file;
+/** optional stripping recipe for the XML file */
+static file_list *recipe_file;
+/** if set save a STIL copy of the stripped markup here */
+static char stil_file_name[FILE_NAME_LEN];
 static char *format_name="STIL";
 static char html_file_name[FILE_NAME_LEN];
+/** the window to render or -1 for the whole text */
+static int window_from = -1;
+static int window_to = -1;
+/** the span to list ranges for or -1 to render HTML */
+static int query_from = -1;
+static int query_to = -1;
+/** print the timings and allocations to stderr when done */
+static int print_stats = 0;
+/** manifest of jobs to render in one run, or NULL */
+static char *batch_file = NULL;
+/** threads for a batch, or 0 for one per core */
+static int num_threads = 0;
 
 /** if doing help or version info don't process anything */
 static int doing_help = 0;
@@ -74,18 +97,29 @@ static int doing_help = 0;
 static void print_help()
 {
 	fprintf( stderr,
-		"usage: formatter [-h] [-v] [-l] [-w] [-f format] -c css-files "
-			"-m markup-files -t text-file [html-file]\n"
+		"usage: formatter [-h] [-v] [-l] [-S] [-w] [-f format] [-r from,to] "
+			"[-q from,to] -c css-files (-m markup-files -t text-file | "
+			"-x xml-file [-e recipe] [-s stil-file]) [html-file]\n"
+		"       formatter [-S] [-f format] [-j threads] -b manifest\n"
 		"formatter combines a plain text file, its stripped "
 			"markup file and a\nCSS file into HTML. "
 		"Options are: \n"
 		"-h print this help message\n"
 		"-v print the version information\n"
 		"-f the markup format\n"
+		"-r from,to only render the characters from..to (after removals)\n"
+		"-q from,to list the ranges intersecting from..to instead of HTML\n"
 		"-l list supported formats\n"
+		"-S print phase timings and allocations to stderr\n"
 		"-c colon-separated list of css files (required)\n"
 		"-m colon-separated list of markup file names (required)\n"
-		"-t file the name of the base text file (required)\n");
+		"-t file the name of the base text file (required)\n"
+		"-x file strip this XML file and render it, instead of -t and -m\n"
+		"-e file stripping recipe for the XML file\n"
+		"-s file save a STIL copy of the stripped markup here\n"
+		"-b file render every job in this manifest, one per line:\n"
+		"   text-file markup-files css-files html-file\n"
+		"-j the number of threads for -b (default: one per core)\n");
 }
 /**
  * Check the commandline arguments
@@ -99,7 +133,9 @@ static int check_args( int argc, char **argv )
 	markup_files = NULL;
     css_files = NULL;
     text_file = NULL;
-	if ( argc < 7 )
+    xml_file = NULL;
+    recipe_file = NULL;
+	if ( argc < 3 )
 		sane = 0;
 	else
 	{
@@ -125,6 +161,36 @@ static int check_args( int argc, char **argv )
 						else
 							sane = 0;
 						break;
+					case 'r':
+						if ( i < argc-1 && sscanf(argv[i+1],"%d,%d",
+							&window_from,&window_to)==2 
+							&& window_from >= 0 && window_to > window_from )
+							;
+						else
+							sane = 0;
+						break;
+					case 'q':
+						if ( i < argc-1 && sscanf(argv[i+1],"%d,%d",
+							&query_from,&query_to)==2 
+							&& query_from >= 0 && query_to > query_from )
+							;
+						else
+							sane = 0;
+						break;
+					case 'S':
+						print_stats = 1;
+						break;
+					case 'b':
+						if ( i < argc-1 )
+							batch_file = argv[i+1];
+						else
+							sane = 0;
+						break;
+					case 'j':
+						if ( i < argc-1 )
+							num_threads = atoi( argv[i+1] );
+						sane = num_threads > 0;
+						break;
 					case 'l':
 						printf("%s",master_list());
 						doing_help = 1;
@@ -147,15 +213,47 @@ static int check_args( int argc, char **argv )
 						else
 							sane = 0;
 						break;
+					case 'x':
+						if ( i < argc-1 )
+							xml_file = file_list_create( argv[i+1] );
+						else
+							sane = 0;
+						break;
+					case 'e':
+						if ( i < argc-1 )
+							recipe_file = file_list_create( argv[i+1] );
+						else
+							sane = 0;
+						break;
+					case 's':
+						if ( i < argc-1 )
+							strncpy( stil_file_name, argv[i+1], 
+								FILE_NAME_LEN-1 );
+						else
+							sane = 0;
+						break;
 				}
 			}
 			if ( !sane )
 				break;
 		}
-		if ( !doing_help )
+		if ( !doing_help && batch_file == NULL )
 		{
-			if ( text_file==NULL||markup_files==NULL||css_files==NULL)
+			if ( css_files==NULL || (xml_file==NULL
+				&& (text_file==NULL||markup_files==NULL)) )
 				sane = 0;
+			else if ( xml_file != NULL )
+			{
+                char *missing;
+				if ( !file_list_check(xml_file,&missing) )
+					warning("can't find XML file %s\n",missing );
+                if ( !file_list_contains(css_files,argv[argc-1])
+                    && !file_list_contains(xml_file,argv[argc-1]) )
+                    strncpy( html_file_name, argv[argc-1], FILE_NAME_LEN );
+                else
+                    strncpy( html_file_name, DEFAULT_HTML_FILE, 
+                        FILE_NAME_LEN );
+			}
 			else
 			{
                 char *missing;
@@ -182,73 +280,175 @@ static int check_args( int argc, char **argv )
  */
 static void usage()
 {
-	fprintf( stderr,"usage: formatter [-h] [-v] [-l] [-w] [-f format] -c css "
-		"-m markup -t text-file [html-file]\n"
+	fprintf( stderr,"usage: formatter [-h] [-v] [-l] [-S] [-w] [-f format] "
+		"[-r from,to] [-q from,to] -c css "
+		"(-m markup -t text-file | -x xml-file) [html-file]\n"
+		"       formatter [-S] [-f format] [-j threads] -b manifest\n"
 		"type: \"formatter -h\" for help\n");
 }
 /**
  * Main entry point
  */
-int main( int argc, char **argv )
+/**
+ * Load the css into a loaded master, then write out HTML or the ranges 
+ * the user asked about
+ * @param hf the master with text and markup loaded
+ * @return 1 if it worked, else 0
+ */
+static int write_output( master *hf )
 {
     FILE *output;
+    char *data;
+    int i,len,res = 1;
+    for ( i=0;i<file_list_size(css_files);i++ )
+    {
+        res = file_list_load(css_files,i,&data,&len);
+        if ( res )
+        {
+            res = master_load_css( hf, data, len );
+            free( data );
+            data = NULL;
+        }
+    }
+    output = fopen( html_file_name, "w" );
+    if ( output != NULL && query_from >= 0 )
+    {
+        range_array *found = range_array_create();
+        if ( found != NULL )
+        {
+            int n = master_query_ranges( hf, query_from, 
+                query_to, found );
+            for ( i=0;i<n;i++ )
+            {
+                range *r = range_array_get( found, i );
+                fprintf( output, "%s\t%d\t%d\n", 
+                    range_name(r), range_start(r), 
+                    range_len(r) );
+            }
+            range_array_dispose( found, 0 );
+        }
+        fclose( output );
+    }
+    else if ( output != NULL )
+    {
+        char *html = (window_from>=0)
+            ?master_convert_range(hf,window_from,window_to)
+            :master_convert( hf );
+        fwrite( html, 1, master_get_html_len(hf), output );
+        fclose( output );
+    }
+    return res;
+}
+/**
+ * Strip the XML file and render it without going through STIL
+ * @return 1 if it worked, else 0
+ */
+static int format_xml()
+{
+    int res = 0;
+    char *xml,*rules=NULL;
+    int xlen,rlen=0;
+    if ( file_list_load(xml_file,0,&xml,&xlen) )
+    {
+        if ( recipe_file == NULL 
+            || file_list_load(recipe_file,0,&rules,&rlen) )
+        {
+            long long start = stats_enter( STATS_STRIP );
+            pipeline *p = pipeline_create( xml, xlen, rules, rlen, "TEI", 
+                NULL, NULL, stil_file_name[0]!=0 );
+            stats_time( STATS_STRIP, start );
+            if ( p != NULL )
+            {
+                res = write_output( pipeline_master(p) );
+                if ( res && stil_file_name[0] != 0 )
+                {
+                    int slen;
+                    char *stil = pipeline_stil( p, &slen );
+                    FILE *sf = fopen( stil_file_name, "w" );
+                    if ( sf != NULL && stil != NULL )
+                        res = fwrite( stil, 1, slen, sf ) == slen;
+                    if ( sf != NULL )
+                        fclose( sf );
+                }
+                pipeline_dispose( p );
+            }
+            if ( rules != NULL )
+                free( rules );
+        }
+        free( xml );
+    }
+    return res;
+}
+/**
+ * Main entry point
+ */
+int main( int argc, char **argv )
+{
 	int res = 0;
+    stats_begin();
     if ( check_args(argc,argv) )
 	{
-		if ( !doing_help )
+		if ( !doing_help && batch_file != NULL )
+            res = batch_run( batch_file, format_name, num_threads );
+		else if ( !doing_help && xml_file != NULL )
+            res = format_xml();
+		else if ( !doing_help )
 		{
-            char *data,*text;
+            char *text;
             int i,len;
             if ( file_list_load(text_file,0,&text,&len) )
             {
                 master *hf = master_create( text, len );
-                for ( i=0;i<file_list_size(markup_files);i++ )
+                int n = file_list_size( markup_files );
+                char **layers = calloc( (n>0)?n:1, sizeof(char*) );
+                int *lens = calloc( (n>0)?n:1, sizeof(int) );
+                const char **fmts = calloc( (n>0)?n:1, sizeof(char*) );
+                res = n > 0 && layers != NULL && lens != NULL 
+                    && fmts != NULL;
+                for ( i=0;i<n&&res;i++ )
                 {
-                    res = file_list_load(markup_files,i,&data,&len);
-                    if ( res )
-                    {
-                        res = master_load_markup( hf, data, len, format_name );
-                        free( data );
-                        data = NULL;
-                    }
+                    res = file_list_load(markup_files,i,&layers[i],&lens[i]);
+                    fmts[i] = format_name;
                 }
                 if ( res )
-                {
-                    for ( i=0;i<file_list_size(css_files);i++ )
-                    {
-                        res = file_list_load(css_files,i,&data,&len);
-                        if ( res )
-                        {
-                            res = master_load_css( hf, data, len );
-                            free( data );
-                            data = NULL;
-                        }
-                    }
-                    output = fopen( html_file_name, "w" );
-                    if ( output != NULL )
-                    {
-                        char *html = master_convert( hf );
-                        fwrite( html, 1, master_get_html_len(hf), output );
-                        fclose( output );
-                    }
-                }
+                    res = master_load_layers( hf, (const char**)layers, 
+                        lens, fmts, n );
+                for ( i=0;layers!=NULL&&i<n;i++ )
+                    if ( layers[i] != NULL )
+                        free( layers[i] );
+                if ( layers != NULL )
+                    free( layers );
+                if ( lens != NULL )
+                    free( lens );
+                if ( fmts != NULL )
+                    free( (char**)fmts );
+                if ( res )
+                    res = write_output( hf );
                 master_dispose( hf );
                 free( text );
                 text = NULL;
             }
-            if ( css_files != NULL )
-                file_list_delete( css_files );
-            if ( markup_files != NULL )
-                file_list_delete( markup_files );
-            if ( text_file != NULL )
-                file_list_delete( text_file );
+        }
+        if ( css_files != NULL )
+            file_list_delete( css_files );
+        if ( markup_files != NULL )
+            file_list_delete( markup_files );
+        if ( text_file != NULL )
+            file_list_delete( text_file );
+        if ( xml_file != NULL )
+            file_list_delete( xml_file );
+        if ( recipe_file != NULL )
+            file_list_delete( recipe_file );
+        stats_end();
+        if ( print_stats )
+        {
+            char buf[2048];
+            stats_json( buf, 2048 );
+            fprintf( stderr, "%s\n", buf );
         }
 	}
 	else
 		usage();
-#ifdef DEBUG_MEMORY
-    memory_print();
-#endif
 	return res;
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,118 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "map_file.h"
+#include "error.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+/**
+ * The contents of a file, mapped rather than read where possible. The 
+ * mapping is private, so the data can be changed in place (e.g. by 
+ * culling) without touching the file, and it is always followed by a 
+ * NUL for parsers that need a C string. When the file fills its last 
+ * page exactly there is no room for the NUL, so it is read instead.
+ */
+struct map_file_struct
+{
+    char *data;
+    int len;
+    int mapped;
+};
+/**
+ * Map a file into memory
+ * @param path the path to the file
+ * @return the mapped file or NULL on failure
+ */
+map_file *map_file_open( const char *path )
+{
+    map_file *mf = calloc( 1, sizeof(map_file) );
+    if ( mf != NULL )
+    {
+        struct stat st;
+        int fd = open( path, O_RDONLY );
+        if ( fd == -1 || fstat(fd,&st) != 0 || st.st_size <= 0 )
+        {
+            warning("map_file: failed to open %s\n",path);
+            if ( fd != -1 )
+                close( fd );
+            free( mf );
+            return NULL;
+        }
+        mf->len = (int)st.st_size;
+        if ( mf->len % sysconf(_SC_PAGESIZE) != 0 )
+        {
+            mf->data = mmap( NULL, mf->len, PROT_READ|PROT_WRITE, 
+                MAP_PRIVATE, fd, 0 );
+            mf->mapped = mf->data != MAP_FAILED;
+        }
+        if ( !mf->mapped )
+        {
+            mf->data = malloc( mf->len+1 );
+            if ( mf->data == NULL 
+                || read(fd,mf->data,mf->len) != mf->len )
+            {
+                warning("map_file: failed to read %s\n",path);
+                if ( mf->data != NULL )
+                    free( mf->data );
+                free( mf );
+                mf = NULL;
+            }
+            else
+                mf->data[mf->len] = 0;
+        }
+        close( fd );
+    }
+    else
+        warning("map_file: failed to allocate file\n");
+    return mf;
+}
+/**
+ * Unmap a file. Its data is no longer valid.
+ * @param mf the file to close
+ */
+void map_file_close( map_file *mf )
+{
+    if ( mf->mapped )
+        munmap( mf->data, mf->len );
+    else
+        free( mf->data );
+    free( mf );
+}
+/**
+ * Get the contents of a file
+ * @param mf the mapped file
+ * @return its data, followed by a NUL
+ */
+char *map_file_data( map_file *mf )
+{
+    return mf->data;
+}
+/**
+ * Get the length of a file
+ * @param mf the mapped file
+ * @return its length in bytes, not counting the NUL
+ */
+int map_file_len( map_file *mf )
+{
+    return mf->len;
+}
@@ -8,16 +8,24 @@
 #include "range.h"
 #include "range_array.h"
 #include "hashset.h"
+#include "css_sheet.h"
 #include "formatter.h"
+#include "interval_tree.h"
 #include "master.h"
 #include "AESE/AESE.h"
 #include "STIL/STIL.h"
+#include "STIL/BSTIL.h"
 #include "error.h"
+#include "stats.h"
+#include "probes.h"
 
 #include "memwatch.h"
-static format formats[]={{"AESE",load_aese_markup},{"STIL",load_stil_markup}};
+#include "stats_alloc.h"
+static format formats[]={{"AESE",load_aese_markup},{"STIL",load_stil_markup},
+    {"BSTIL",load_bstil_markup}};
 static int num_formats = sizeof(formats)/sizeof(format);
-static char error_string[128] = "";
+/** error pages, one per thread so masters can render concurrently */
+static __thread char error_string[128] = "";
 struct master_struct
 {
     char *text;
@@ -27,6 +35,12 @@ struct master_struct
     int has_markup;
     int has_text;
     int selected_format;
+    /** set once removed ranges have been culled from text and markup */
+    int culled;
+    /** set when ranges were added singly and need sorting */
+    int unsorted;
+    /** index over the culled ranges, built on first query */
+    interval_tree *index;
     formatter *f;
 };
 /**
@@ -64,6 +78,8 @@ master *master_create( char *text, int len )
  */
 void master_dispose( master *hf )
 {
+    if ( hf->index != NULL )
+        interval_tree_dispose( hf->index );
     if ( hf->f != NULL )
         formatter_dispose( hf->f );
     free( hf );
@@ -95,15 +111,115 @@ int master_load_markup( master *hf, const char *markup, int mlen,
     const char *fmt )
 {
     int res = 0;
+    long long start;
+    if ( hf->culled )
+    {
+        warning("master: markup loaded after the text was culled\n");
+        return 0;
+    }
+    start = stats_enter( STATS_MARKUP );
     //fprintf(stderr,"mlen=%d markup=%s\n",mlen,markup);
     hf->selected_format = master_lookup_format( fmt );
     if ( hf->selected_format >= 0 )
     {
+        int before = range_array_size( formatter_get_ranges(hf->f) );
         res = formatter_load_markup( hf->f, 
             formats[hf->selected_format].lm, markup, mlen );
+        stats_count( STATS_RANGES, 
+            range_array_size(formatter_get_ranges(hf->f))-before );
         if ( res && !hf->has_markup )
             hf->has_markup = 1;
     }
+    stats_time( STATS_MARKUP, start );
+    return res;
+}
+/**
+ * Load several markup files for the same text at once, in parallel
+ * @param hf the master in question
+ * @param markup the markup strings
+ * @param mlens their lengths
+ * @param fmts the format of each
+ * @param n the number of markup strings
+ * return 1 if they all loaded, else 0
+ */
+int master_load_layers( master *hf, const char **markup, int *mlens, 
+    const char **fmts, int n )
+{
+    int i,res = 0;
+    load_markup_func *mfuncs;
+    if ( hf->culled )
+    {
+        warning("master: markup loaded after the text was culled\n");
+        return 0;
+    }
+    mfuncs = calloc( (n>0)?n:1, sizeof(load_markup_func) );
+    if ( mfuncs != NULL && hf->f != NULL )
+    {
+        long long start = stats_enter( STATS_MARKUP );
+        int before = range_array_size( formatter_get_ranges(hf->f) );
+        for ( i=0;i<n;i++ )
+        {
+            hf->selected_format = master_lookup_format( fmts[i] );
+            mfuncs[i] = formats[hf->selected_format].lm;
+        }
+        if ( hf->unsorted )
+        {
+            formatter_sort_ranges( hf->f );
+            hf->unsorted = 0;
+        }
+        res = formatter_load_layers( hf->f, mfuncs, markup, mlens, n );
+        stats_count( STATS_RANGES, 
+            range_array_size(formatter_get_ranges(hf->f))-before );
+        if ( res && n > 0 )
+            hf->has_markup = 1;
+        stats_time( STATS_MARKUP, start );
+    }
+    if ( mfuncs != NULL )
+        free( mfuncs );
+    return res;
+}
+/**
+ * Add one range directly, e.g. as it is closed by the stripper, instead 
+ * of loading it from a markup file
+ * @param hf the master in question
+ * @param name the name of the range
+ * @param atts NULL-terminated attribute name/value pairs, or NULL
+ * @param removed 1 if its text is to be removed
+ * @param start its absolute offset in the text
+ * @param len its length
+ * @return 1 if successful, else 0
+ */
+int master_add_range( master *hf, const char *name, char **atts, 
+    int removed, int start, int len )
+{
+    int res = 0;
+    range *r;
+    if ( hf->culled )
+    {
+        warning("master: range added after the text was culled\n");
+        return 0;
+    }
+    r = (hf->f==NULL)?NULL:range_create( (char*)name, NULL, start, len );
+    if ( r != NULL )
+    {
+        int i;
+        range_set_removed( r, removed );
+        for ( i=0;atts!=NULL&&atts[i]!=NULL;i+=2 )
+        {
+            annotation *a = annotation_create_simple( atts[i], atts[i+1] );
+            if ( a != NULL )
+                range_add_annotation( r, a );
+        }
+        res = formatter_add_range( hf->f, r );
+        if ( res )
+        {
+            stats_count( STATS_RANGES, 1 );
+            hf->has_markup = 1;
+            hf->unsorted = 1;
+        }
+        else
+            range_dispose( r );
+    }
     return res;
 }
 /**
@@ -115,24 +231,83 @@ int master_load_markup( master *hf, const char *markup, int mlen,
  */
 int master_load_css( master *hf, const char *css, int len )
 {
+    long long start = stats_enter( STATS_CSS );
     int res = formatter_css_parse( hf->f, css, len );
+    stats_time( STATS_CSS, start );
     if ( res && !hf->has_css )
         hf->has_css = 1;
     return res;
 }
 /**
- * Convert the specified text to HTML
+ * Use css that was parsed once for many texts, instead of loading it
  * @param hf the master in question
+ * @param cs the parsed css, which must outlive the master
+ */
+void master_use_css( master *hf, css_sheet *cs )
+{
+    formatter_use_css( hf->f, cs );
+    hf->has_css = 1;
+}
+/**
+ * Remove deleted text and the ranges that cover it, but only once
+ * @param hf the master in question
+ * @return 1 if it worked or was already done, else 0
+ */
+static int master_cull( master *hf )
+{
+    if ( hf->unsorted )
+    {
+        formatter_sort_ranges( hf->f );
+        hf->unsorted = 0;
+    }
+    if ( !hf->culled )
+    {
+        long long start = stats_enter( STATS_CULL );
+        hf->culled = formatter_cull_ranges( hf->f, hf->text, &hf->tlen );
+        stats_time( STATS_CULL, start );
+    }
+    return hf->culled;
+}
+/**
+ * Convert the text or a window of it to HTML
+ * @param hf the master in question
+ * @param from the start of the window in the culled text
+ * @param to the end of the window or -1 for the whole text
  * @return a HTML string
  */
-char *master_convert( master *hf )
+static char *master_render( master *hf, int from, int to )
 {
     char *str = NULL;
     if ( hf->has_text && hf->has_css && hf->has_markup )
     {
-        if ( formatter_cull_ranges(hf->f,hf->text,&hf->tlen) )
+        if ( master_cull(hf) )
         {
-            int res = formatter_make_html( hf->f, hf->text, hf->tlen );
+            int res;
+            if ( to < 0 || to > hf->tlen )
+                to = hf->tlen;
+            if ( from < 0 )
+                from = 0;
+            if ( from >= to )
+            {
+                snprintf( error_string, 128, "<html><body><p>Error: "
+                    "empty window %d-%d</p></body></html>", from, to );
+                hf->html_len = strlen( error_string );
+                return error_string;
+            }
+            if ( from > 0 || to < hf->tlen )
+            {
+                // the window stands in for the ranges while rendering
+                range_array *full;
+                res = formatter_select_window( hf->f, from, to, &full );
+                if ( res )
+                {
+                    res = formatter_make_html( hf->f, hf->text+from, 
+                        to-from );
+                    formatter_restore_ranges( hf->f, full );
+                }
+            }
+            else
+                res = formatter_make_html( hf->f, hf->text, hf->tlen );
             if ( res )
                 str = formatter_get_html( hf->f, &hf->html_len );
             else
@@ -165,6 +340,85 @@ char *master_convert( master *hf )
     }
     return str;
 }
+/**
+ * Convert the specified text to HTML
+ * @param hf the master in question
+ * @return a HTML string, which belongs to the master until it renders 
+ * again or is disposed
+ */
+char *master_convert( master *hf )
+{
+    PROBE1( convert__entry, hf->tlen );
+    char *html = master_render( hf, 0, -1 );
+    PROBE2( convert__return, hf->tlen, hf->html_len );
+    return html;
+}
+/**
+ * Convert only a window of the text to HTML. Ranges outside the window 
+ * are never turned into nodes, so the cost depends on the window size.
+ * @param hf the master in question
+ * @param from the first character offset of the window (after removals)
+ * @param to the offset just past the end of the window
+ * @return a HTML string, which belongs to the master until it renders 
+ * again or is disposed
+ */
+char *master_convert_range( master *hf, int from, int to )
+{
+    PROBE2( convert_range__entry, from, to );
+    char *html = master_render( hf, from, to );
+    PROBE3( convert_range__return, from, to, hf->html_len );
+    return html;
+}
+/**
+ * Build the range index if needed
+ * @param hf the master in question
+ * @return 1 if the index is ready, else 0
+ */
+static int master_build_index( master *hf )
+{
+    if ( hf->index == NULL && hf->has_text && hf->has_markup 
+        && master_cull(hf) )
+    {
+        range_array *ra = formatter_get_ranges( hf->f );
+        int n = range_array_size( ra );
+        // skip the root range added by culling
+        if ( n > 0 )
+            hf->index = interval_tree_create( range_array_ranges(ra)+1, n-1 );
+    }
+    return hf->index != NULL;
+}
+/**
+ * Find the ranges that intersect a span of the text without rendering. 
+ * Offsets are in the text after removed ranges have been culled. The 
+ * ranges are the same before and after a window render.
+ * @param hf the master in question
+ * @param from the first offset of the span
+ * @param to the offset just past its end
+ * @param results add the ranges found here in start order. They belong 
+ * to the master so dispose of results without its contents.
+ * @return the number of ranges found or -1 on error
+ */
+int master_query_ranges( master *hf, int from, int to, range_array *results )
+{
+    if ( master_build_index(hf) )
+        return interval_tree_query( hf->index, from, to, results );
+    else
+        return -1;
+}
+/**
+ * Find the ranges that cover a character offset without rendering
+ * @param hf the master in question
+ * @param offset the offset in the culled text
+ * @param results add the ranges found here in start order
+ * @return the number of ranges found or -1 on error
+ */
+int master_stab_ranges( master *hf, int offset, range_array *results )
+{
+    if ( master_build_index(hf) )
+        return interval_tree_stab( hf->index, offset, results );
+    else
+        return -1;
+}
 /**
  * Get the length of the just processed html
  * @param hf the master in question
@@ -25,10 +25,11 @@
 #include "range_array.h"
 #include "hashset.h"
 #include "matrix.h"
-#include "matrix_queue.h"
+#include "range_table.h"
 #include "HTML.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 
 /** Record which properties may nest inside which other properties */
 struct matrix_struct
@@ -216,21 +217,54 @@ int matrix_inside( matrix *m, char *name1, char *name2 )
         return m->cells[m->n_props*index1+index2];
 }
 /**
- * Initialise a matrix with a set of ranges that may be within one another
+ * Initialise a matrix with a set of ranges that may be within one another.
+ * Because the ranges are sorted on increasing start-offset and decreasing 
+ * length the only ranges a new range can be inside are those still open 
+ * when it starts, including any equal ones before it.
  * @param m the matrix in question
  * @param ranges the array of range object pointers
  */
 void matrix_init( matrix *m, range_array *ranges )
 {
-    int i;
-    int n_ranges = range_array_size( ranges );
-    matrix_queue *mq = matrix_queue_create();
-    for ( i=0;i<n_ranges;i++ )
+    range_table *rt = range_table_create( ranges, m->lookup );
+    int n = (rt==NULL)?0:range_table_size( rt );
+    int *open = calloc( (n>0)?n:1, sizeof(int) );
+    if ( rt != NULL && open != NULL )
     {
-        if ( !matrix_queue_add(mq,m,range_array_get(ranges,i)) )
-            break;
+        int i,j,n_open = 0;
+        int *starts = range_table_starts( rt );
+        int *lens = range_table_lens( rt );
+        int *names = range_table_names( rt );
+        for ( i=0;i<n;i++ )
+        {
+            int k = 0;
+            int end = starts[i]+lens[i];
+            for ( j=0;j<n_open;j++ )
+            {
+                int o = open[j];
+                // drop ranges that end before this one starts
+                if ( starts[o]+lens[o] > starts[i] )
+                {
+                    open[k++] = o;
+                    if ( starts[i] >= starts[o] && end <= starts[o]+lens[o] 
+                        && names[i] != -1 && names[o] != -1 )
+                    {
+                        m->cells[m->n_props*names[i]+names[o]]++;
+                        if ( starts[o] == starts[i] && lens[o] == lens[i] )
+                            m->cells[m->n_props*names[o]+names[i]]++;
+                    }
+                }
+            }
+            open[k++] = i;
+            n_open = k;
+        }
     }
-    matrix_queue_dispose( mq );
+    else
+        warning("matrix: failed to allocate open ranges\n");
+    if ( open != NULL )
+        free( open );
+    if ( rt != NULL )
+        range_table_dispose( rt );
     m->inited = 1;
 }
 /**
@@ -18,29 +18,332 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
 #include "hashmap.h"
 #include "attribute.h"
 #include "annotation.h"
 #include "range.h"
 #include "node.h"
 #include "error.h"
+#include "stats.h"
+#include "probes.h"
 #include "HTML.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
+/**
+ * The attributes of a node. When a node is split its fragments share 
+ * them rather than each cloning every attribute. Only the id differs 
+ * between fragments, since each gets a new suffix, so a fragment keeps 
+ * its own copy of that and uses it in place of the shared one.
+ */
+typedef struct
+{
+    /** the number of nodes holding the list, less one */
+    int shares;
+    attribute *list;
+    /** the first attribute in list named "id" or NULL */
+    attribute *id;
+} node_attrs;
+/**
+ * A node fits in one cache line, with the fields a tree walk reads at the 
+ * front. Its links are 32-bit indexes into the node's pool and its names 
+ * are interned there, so the front half holds no pointers and means the 
+ * same wherever the pool's vectors are copied to.
+ */
 struct node_struct
 {
-	char *name;
-    char *html_name;
 	int offset;
 	int len;
-    int empty;
-    int rightmost;
-    node *parent;
-	node *next;
-	node *children;
-    attribute *attrs;
+    /** interned name and html name ids (html name NODE_NO_NAME if NULL) */
+    unsigned short name;
+    unsigned short html_name;
+    unsigned char empty;
+    unsigned char rightmost;
+    /** log2 of the size of the pool's vectors */
+    unsigned char shift;
+    /** indexes of the parent, next sibling and first child, or NODE_NONE */
+    uint32_t parent;
+	uint32_t next;
+	uint32_t children;
+    /** this node's own index */
+    uint32_t self;
+    /** the next sibling as a pointer, for the sibling walks */
+    node *sibling;
+    /** attributes, shared with the other fragments of a split node */
+    node_attrs *attrs;
+    /** this fragment's own id attribute, in place of the shared one */
+    attribute *id;
+    node_pool *pool;
+};
+/**
+ * Storage for all the nodes of one tree, as vectors of the same power of 
+ * two size, so that an index is a vector number and a slot in it. The 
+ * vector size is chosen from the number of ranges, so that usually the 
+ * whole tree lies in the first vector in document order. Nodes made by 
+ * splitting once it is full go in further vectors. Vectors never move 
+ * once allocated, so node pointers stay valid as the pool grows.
+ */
+struct node_pool_struct
+{
+    /** the vectors, each aligned to a cache line */
+    node **vectors;
+    /** the memory each vector was allocated in */
+    void **mem;
+    int n_vectors;
+    int vectors_size;
+    /** log2 of the number of nodes in each vector */
+    int shift;
+    /** the number of nodes in each vector, less one */
+    uint32_t mask;
+    /** the number of indexes handed out, including NODE_NONE */
+    uint32_t used;
+    /** disposed nodes, linked through next */
+    uint32_t free;
+    /** interned names, indexed by id */
+    char **names;
+    int n_names;
+    int names_size;
+    /** name to id+1 */
+    hashmap *ids;
 };
+#define NODE_ALIGN 64
+#define NODE_MIN_SHIFT 8
+#define NODE_MAX_SHIFT 16
+/** index 0 is never handed out and stands for no node */
+#define NODE_NONE 0
+#define NODE_NO_NAME USHRT_MAX
+#define NAME_BLOCK 32
+/**
+ * Get the node at an index
+ * @param p the pool the index belongs to
+ * @param i the index of the node or NODE_NONE
+ * @return the node or NULL
+ */
+static node *node_at( node_pool *p, uint32_t i )
+{
+    return (i==NODE_NONE)?NULL:&p->vectors[i>>p->shift][i&p->mask];
+}
+/**
+ * Follow a link from one node to another. A tree walk mostly stays in one 
+ * vector, so the link is first tried as a distance from the node itself, 
+ * which needs nothing outside its cache line.
+ * @param n the node the link belongs to
+ * @param i the linked index or NODE_NONE
+ * @return the linked node or NULL
+ */
+static node *node_link( node *n, uint32_t i )
+{
+    if ( i == NODE_NONE )
+        return NULL;
+    else if ( ((i^n->self)>>n->shift) == 0 )
+        return n+((int64_t)i-(int64_t)n->self);
+    else
+        return node_at( n->pool, i );
+}
+/**
+ * Set the next sibling of a node. The dom's sibling walks are a third 
+ * faster following a pointer than an index (formatter-bench -r 8000 
+ * -s 100000 -d 8 -o 0), so next is kept both ways. A copy of the pool's 
+ * vectors must set sibling again from next, as it must attrs, id and pool.
+ * @param n the node in question
+ * @param next its new next sibling or NULL
+ */
+static void node_set_next( node *n, node *next )
+{
+    n->next = (next==NULL)?NODE_NONE:next->self;
+    n->sibling = next;
+}
+/**
+ * Give up a node's hold on its attributes, freeing them if it was the last
+ * @param na the attributes
+ */
+static void node_release_attrs( node_attrs *na )
+{
+    if ( na->shares > 0 )
+        na->shares--;
+    else
+    {
+        if ( na->list != NULL )
+            attribute_dispose( na->list );
+        free( na );
+    }
+}
+/**
+ * Add a vector of nodes to the pool
+ * @param p the pool
+ * @return 1 if it worked else 0
+ */
+static int node_pool_grow( node_pool *p )
+{
+    size_t size = (size_t)1<<p->shift;
+    if ( (uint64_t)(p->n_vectors+1)<<p->shift > UINT32_MAX )
+        return 0;
+    if ( p->n_vectors == p->vectors_size )
+    {
+        int new_size = (p->vectors_size==0)?4:p->vectors_size*2;
+        node **vectors = realloc( p->vectors, new_size*sizeof(node*) );
+        void **mem;
+        if ( vectors == NULL )
+            return 0;
+        p->vectors = vectors;
+        mem = realloc( p->mem, new_size*sizeof(void*) );
+        if ( mem == NULL )
+            return 0;
+        p->mem = mem;
+        p->vectors_size = new_size;
+    }
+    p->mem[p->n_vectors] = malloc( size*sizeof(node)+NODE_ALIGN-1 );
+    if ( p->mem[p->n_vectors] == NULL )
+        return 0;
+    p->vectors[p->n_vectors] = (node*)(((uintptr_t)p->mem[p->n_vectors]
+        +NODE_ALIGN-1)&~(uintptr_t)(NODE_ALIGN-1));
+    p->n_vectors++;
+    return 1;
+}
+/**
+ * Create a pool to hold the nodes of a tree
+ * @param size_hint the number of nodes expected before splitting
+ * @return the pool or NULL
+ */
+node_pool *node_pool_create( int size_hint )
+{
+    node_pool *p = calloc( 1, sizeof(node_pool) );
+    if ( p != NULL )
+    {
+        // room for NODE_NONE and half as many again for splits
+        uint32_t wanted = (uint32_t)size_hint+size_hint/2+2;
+        p->shift = NODE_MIN_SHIFT;
+        while ( p->shift < NODE_MAX_SHIFT 
+            && ((uint32_t)1<<p->shift) < wanted )
+            p->shift++;
+        p->mask = ((uint32_t)1<<p->shift)-1;
+        p->used = NODE_NONE+1;
+        p->ids = hashmap_create();
+        p->names_size = NAME_BLOCK;
+        p->names = calloc( p->names_size, sizeof(char*) );
+        if ( p->ids == NULL || p->names == NULL || !node_pool_grow(p) )
+        {
+            node_pool_dispose( p );
+            p = NULL;
+        }
+    }
+    if ( p == NULL )
+        warning("node: failed to create pool\n");
+    return p;
+}
+/**
+ * Dispose of a pool and every node still in it
+ * @param p the pool to dispose
+ */
+void node_pool_dispose( node_pool *p )
+{
+    int i;
+    uint32_t j;
+    for ( j=NODE_NONE+1;j<p->used;j++ )
+    {
+        node *n = node_at( p, j );
+        if ( n->attrs != NULL )
+            node_release_attrs( n->attrs );
+        if ( n->id != NULL )
+            attribute_dispose( n->id );
+    }
+    for ( i=0;i<p->n_vectors;i++ )
+        free( p->mem[i] );
+    if ( p->vectors != NULL )
+        free( p->vectors );
+    if ( p->mem != NULL )
+        free( p->mem );
+    if ( p->names != NULL )
+    {
+        for ( i=0;i<p->n_names;i++ )
+            free( p->names[i] );
+        free( p->names );
+    }
+    if ( p->ids != NULL )
+        hashmap_dispose( p->ids );
+    free( p );
+}
+/**
+ * Get the id of a name, adding it to the pool if new
+ * @param p the pool
+ * @param name the name to intern
+ * @return its id or NODE_NO_NAME on failure
+ */
+static int node_pool_intern( node_pool *p, char *name )
+{
+    intptr_t id = (intptr_t)hashmap_get( p->ids, name );
+    if ( id == 0 )
+    {
+        if ( p->n_names == NODE_NO_NAME )
+            return NODE_NO_NAME;
+        if ( p->n_names == p->names_size )
+        {
+            int new_size = p->names_size+NAME_BLOCK;
+            char **names = realloc( p->names, new_size*sizeof(char*) );
+            if ( names == NULL )
+                return NODE_NO_NAME;
+            p->names = names;
+            p->names_size = new_size;
+        }
+        p->names[p->n_names] = strdup( name );
+        if ( p->names[p->n_names] == NULL )
+            return NODE_NO_NAME;
+        id = ++p->n_names;
+        if ( !hashmap_put(p->ids,name,(void*)id) )
+            return NODE_NO_NAME;
+    }
+    return (int)id-1;
+}
+/**
+ * Get a free node from the pool
+ * @param p the pool
+ * @return a zeroed node or NULL
+ */
+static node *node_pool_alloc( node_pool *p )
+{
+    node *n;
+    uint32_t i;
+    if ( p->free != NODE_NONE )
+    {
+        i = p->free;
+        p->free = node_at(p,i)->next;
+    }
+    else if ( p->used < (uint32_t)p->n_vectors<<p->shift 
+        || node_pool_grow(p) )
+        i = p->used++;
+    else
+        return NULL;
+    n = node_at( p, i );
+    memset( n, 0, sizeof(node) );
+    n->self = i;
+    n->shift = p->shift;
+    n->pool = p;
+    return n;
+}
+/**
+ * Copy an attribute exactly, without the new suffix a clone gets
+ * @param a the attribute
+ * @return the copy or NULL
+ */
+static attribute *node_copy_attribute( attribute *a )
+{
+    return attribute_create( attribute_get_name(a), attribute_prop_name(a), 
+        attribute_get_value(a) );
+}
+/**
+ * Get the attribute a node actually has in place of one in its list
+ * @param n the node in question
+ * @param a an attribute of its shared list
+ * @return a or the node's own id if a is the shared id
+ */
+static attribute *node_own_attribute( node *n, attribute *a )
+{
+    return (n->id != NULL && a == n->attrs->id)?n->id:a;
+}
 /**
  * Create a node instance
+ * @param p the pool to allocate it from
  * @param name the name of the node
  * @param name of html tag
  * @param offset the offset where the range of the node starts
@@ -49,17 +352,15 @@ struct node_struct
  * @param empty 1 if the html element is empty
  * @return the newly formed node
  */
-node *node_create( char *name, char *html_name, int offset, int len, 
-    int empty, int rightmost )
+node *node_create( node_pool *p, char *name, char *html_name, int offset, 
+    int len, int empty, int rightmost )
 {
-    node *n = calloc( 1, sizeof(node) );
+    node *n = node_pool_alloc( p );
 	if ( n != NULL )
     {
-        //unsigned long u = 0x10019ecf0;
-        //if ( (unsigned long) n == u )
-        //    printf("0x10019ecf0\n");
-        n->name = strdup( name );
-        n->html_name = (html_name==NULL)?NULL:strdup( html_name );
+        n->name = node_pool_intern( p, name );
+        n->html_name = (html_name==NULL)?NODE_NO_NAME
+            :node_pool_intern( p, html_name );
         n->offset = offset;
         n->len = len;
         n->empty = empty;
@@ -72,28 +373,37 @@ node *node_create( char *name, char *html_name, int offset, int len,
             node_dispose( n );
             n = NULL;
         }
+        else if ( n->name == NODE_NO_NAME 
+            || (html_name != NULL && n->html_name == NODE_NO_NAME) )
+        {
+            warning("node: failed to intern name\n");
+            node_dispose( n );
+            n = NULL;
+        }
+        else
+            stats_count( STATS_NODES, 1 );
     }
-	return n;
+    else
+        warning("node: failed to allocate node\n");
+    return n;
 }
 /**
- * Just dispose of the node itself
+ * Just dispose of the node itself, returning it to its pool
  * @param n the node in question
  */
 void node_dispose( node *n )
 {
-    if ( n->name != NULL )
-    {
-        free( n->name );
-        n->name = NULL;
-    }
-    if ( n->html_name != NULL )
-    {
-        free( n->html_name );
-        n->html_name = NULL;
-    }
+    node_pool *p = n->pool;
+    uint32_t i = n->self;
     if ( n->attrs != NULL )
-        attribute_dispose( n->attrs );
-    free( n );
+        node_release_attrs( n->attrs );
+    if ( n->id != NULL )
+        attribute_dispose( n->id );
+    memset( n, 0, sizeof(node) );
+    n->self = i;
+    n->pool = p;
+    n->next = p->free;
+    p->free = i;
 }
 /**
  * Is this node already placed in the tree?
@@ -103,7 +413,7 @@ void node_dispose( node *n )
  
 int node_has_parent( node *n )
 {
-    return n->parent != NULL;
+    return n->parent != NODE_NONE;
 }
 /**
  * Get the named attribute
@@ -113,11 +423,11 @@ int node_has_parent( node *n )
  */
 attribute *node_get_attribute( node *n, char *name )
 {
-    attribute *a = n->attrs;
+    attribute *a = (n->attrs==NULL)?NULL:n->attrs->list;
     while ( a != NULL )
     {
         if ( strcmp(attribute_get_name(a),name)==0 )
-            return a;
+            return node_own_attribute( n, a );
         else
             a = attribute_get_next( a );
     }
@@ -130,8 +440,11 @@ attribute *node_get_attribute( node *n, char *name )
  */
 node *node_first( node *n )
 {
-    if ( n->parent != NULL )
-        return n->parent->children;
+    if ( n->parent != NODE_NONE )
+    {
+        node *parent = node_link( n, n->parent );
+        return node_link( parent, parent->children );
+    }
     else
     {
         if ( strcmp(node_name(n),"root")!=0 )
@@ -146,12 +459,13 @@ node *node_first( node *n )
 void node_debug_check_siblings( node *first )
 {
     //printf("siblings: ");
-    while ( first->next != NULL )
+    node *next;
+    while ( (next=first->sibling) != NULL )
     {
-        if ( node_end(first)>node_offset(first->next) )
+        if ( node_end(first)>node_offset(next) )
             printf("node: siblings not sorted\n");
         //printf("%s %d:%d ",first->name,first->offset,node_end(first));
-        first = first->next;
+        first = next;
     }
     //printf("%s %d:%d ",first->name,first->offset,node_end(first));
     //printf("\n");
@@ -164,36 +478,37 @@ void node_debug_check_siblings( node *first )
 void node_add_sibling( node *n, node *r )
 {
     node *prev = NULL;
-    node *parent = n->parent;
+    node_pool *p = n->pool;
+    uint32_t parent = n->parent;
     node *orig = n = node_first( n );
     // find correct location
     while ( n != NULL && node_follows(n,r) )
     {
         prev = n;
-        n = n->next;
+        n = n->sibling;
     }
     // so r does not follow n or n is NULL
     if ( n == NULL )
     {
         // insert after prev
-        r->next = NULL;
-        prev->next = r;
+        node_set_next( r, NULL );
+        node_set_next( prev, r );
     }
     else // r precedes or overlaps n
     {
         if ( node_precedes(n,r) )
         {
             // insert r before n
-            r->next = n;
+            node_set_next( r, n );
             if ( prev == NULL )
-                parent->children = r;
+                node_at(p,parent)->children = r->self;
             if ( prev != NULL )
-                prev->next = r;
+                node_set_next( prev, r );
         }
         else // overlaps!!
             warning("node: sibling %s %d:%d overlaps %s %d:%d\n",
-                n->name,n->offset,node_end(n),
-                r->name,r->offset,node_end(r));
+                node_name(n),n->offset,node_end(n),
+                node_name(r),r->offset,node_end(r));
     }
     r->parent = parent;
     // debug check
@@ -207,13 +522,13 @@ void node_check( node *n )
 {
     int left = n->offset;
     int right = n->offset+n->len;
-    node *c = n->children;
+    node *c = node_link( n, n->children );
     if ( c != NULL )
     {
         if ( c->offset < left )
             warning("node: child precedes parent\n");
-        while ( c->next != NULL )
-            c = c->next;
+        while ( c->sibling != NULL )
+            c = c->sibling;
         if ( c->offset+c->len > right )
             warning("node: child extends beyond right of parent\n");
     }
@@ -225,11 +540,11 @@ void node_check( node *n )
  */
 void node_add_child( node *n, node *c )
 {
-    if ( n->children == NULL )
-		n->children = c;
+    if ( n->children == NODE_NONE )
+		n->children = c->self;
 	else
-		node_add_sibling( n->children, c );
-    c->parent = n;
+		node_add_sibling( node_link(n,n->children), c );
+    c->parent = n->self;
     //node_check( n );
 }
 /**
@@ -239,19 +554,20 @@ void node_add_child( node *n, node *c )
  */
 void node_detach_sibling( node *n, node *prev )
 {
-    node *next = n->next;
-    n->next = NULL;
+    node *next = n->sibling;
+    node *parent = node_link( n, n->parent );
+    node_set_next( n, NULL );
     if ( prev != NULL )
     {
-        if ( prev->next != n )
+        if ( prev->sibling != n )
             warning("node: invalid detachment!\n");
-        prev->next = next;
+        node_set_next( prev, next );
     }
     // check that if this is the first child of the parent 
-    // so that the children pointer gets updated
-    if ( n->parent != NULL && n->parent->children == n )
-        n->parent->children = next;
-    n->parent = NULL;
+    // so that the children link gets updated
+    if ( parent != NULL && parent->children == n->self )
+        parent->children = (next==NULL)?NODE_NONE:next->self;
+    n->parent = NODE_NONE;
     /*if ( prev != NULL && prev->parent != NULL )
         node_check(prev->parent);
     if ( next != NULL && next->parent != NULL )
@@ -271,12 +587,12 @@ node *node_align_sibling( node *n, node *r )
     while ( n != NULL && node_follows(n,r) )
     {
         prev = n;
-        n = n->next;
+        n = n->sibling;
     }
     // found nothing that overlaps with us
     if ( n == NULL )
     {
-        prev->next = r;
+        node_set_next( prev, r );
         r->parent = prev->parent;
         return NULL;
     }
@@ -299,7 +615,7 @@ node *node_align_sibling( node *n, node *r )
  */
 int node_has_children( node *n )
 {
-    return n->children != NULL;
+    return n->children != NODE_NONE;
 }
 /**
  * Get the first child of the node
@@ -308,7 +624,7 @@ int node_has_children( node *n )
  */
 node *node_first_child( node *n )
 {
-    return n->children;
+    return node_link( n, n->children );
 }
 /**
  * Get the offset of the node's range
@@ -344,29 +660,35 @@ int node_end( node *n )
  */
 void node_split( node *n, int pos )
 {
-    node *next = node_create( n->name, n->html_name, pos, node_end(n)-pos,
-        html_is_empty(n->html_name), n->rightmost );
-    attribute *attr = n->attrs;
-    while ( attr != NULL )
+    PROBE2( split__entry, n->offset, pos );
+    stats_count( STATS_SPLITS, 1 );
+    node *next = node_create( n->pool, node_name(n), node_html_name(n), pos, 
+        node_end(n)-pos, html_is_empty(node_html_name(n)), n->rightmost );
+    if ( n->attrs != NULL )
     {
-        attribute *clone = attribute_clone(attr);
-        if ( clone != NULL )
+        // share the attributes, but give each fragment its own id
+        next->attrs = n->attrs;
+        n->attrs->shares++;
+        if ( n->attrs->id != NULL )
         {
-            node_add_attribute( next, clone );
-            attr = attribute_get_next( attr );
+            if ( n->id == NULL )
+                n->id = node_copy_attribute( n->attrs->id );
+            // the clone suffixes the id of n and gives next the one after
+            if ( n->id != NULL )
+                next->id = attribute_clone( n->id );
+            if ( next->id == NULL )
+                fprintf(stderr,"node: failed to clone attribute\n");
         }
-        else
-            fprintf(stderr,"node: failed to clone attribute\n");
     }
     // insert next into the sibling list
     n->len = pos-n->offset;
-    next->next = n->next;
-    n->next = next;
+    node_set_next( next, n->sibling );
+    node_set_next( n, next );
     // we can't be rightmost any more
     n->rightmost = 0;
     next->parent = n->parent;
     // now go through the children of n moving them into next
-    node *c = n->children;
+    node *c = node_link( n, n->children );
     node *prev = NULL;
     while ( c != NULL )
     {
@@ -374,17 +696,17 @@ void node_split( node *n, int pos )
         {
             node *c2;
             node_split( c, node_end(n) );
-            c2 = c->next;
+            c2 = c->sibling;
             node_detach_sibling( c2, c );
             node_add_child( next, c2 );
             /*node_check(n);
             node_check(next);*/
             prev = c;
-            c = c->next;
+            c = c->sibling;
         }
         else if ( node_follows(n,c) )
         {
-            node *following = c->next;
+            node *following = c->sibling;
             node_detach_sibling( c, prev );
             node_add_child( next, c );
             c = following;
@@ -394,11 +716,12 @@ void node_split( node *n, int pos )
         else 
         {
             prev = c;
-            c = c->next;
+            c = c->sibling;
         }
     }
     /*node_check( n );
     node_check( next );*/
+    PROBE2( split__return, n->offset, pos );
 }
 /**
  * Get the parent of this node
@@ -407,7 +730,7 @@ void node_split( node *n, int pos )
  */
 node *node_parent( node *n )
 {
-    return n->parent;
+    return node_link( n, n->parent );
 }
 /**
  * Does this node have a next sibling?
@@ -416,7 +739,7 @@ node *node_parent( node *n )
  */
 int node_has_next_sibling( node *n )
 {
-    return n->next != NULL;
+    return n->sibling != NULL;
 }
 /**
  * Get the next sibling of n
@@ -425,7 +748,7 @@ int node_has_next_sibling( node *n )
  */
 node *node_next_sibling( node *n )
 {
-    return n->next;
+    return n->sibling;
 }
 /**
  * Because we don't keep pointers to preceding nodes we have to search for it
@@ -434,16 +757,16 @@ node *node_next_sibling( node *n )
  */
 node *node_prec_sibling( node *n )
 {
-    node *parent = n->parent;
+    node *parent = node_link( n, n->parent );
     if ( parent != NULL )
     {
-        node *c = parent->children;
+        node *c = node_link( parent, parent->children );
         while ( c != NULL )
         {
-            if ( c->next == n )
+            if ( c->sibling == n )
                 return c;
             else
-                c = c->next;
+                c = c->sibling;
         }
         return NULL;
     }
@@ -457,7 +780,7 @@ node *node_prec_sibling( node *n )
  */
 char *node_name( node *n )
 {
-    return n->name;
+    return n->pool->names[n->name];
 }
 /**
  * Get a node's html tag name
@@ -466,7 +789,7 @@ char *node_name( node *n )
  */
 char *node_html_name( node *n )
 {
-    return n->html_name;
+    return (n->html_name==NODE_NO_NAME)?NULL:n->pool->names[n->html_name];
 }
 /**
  * Does the new node precede the in-tree node?
@@ -522,12 +845,13 @@ range *node_to_range( node *n )
     range *r = range_create( node_name(n), node_html_name(n), node_offset(n), 
         node_len(n) ); 
     range_set_rightmost( r, n->rightmost );
-    attribute *attr = n->attrs;
+    attribute *attr = (n->attrs==NULL)?NULL:n->attrs->list;
     while ( attr != NULL )
     {
+        attribute *own = node_own_attribute( n, attr );
         annotation *a = annotation_create_simple( 
-            attribute_prop_name(attr),
-            attribute_get_value(attr) );
+            attribute_prop_name(own),
+            attribute_get_value(own) );
         if ( a != NULL )
             range_add_annotation( r, a );
         attr = attribute_get_next( attr );
@@ -541,10 +865,51 @@ range *node_to_range( node *n )
  */
 void node_add_attribute( node *n, attribute *a )
 {
-    if ( n->attrs == NULL )
-        n->attrs = a;
+    if ( n->attrs != NULL && n->attrs->shares > 0 )
+    {
+        // copy on write: the other fragments keep the old list
+        node_attrs *na = calloc( 1, sizeof(node_attrs) );
+        attribute *old = n->attrs->list;
+        while ( na != NULL && old != NULL )
+        {
+            attribute *copy = node_copy_attribute( old );
+            if ( copy == NULL )
+                break;
+            if ( na->list == NULL )
+                na->list = copy;
+            else
+                attribute_append( na->list, copy );
+            if ( old == n->attrs->id )
+                na->id = copy;
+            old = attribute_get_next( old );
+        }
+        if ( na == NULL || old != NULL )
+        {
+            fprintf(stderr,"node: failed to copy attributes\n");
+            if ( na != NULL )
+                node_release_attrs( na );
+            attribute_dispose( a );
+            return;
+        }
+        node_release_attrs( n->attrs );
+        n->attrs = na;
+    }
+    else if ( n->attrs == NULL )
+    {
+        n->attrs = calloc( 1, sizeof(node_attrs) );
+        if ( n->attrs == NULL )
+        {
+            fprintf(stderr,"node: failed to allocate attributes\n");
+            attribute_dispose( a );
+            return;
+        }
+    }
+    if ( n->attrs->list == NULL )
+        n->attrs->list = a;
     else
-        attribute_append( n->attrs, a );
+        attribute_append( n->attrs->list, a );
+    if ( n->attrs->id == NULL && strcmp(attribute_get_name(a),"id")==0 )
+        n->attrs->id = a;
 }
 /**
  * Get the attributes of a node for writing out
@@ -554,13 +919,14 @@ void node_add_attribute( node *n, attribute *a )
  */
 void node_get_attributes( node *n, char *atts, int limit )
 {
-    attribute *temp = n->attrs;
+    attribute *temp = (n->attrs==NULL)?NULL:n->attrs->list;
     int pos = 0;
     atts[0] = 0;
     while ( temp != NULL )
     {
-        char *name = attribute_get_name( temp );
-        char *value = attribute_get_value( temp );
+        attribute *own = node_own_attribute( n, temp );
+        char *name = attribute_get_name( own );
+        char *value = attribute_get_value( own );
         if ( strlen(name)+strlen(value)+6+pos < limit )
         {
             pos += snprintf( &atts[pos],limit-pos," %s=\"%s\"",name,value );
@@ -586,7 +952,7 @@ int node_empty( node *n )
  */
 int node_is_root( node *n )
 {
-    return n->parent == NULL;
+    return n->parent == NODE_NONE;
 }
 /**
  * Is this node rightmost?
@@ -0,0 +1,217 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+/**
+ * Run the stripper and feed its text and closed ranges directly into a 
+ * master, so a TEI file can be rendered without writing and reparsing 
+ * STIL. The stripper is a separate library with many symbols of the 
+ * same name as ours, so we can't link against it. Instead we open it 
+ * privately and look up its one entry point.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include "hashmap.h"
+#include "attribute.h"
+#include "annotation.h"
+#include "range.h"
+#include "range_array.h"
+#include "hashset.h"
+#include "css_sheet.h"
+#include "master.h"
+#include "range_sink.h"
+#include "pipeline.h"
+#include "error.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+#ifdef __APPLE__
+#define STRIPPER_LIB "libAeseStripper.dylib"
+#else
+#define STRIPPER_LIB "libAeseStripper.so"
+#endif
+#define STRIPPER_LIB_DIR "/usr/local/lib/"
+struct pipeline_struct
+{
+    master *hf;
+    /** our copy of the stripped text, which the master points to */
+    char *text;
+    int tlen;
+    /** optional STIL copy of the markup */
+    char *stil;
+    int stil_len;
+};
+/** the stripper's entry point, or NULL if it couldn't be found */
+static stripper_scan_func scan = NULL;
+/** makes the lookup happen once, whether or not it works */
+static pthread_once_t scan_once = PTHREAD_ONCE_INIT;
+/**
+ * Open the stripper library and look up its scan function
+ */
+static void pipeline_open_stripper()
+{
+    // keep the stripper's symbols from binding to ours
+#ifdef RTLD_DEEPBIND
+    int flags = RTLD_LAZY|RTLD_LOCAL|RTLD_DEEPBIND;
+#else
+    int flags = RTLD_LAZY|RTLD_LOCAL;
+#endif
+    void *handle = dlopen( STRIPPER_LIB, flags );
+    if ( handle == NULL )
+        handle = dlopen( STRIPPER_LIB_DIR STRIPPER_LIB, flags );
+    if ( handle != NULL )
+    {
+        // the handle is kept for the life of the process
+        scan = (stripper_scan_func)dlsym( handle, STRIPPER_SCAN_SYMBOL );
+        if ( scan == NULL )
+            warning("pipeline: %s\n", dlerror() );
+    }
+    else
+        warning("pipeline: %s\n", dlerror() );
+}
+/**
+ * Find the stripper's scan function. Only the first call looks for it, 
+ * so concurrent callers share the result and a missing library is only 
+ * reported once.
+ * @return the function or NULL if the library isn't installed
+ */
+static stripper_scan_func pipeline_lookup()
+{
+    pthread_once( &scan_once, pipeline_open_stripper );
+    return scan;
+}
+/**
+ * Receive the stripped text
+ * @param arg the pipeline
+ * @param text the text
+ * @param len its length
+ * @return 1 if it worked, else 0
+ */
+static int pipeline_text( void *arg, const char *text, int len )
+{
+    pipeline *p = arg;
+    if ( len > 0 )
+    {
+        p->text = malloc( len+1 );
+        if ( p->text != NULL )
+        {
+            memcpy( p->text, text, len );
+            p->text[len] = 0;
+            p->tlen = len;
+            p->hf = master_create( p->text, len );
+        }
+        else
+            warning("pipeline: failed to copy text\n");
+    }
+    else
+        warning("pipeline: stripped text was empty\n");
+    return p->hf != NULL;
+}
+/**
+ * Receive a closed range
+ * @param arg the pipeline
+ * @param name the range name
+ * @param atts its attributes
+ * @param removed 1 if its text is removed
+ * @param start its absolute offset
+ * @param len its length
+ * @return 1 if it worked, else 0
+ */
+static int pipeline_range( void *arg, const char *name, char **atts,
+    int removed, int start, int len )
+{
+    pipeline *p = arg;
+    return master_add_range( p->hf, name, atts, removed, start, len );
+}
+/**
+ * Strip an XML file into a master in one pass
+ * @param xml the XML source
+ * @param xlen its length
+ * @param rules the stripping recipe in XML or JSON or NULL
+ * @param rlen its length
+ * @param style the style name written into the STIL copy
+ * @param language the language code for hyphenation or NULL
+ * @param hh_excepts space-delimited hard-hyphen exceptions or NULL
+ * @param want_stil if 1 also keep a STIL copy of the markup
+ * @return a pipeline with a loaded master or NULL
+ */
+pipeline *pipeline_create( const char *xml, int xlen, const char *rules, 
+    int rlen, const char *style, const char *language, 
+    const char *hh_excepts, int want_stil )
+{
+    stripper_scan_func func = pipeline_lookup();
+    if ( func != NULL )
+    {
+        pipeline *p = calloc( 1, sizeof(pipeline) );
+        if ( p != NULL )
+        {
+            range_sink sink;
+            sink.arg = p;
+            sink.text = pipeline_text;
+            sink.range = pipeline_range;
+            if ( !(func)(xml, xlen, rules, rlen, style, language, hh_excepts,
+                &sink, (want_stil)?&p->stil:NULL, &p->stil_len) 
+                || p->hf == NULL )
+            {
+                warning("pipeline: failed to strip XML\n");
+                pipeline_dispose( p );
+                p = NULL;
+            }
+        }
+        else
+            warning("pipeline: failed to allocate object\n");
+        return p;
+    }
+    else
+        return NULL;
+}
+/**
+ * Dispose of a pipeline and its master
+ * @param p the pipeline in question
+ */
+void pipeline_dispose( pipeline *p )
+{
+    if ( p->hf != NULL )
+        master_dispose( p->hf );
+    if ( p->text != NULL )
+        free( p->text );
+    // allocated by the stripper
+    if ( p->stil != NULL )
+        free( p->stil );
+    free( p );
+}
+/**
+ * Get the loaded master. Load css into it, then convert.
+ * @param p the pipeline in question
+ * @return the master, which belongs to the pipeline
+ */
+master *pipeline_master( pipeline *p )
+{
+    return p->hf;
+}
+/**
+ * Get the STIL copy of the markup if one was asked for
+ * @param p the pipeline in question
+ * @param len VAR param set to its length
+ * @return the STIL markup or NULL
+ */
+char *pipeline_stil( pipeline *p, int *len )
+{
+    *len = p->stil_len;
+    return p->stil;
+}
@@ -24,6 +24,7 @@
 #include "queue.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 #define QUEUE_BLK_SIZE 20
 /**
  * Implement a queue of ranges for dom algorithm
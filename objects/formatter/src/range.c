@@ -28,6 +28,7 @@
 #include "node.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 #define MAX_TAGLEN 128
 #define MIN_TEXTLEN 512
 struct range_struct
@@ -182,7 +183,9 @@ void range_dispose( range *r )
     free( r );
 }
 /**
- * Compare two ranges. Sort on increasing offset then on decreasing length
+ * Compare two ranges. Sort on increasing offset then on decreasing length,
+ * then on name, so that ranges over the same text always nest the same 
+ * way whatever order they were loaded or sorted in
  * @param r1 the first range
  * @param r2 the second range
  * @return 1 if r1 > r2, if equal 0 else -1
@@ -199,8 +202,13 @@ int range_compare( void *key1, void *key2 )
         return 1;
     else if ( r1->len > r2->len )
         return -1;
+    else if ( r1->name == NULL || r2->name == NULL )
+        return (r1->name!=NULL)-(r2->name!=NULL);
     else
-        return 0;
+    {
+        int res = strcmp( r1->name, r2->name );
+        return (res>0)-(res<0);
+    }
 }
 /**
  * Get the end offset of this range
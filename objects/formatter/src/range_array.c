@@ -22,8 +22,10 @@
 #include "annotation.h"
 #include "range.h"
 #include "range_array.h"
+#include "sort.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 #define RANGE_BLOCK_SIZE 256
 struct range_array_struct
 {
@@ -173,35 +175,89 @@ int range_array_insert( range_array *ra, int at, range *r )
         return 0;
 }
 /**
- * Sort the ranges using shellsort for printing
- * @param d the dom in question
+ * Reset the reloff fields of sorted ranges from their start offsets
+ * @param ra the range array in question
+ */
+static void range_array_set_reloffs( range_array *ra )
+{
+    int i,k;
+    for ( k=0,i=0;i<ra->num_ranges;i++ )
+    {
+        range *r = ra->ranges[i];
+        range_set_reloff( r, range_start(r)-k );
+        k = range_start(r);
+    }
+}
+/**
+ * Sort the ranges on start offset, longest first, for printing
+ * @param ra the range array in question
  */
 void range_array_sort( range_array *ra )
 {
-    int i, j, k, h; range *v;
-    int incs[16] = { 1391376, 463792, 198768, 86961, 33936,
-        13776, 4592, 1968, 861, 336, 
-        112, 48, 21, 7, 3, 1 };
-    for ( k = 0; k < 16; k++)
+    sort_stable( (void**)ra->ranges, ra->num_ranges, range_compare );
+    range_array_set_reloffs( ra );
+}
+/**
+ * Merge sorted runs of ranges, e.g. from separately loaded layers, into 
+ * an already sorted array. Ranges that compare equal keep the order of 
+ * the runs, after those already in the array. There are only ever a few 
+ * runs, so the smallest head is found by scanning them.
+ * @param ra the sorted range array to merge into
+ * @param runs the sorted runs, which are emptied into ra
+ * @param n the number of runs
+ * @return 1 if it worked, else 0
+ */
+int range_array_merge( range_array *ra, range_array **runs, int n )
+{
+    int i,total = ra->num_ranges;
+    int *heads = calloc( n+1, sizeof(int) );
+    range_array **all = calloc( n+1, sizeof(range_array*) );
+    range **merged;
+    for ( i=0;i<n;i++ )
+        total += runs[i]->num_ranges;
+    merged = calloc( (total>0)?total:1, sizeof(range*) );
+    if ( heads != NULL && all != NULL && merged != NULL )
     {
-        for ( h=incs[k],i=h;i<=ra->num_ranges-1;i++ )
-        { 
-            v = ra->ranges[i]; 
-            j = i;
-            while (j >= h && range_compare(ra->ranges[j-h],v)>0 )
-            { 
-                ra->ranges[j] = ra->ranges[j-h]; 
-                j -= h; 
+        int j;
+        all[0] = ra;
+        for ( i=0;i<n;i++ )
+            all[i+1] = runs[i];
+        for ( j=0;j<total;j++ )
+        {
+            int best = -1;
+            for ( i=0;i<=n;i++ )
+            {
+                if ( heads[i] < all[i]->num_ranges && (best == -1 
+                    || range_compare(all[i]->ranges[heads[i]],
+                    all[best]->ranges[heads[best]])<0) )
+                    best = i;
             }
-            ra->ranges[j] = v; 
+            merged[j] = all[best]->ranges[heads[best]++];
         }
+        for ( i=0;i<n;i++ )
+        {
+            if ( runs[i]->has_removed )
+                ra->has_removed = 1;
+            runs[i]->num_ranges = 0;
+        }
+        free( ra->ranges );
+        ra->ranges = merged;
+        ra->num_ranges = ra->allocated = total;
+        range_array_set_reloffs( ra );
+        free( heads );
+        free( all );
+        return 1;
     }
-    // reset reloff fields
-    for ( k=0,i=0;i<ra->num_ranges;i++ )
+    else
     {
-        range *r = ra->ranges[i];
-        range_set_reloff( r, range_start(r)-k );
-        k = range_start(r);
+        warning("range_array: failed to allocate merge\n");
+        if ( heads != NULL )
+            free( heads );
+        if ( all != NULL )
+            free( all );
+        if ( merged != NULL )
+            free( merged );
+        return 0;
     }
 }
 /**
@@ -0,0 +1,177 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+/**
+ * A column-wise copy of the positions, names and flags of an array of 
+ * ranges. Culling and building the matrix visit every range and look at 
+ * nothing else, so they are quicker reading four packed arrays than 
+ * following a pointer to each range. The ranges themselves keep their 
+ * annotations and html names, and are reached through the last column.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include "hashmap.h"
+#include "attribute.h"
+#include "annotation.h"
+#include "range.h"
+#include "range_array.h"
+#include "hashset.h"
+#include "range_table.h"
+#include "error.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+struct range_table_struct
+{
+    int size;
+    /** absolute start offsets */
+    int *starts;
+    int *lens;
+    /** property ids less 1 or -1 if not wanted */
+    int *names;
+    unsigned char *flags;
+    /** the range of each row */
+    range **ranges;
+};
+/**
+ * Make a table of the ranges in an array
+ * @param ra the ranges, which must outlive the table
+ * @param names the property names to number, or NULL if not needed
+ * @return the table or NULL
+ */
+range_table *range_table_create( range_array *ra, hashset *names )
+{
+    range_table *rt = calloc( 1, sizeof(range_table) );
+    if ( rt != NULL )
+    {
+        int n = range_array_size( ra );
+        int m = (n>0)?n:1;
+        rt->starts = calloc( 3*m, sizeof(int) );
+        rt->flags = calloc( m, 1 );
+        rt->ranges = calloc( m, sizeof(range*) );
+        if ( rt->starts != NULL && rt->flags != NULL && rt->ranges != NULL )
+        {
+            int i;
+            range **rs = range_array_ranges( ra );
+            rt->lens = rt->starts+m;
+            rt->names = rt->lens+m;
+            rt->size = n;
+            for ( i=0;i<n;i++ )
+            {
+                range *r = rs[i];
+                rt->ranges[i] = r;
+                rt->starts[i] = range_start( r );
+                rt->lens[i] = range_len( r );
+                rt->names[i] = (names==NULL)?-1
+                    :hashset_get(names,range_name(r))-1;
+                rt->flags[i] = range_get_removed(r)?RANGE_TABLE_REMOVED:0;
+            }
+        }
+        else
+        {
+            warning("range_table: failed to allocate columns\n");
+            range_table_dispose( rt );
+            rt = NULL;
+        }
+    }
+    else
+        warning("range_table: failed to allocate table\n");
+    return rt;
+}
+/**
+ * Dispose of a table but not its ranges
+ * @param rt the table in question
+ */
+void range_table_dispose( range_table *rt )
+{
+    if ( rt->starts != NULL )
+        free( rt->starts );
+    if ( rt->flags != NULL )
+        free( rt->flags );
+    if ( rt->ranges != NULL )
+        free( rt->ranges );
+    free( rt );
+}
+/**
+ * Get the number of rows
+ * @param rt the table in question
+ * @return the number of ranges in it
+ */
+int range_table_size( range_table *rt )
+{
+    return rt->size;
+}
+/**
+ * Get the start offsets column
+ * @param rt the table in question
+ * @return an array of absolute start offsets
+ */
+int *range_table_starts( range_table *rt )
+{
+    return rt->starts;
+}
+/**
+ * Get the lengths column
+ * @param rt the table in question
+ * @return an array of range lengths
+ */
+int *range_table_lens( range_table *rt )
+{
+    return rt->lens;
+}
+/**
+ * Get the names column
+ * @param rt the table in question
+ * @return an array of property ids less 1, -1 if not numbered
+ */
+int *range_table_names( range_table *rt )
+{
+    return rt->names;
+}
+/**
+ * Get the flags column
+ * @param rt the table in question
+ * @return an array of RANGE_TABLE_REMOVED bits
+ */
+unsigned char *range_table_flags( range_table *rt )
+{
+    return rt->flags;
+}
+/**
+ * Get the ranges the rows were copied from
+ * @param rt the table in question
+ * @return an array of ranges
+ */
+range **range_table_ranges( range_table *rt )
+{
+    return rt->ranges;
+}
+/**
+ * Are the rows in range_compare order, by start then longest first?
+ * @param rt the table in question
+ * @return 1 if they are, else 0
+ */
+int range_table_is_sorted( range_table *rt )
+{
+    int i;
+    for ( i=1;i<rt->size;i++ )
+    {
+        if ( rt->starts[i] < rt->starts[i-1] || (rt->starts[i] 
+            == rt->starts[i-1] && rt->lens[i] > rt->lens[i-1]) )
+            return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,549 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+
+#if RENDER_DUMP
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "hashmap.h"
+#include "attribute.h"
+#include "annotation.h"
+#include "range.h"
+#include "range_array.h"
+#include "bson.h"
+#include "hashset.h"
+#include "css_sheet.h"
+#include "master.h"
+#include "error.h"
+#include "memwatch.h"
+#include "stats_alloc.h"
+/*
+ * Re-render a whole Calliope database offline from a mongodump of it.
+ * cortex holds the texts, corcode their markup under docid+"/default"
+ * and corform the CSS under the name of each style. Every document
+ * whose text and markup are both plain is rendered, on all cores, into
+ * a directory tree of HTML files or into a single bson file. Each
+ * document that can't be rendered is named on stderr and makes the exit
+ * status non-zero, so a partial dump isn't mistaken for a whole one.
+ */
+#define ERROR_PREFIX "<html><body><p>Error:"
+#define DEFAULT_STYLE "default"
+#define MARKUP_SUFFIX "/default"
+/** one document to render */
+typedef struct
+{
+    const char *docid;
+    const char *text;
+    int tlen;
+    const char *markup;
+    int mlen;
+    const char *format;
+    const char *css;
+    int clen;
+    /** the finished HTML waiting to be written in order, or NULL */
+    char *html;
+    int hlen;
+    int done;
+} job;
+/** state shared by the render threads */
+typedef struct
+{
+    job *jobs;
+    int num_jobs;
+    int next_job;
+    /** the next job to write to the bson file */
+    int next_write;
+    int rendered;
+    int failed;
+    const char *out_dir;
+    FILE *out_bson;
+    pthread_mutex_t lock;
+} render_state;
+static char *dump_dir = NULL;
+static char *out_dir = NULL;
+static char *out_bson = NULL;
+static int num_threads = 0;
+/**
+ * Print a simple help message
+ */
+static void print_help()
+{
+    fprintf( stderr,
+        "usage: render-dump [-h] [-j threads] (-o dir | -b bson-file) "
+            "dump-dir\n"
+        "render-dump renders every document in a mongodump of the "
+            "calliope database.\n"
+        "Options are: \n"
+        "-h print this help message\n"
+        "-j the number of threads (default: one per core)\n"
+        "-o dir write each document to dir/<docid>.html\n"
+        "-b file write {docid,format,body} documents to a bson file\n"
+        "dump-dir the folder containing cortex.bson, corcode.bson and "
+            "corform.bson\n");
+}
+/**
+ * Check the commandline arguments
+ * @param argc number of commandline args+1
+ * @param argv array of arguments, first is program name
+ * @return 1 if they were OK, 0 otherwise
+ */
+static int check_args( int argc, char **argv )
+{
+    int i,sane = 1;
+    for ( i=1;i<argc&&sane;i++ )
+    {
+        if ( strlen(argv[i])==2 && argv[i][0]=='-' )
+        {
+            switch ( argv[i][1] )
+            {
+                case 'j':
+                    if ( i < argc-1 )
+                        num_threads = atoi( argv[++i] );
+                    sane = num_threads > 0;
+                    break;
+                case 'o':
+                    if ( i < argc-1 )
+                        out_dir = argv[++i];
+                    else
+                        sane = 0;
+                    break;
+                case 'b':
+                    if ( i < argc-1 )
+                        out_bson = argv[++i];
+                    else
+                        sane = 0;
+                    break;
+                default:
+                    sane = 0;
+                    break;
+            }
+        }
+        else if ( i == argc-1 )
+            dump_dir = argv[i];
+        else
+            sane = 0;
+    }
+    return sane && dump_dir != NULL && (out_dir==NULL) != (out_bson==NULL);
+}
+/**
+ * Open one of the collections in the dump
+ * @param name the collection name
+ * @return the open file or NULL
+ */
+static bson_file *open_collection( const char *name )
+{
+    char path[FILENAME_MAX];
+    snprintf( path, FILENAME_MAX, "%s/%s.bson", dump_dir, name );
+    return bson_file_open( path );
+}
+/**
+ * Map each docid in a collection to its document
+ * @param bf the open collection
+ * @param docs store the documents here, keyed by docid. The values
+ * point into the collection's mapping.
+ * @return the number of documents indexed
+ */
+static int index_collection( bson_file *bf, hashmap *docs )
+{
+    int len,n = 0;
+    const char *doc;
+    while ( (doc=bson_file_next(bf,&len)) != NULL )
+    {
+        int dlen;
+        const char *docid = bson_get_string( doc, len, "docid", &dlen );
+        if ( docid != NULL && hashmap_put(docs,(char*)docid,(void*)doc) )
+            n++;
+    }
+    return n;
+}
+/**
+ * Get the length of a document that we know to be valid
+ * @param doc the document
+ * @return its length in bytes
+ */
+static int doc_len( const char *doc )
+{
+    const unsigned char *u = (const unsigned char*)doc;
+    return u[0]|(u[1]<<8)|(u[2]<<16)|(u[3]<<24);
+}
+/**
+ * Find the CSS for a style, falling back to the default style
+ * @param forms the corform documents by docid
+ * @param style the style name or NULL
+ * @param clen set to the length of the CSS
+ * @return the CSS or NULL
+ */
+static const char *find_css( hashmap *forms, const char *style, int *clen )
+{
+    const char *form = NULL;
+    if ( style != NULL )
+        form = hashmap_get( forms, (char*)style );
+    if ( form == NULL )
+        form = hashmap_get( forms, DEFAULT_STYLE );
+    return (form==NULL)?NULL:bson_get_string(form,doc_len(form),"body",clen);
+}
+/**
+ * Make the parent directories of a file
+ * @param path the file's path, which is restored on exit
+ * @return 1 if they exist, else 0
+ */
+static int make_parents( char *path )
+{
+    char *slash = path;
+    while ( (slash=strchr(slash+1,'/')) != NULL )
+    {
+        *slash = 0;
+        if ( mkdir(path,0755) != 0 && errno != EEXIST )
+        {
+            warning("render-dump: failed to create %s\n",path);
+            *slash = '/';
+            return 0;
+        }
+        *slash = '/';
+    }
+    return 1;
+}
+/**
+ * Is a docid safe to use as a path under the output directory?
+ * @param docid the docid to check
+ * @return 1 if it is relative and has no ".." components, else 0
+ */
+static int safe_docid( const char *docid )
+{
+    const char *c = docid;
+    if ( *docid == 0 || *docid == '/' )
+        return 0;
+    while ( c != NULL )
+    {
+        if ( c[0]=='.' && c[1]=='.' && (c[2]=='/'||c[2]==0) )
+            return 0;
+        c = strchr( c, '/' );
+        if ( c != NULL )
+            c++;
+    }
+    return 1;
+}
+/**
+ * Write one rendered document to the output directory
+ * @param dir the output directory
+ * @param j the job that has been rendered
+ * @return 1 if it was written, else 0
+ */
+static int write_html_file( const char *dir, job *j )
+{
+    int res = 0;
+    char path[FILENAME_MAX];
+    if ( !safe_docid(j->docid) )
+    {
+        warning("render-dump: unsafe docid %s\n",j->docid);
+        return 0;
+    }
+    snprintf( path, FILENAME_MAX, "%s/%s.html", dir, j->docid );
+    if ( make_parents(path) )
+    {
+        FILE *dst = fopen( path, "w" );
+        if ( dst != NULL )
+        {
+            res = fwrite( j->html, 1, j->hlen, dst ) == j->hlen;
+            fclose( dst );
+        }
+        if ( !res )
+            warning("render-dump: failed to write %s\n",path);
+    }
+    return res;
+}
+/**
+ * Write the finished jobs to the bson file in their original order.
+ * Call with the lock held.
+ * @param rs the shared render state
+ */
+static void flush_bson( render_state *rs )
+{
+    while ( rs->next_write < rs->num_jobs && rs->jobs[rs->next_write].done )
+    {
+        job *j = &rs->jobs[rs->next_write++];
+        if ( j->html != NULL )
+        {
+            const char *keys[] = {"docid","format","body"};
+            const char *values[] = {j->docid,"HTML",j->html};
+            int lens[3];
+            lens[0] = strlen(j->docid);
+            lens[1] = 4;
+            lens[2] = j->hlen;
+            if ( !bson_write_strings(rs->out_bson,keys,values,lens,3) )
+                warning("render-dump: failed to write %s\n",j->docid);
+            free( j->html );
+            j->html = NULL;
+        }
+    }
+}
+/**
+ * Render one document
+ * @param j the job to render. Its html is set if it worked.
+ * @return 1 if it rendered, else 0
+ */
+static int render_job( job *j )
+{
+    int res = 0;
+    // culling removes text in place so give the master its own copy
+    char *text = malloc( j->tlen+1 );
+    if ( text != NULL )
+    {
+        master *hf;
+        memcpy( text, j->text, j->tlen+1 );
+        hf = master_create( text, j->tlen );
+        if ( hf != NULL )
+        {
+            if ( master_load_markup(hf,j->markup,j->mlen,j->format)
+                && master_load_css(hf,j->css,j->clen) )
+            {
+                char *html = master_convert( hf );
+                int hlen = master_get_html_len( hf );
+                if ( html != NULL && strncmp(html,ERROR_PREFIX,
+                    strlen(ERROR_PREFIX))!=0 )
+                {
+                    j->html = malloc( hlen );
+                    if ( j->html != NULL )
+                    {
+                        memcpy( j->html, html, hlen );
+                        j->hlen = hlen;
+                        res = 1;
+                    }
+                }
+            }
+            master_dispose( hf );
+        }
+        free( text );
+    }
+    if ( !res )
+        warning("render-dump: failed to render %s\n",j->docid);
+    return res;
+}
+/**
+ * Render jobs until there are none left
+ * @param arg the shared render state
+ * @return NULL
+ */
+static void *render_thread( void *arg )
+{
+    render_state *rs = arg;
+    while ( 1 )
+    {
+        job *j;
+        int res;
+        pthread_mutex_lock( &rs->lock );
+        j = (rs->next_job<rs->num_jobs)?&rs->jobs[rs->next_job++]:NULL;
+        pthread_mutex_unlock( &rs->lock );
+        if ( j == NULL )
+            break;
+        res = render_job( j );
+        if ( res && rs->out_dir != NULL )
+        {
+            res = write_html_file( rs->out_dir, j );
+            free( j->html );
+            j->html = NULL;
+        }
+        pthread_mutex_lock( &rs->lock );
+        j->done = 1;
+        if ( res )
+            rs->rendered++;
+        else
+            rs->failed++;
+        if ( rs->out_bson != NULL )
+            flush_bson( rs );
+        pthread_mutex_unlock( &rs->lock );
+    }
+    return NULL;
+}
+/**
+ * Join the texts to their markup and CSS
+ * @param texts the cortex collection
+ * @param codes the corcode documents by docid
+ * @param forms the corform documents by docid
+ * @param num_jobs set to the number of jobs
+ * @param skipped set to the number of documents that can't be rendered
+ * @return an array of jobs or NULL
+ */
+static job *make_jobs( bson_file *texts, hashmap *codes, hashmap *forms,
+    int *num_jobs, int *skipped )
+{
+    int len,n = 0,size = 64;
+    const char *doc;
+    job *jobs = malloc( size*sizeof(job) );
+    *skipped = 0;
+    while ( jobs != NULL && (doc=bson_file_next(texts,&len)) != NULL )
+    {
+        int slen;
+        char key[FILENAME_MAX];
+        const char *code,*style,*tformat;
+        job j;
+        memset( &j, 0, sizeof(job) );
+        j.docid = bson_get_string( doc, len, "docid", &slen );
+        if ( j.docid == NULL )
+            continue;
+        snprintf( key, FILENAME_MAX, "%s%s", j.docid, MARKUP_SUFFIX );
+        code = hashmap_get( codes, key );
+        if ( code == NULL )
+        {
+            warning("render-dump: no markup for %s\n",j.docid);
+            (*skipped)++;
+            continue;
+        }
+        j.text = bson_get_string( doc, len, "body", &j.tlen );
+        j.markup = bson_get_string( code, doc_len(code), "body", &j.mlen );
+        j.format = bson_get_string( code, doc_len(code), "format", &slen );
+        style = bson_get_string( code, doc_len(code), "style", &slen );
+        if ( style == NULL )
+            style = bson_get_string( doc, len, "style", &slen );
+        j.css = find_css( forms, style, &j.clen );
+        tformat = bson_get_string( doc, len, "format", &slen );
+        // MVDs hold many versions, which this tool can't yet unpack
+        if ( (tformat != NULL && strncmp(tformat,"MVD",3)==0)
+            || (j.format != NULL && strncmp(j.format,"MVD",3)==0) )
+        {
+            warning("render-dump: %s is an MVD\n",j.docid);
+            (*skipped)++;
+            continue;
+        }
+        if ( j.text == NULL || j.markup == NULL || j.format == NULL
+            || j.css == NULL || j.tlen == 0 )
+        {
+            warning("render-dump: %s is incomplete\n",j.docid);
+            (*skipped)++;
+            continue;
+        }
+        if ( n == size )
+        {
+            job *bigger = realloc( jobs, size*2*sizeof(job) );
+            if ( bigger == NULL )
+            {
+                free( jobs );
+                jobs = NULL;
+                break;
+            }
+            jobs = bigger;
+            size *= 2;
+        }
+        jobs[n++] = j;
+    }
+    if ( jobs == NULL )
+        warning("render-dump: failed to allocate jobs\n");
+    *num_jobs = n;
+    return jobs;
+}
+/**
+ * Render every job on several threads
+ * @param rs the shared render state
+ * @return 1 if all the threads ran, else 0
+ */
+static int render_all( render_state *rs )
+{
+    int i,started = 0;
+    pthread_t *threads = calloc( num_threads, sizeof(pthread_t) );
+    if ( threads != NULL )
+    {
+        for ( i=0;i<num_threads;i++ )
+        {
+            if ( pthread_create(&threads[i],NULL,render_thread,rs) != 0 )
+                break;
+            started++;
+        }
+        // if no thread started render on this one
+        if ( started == 0 )
+            render_thread( rs );
+        for ( i=0;i<started;i++ )
+            pthread_join( threads[i], NULL );
+        free( threads );
+    }
+    return threads != NULL;
+}
+/**
+ * Render a Calliope dump
+ * @param argc the number of commandline args+1
+ * @param argv the commandline arguments
+ * @return 0 if it worked, else 1
+ */
+int main( int argc, char **argv )
+{
+    int res = 1;
+    if ( !check_args(argc,argv) )
+    {
+        print_help();
+        return res;
+    }
+    if ( num_threads == 0 )
+        num_threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    if ( num_threads <= 0 )
+        num_threads = 1;
+    bson_file *texts = open_collection( "cortex" );
+    bson_file *codes = open_collection( "corcode" );
+    bson_file *forms = open_collection( "corform" );
+    hashmap *code_map = hashmap_create();
+    hashmap *form_map = hashmap_create();
+    if ( texts != NULL && codes != NULL && forms != NULL
+        && code_map != NULL && form_map != NULL )
+    {
+        render_state rs;
+        int skipped;
+        memset( &rs, 0, sizeof(render_state) );
+        index_collection( codes, code_map );
+        index_collection( forms, form_map );
+        rs.jobs = make_jobs( texts, code_map, form_map, &rs.num_jobs,
+            &skipped );
+        rs.out_dir = out_dir;
+        if ( out_bson != NULL )
+        {
+            rs.out_bson = fopen( out_bson, "w" );
+            if ( rs.out_bson == NULL )
+                warning("render-dump: failed to open %s\n",out_bson);
+        }
+        if ( rs.jobs != NULL && (out_bson==NULL||rs.out_bson!=NULL) )
+        {
+            pthread_mutex_init( &rs.lock, NULL );
+            if ( render_all(&rs) )
+            {
+                fprintf( stderr, "render-dump: rendered %d, failed %d, "
+                    "skipped %d (MVD or incomplete) on %d threads\n",
+                    rs.rendered, rs.failed, skipped, num_threads );
+                res = (rs.failed==0&&skipped==0)?0:1;
+            }
+            pthread_mutex_destroy( &rs.lock );
+        }
+        if ( rs.out_bson != NULL )
+            fclose( rs.out_bson );
+        if ( rs.jobs != NULL )
+            free( rs.jobs );
+    }
+    if ( code_map != NULL )
+        hashmap_dispose( code_map );
+    if ( form_map != NULL )
+        hashmap_dispose( form_map );
+    if ( texts != NULL )
+        bson_file_close( texts );
+    if ( codes != NULL )
+        bson_file_close( codes );
+    if ( forms != NULL )
+        bson_file_close( forms );
+    return res;
+}
+#endif
@@ -0,0 +1,277 @@
+/*
+ * This file is part of formatter.
+ *
+ *  formatter is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  formatter is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with formatter.  If not, see <http://www.gnu.org/licenses/>.
+ *  (c) copyright Desmond Schmidt 2011
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#define usable_size(p) malloc_size(p)
+#else
+#include <malloc.h>
+#define usable_size(p) malloc_usable_size(p)
+#endif
+#include "stats.h"
+/**
+ * Phase timings and counters. Each thread records the call it is 
+ * running without any locking, and stats_end adds that call to the 
+ * process-wide totals with atomic adds. Allocations made through 
+ * stats_alloc.h are charged to the phase running when they were made, 
+ * measured by the allocator's usable size so no per-block record is 
+ * needed. live is what the call holds now and peak its high-water mark.
+ */
+static const char *phase_names[STATS_NUM_PHASES+1] = {"strip","css",
+    "markup","cull","matrix","build","print","other"};
+static const char *counter_names[STATS_NUM_COUNTERS] = {"ranges","nodes",
+    "splits","drops","output_bytes"};
+/** the call running on this thread */
+static __thread stats_block current;
+/** the last finished call on this thread */
+static __thread stats_block last;
+/** the phase running on this thread */
+static __thread int phase_now = STATS_OTHER;
+/** every finished call */
+static stats_block totals;
+static long long calls = 0;
+/**
+ * Start recording a new call on this thread
+ */
+void stats_begin()
+{
+    memset( &current, 0, sizeof(stats_block) );
+    phase_now = STATS_OTHER;
+}
+/**
+ * Finish the call on this thread and add it to the totals
+ */
+void stats_end()
+{
+    int i;
+    for ( i=0;i<STATS_NUM_PHASES;i++ )
+        __atomic_fetch_add( &totals.ns[i], current.ns[i], __ATOMIC_RELAXED );
+    for ( i=0;i<STATS_NUM_COUNTERS;i++ )
+        __atomic_fetch_add( &totals.counts[i], current.counts[i], 
+            __ATOMIC_RELAXED );
+    for ( i=0;i<=STATS_NUM_PHASES;i++ )
+    {
+        __atomic_fetch_add( &totals.alloc_bytes[i], current.alloc_bytes[i], 
+            __ATOMIC_RELAXED );
+        __atomic_fetch_add( &totals.alloc_count[i], current.alloc_count[i], 
+            __ATOMIC_RELAXED );
+    }
+    long long peak = __atomic_load_n( &totals.peak, __ATOMIC_RELAXED );
+    while ( current.peak > peak && !__atomic_compare_exchange_n(
+        &totals.peak, &peak, current.peak, 1, __ATOMIC_RELAXED, 
+        __ATOMIC_RELAXED) );
+    __atomic_fetch_add( &calls, 1, __ATOMIC_RELAXED );
+    last = current;
+}
+/**
+ * Read the monotonic clock
+ * @return the time in nanoseconds
+ */
+long long stats_now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (long long)ts.tv_sec*1000000000LL+ts.tv_nsec;
+}
+/**
+ * Start a phase: its allocations are charged to it until stats_time
+ * @param phase the phase, e.g. STATS_CSS
+ * @return the time now, to pass to stats_time
+ */
+long long stats_enter( int phase )
+{
+    phase_now = phase;
+    return stats_now();
+}
+/**
+ * Add the time since a phase started to it and end the phase
+ * @param phase the phase, e.g. STATS_CSS
+ * @param since the result of stats_now when it started
+ */
+void stats_time( int phase, long long since )
+{
+    current.ns[phase] += stats_now()-since;
+    phase_now = STATS_OTHER;
+}
+/**
+ * Add to a counter
+ * @param counter the counter, e.g. STATS_NODES
+ * @param n the amount to add
+ */
+void stats_count( int counter, long n )
+{
+    current.counts[counter] += n;
+}
+/**
+ * Charge a new block to the running phase
+ * @param p the block or NULL if the allocation failed
+ * @return p
+ */
+static void *stats_charge( void *p )
+{
+    if ( p != NULL )
+    {
+        long long size = (long long)usable_size( p );
+        current.alloc_bytes[phase_now] += size;
+        current.alloc_count[phase_now]++;
+        current.live += size;
+        if ( current.live > current.peak )
+            current.peak = current.live;
+    }
+    return p;
+}
+/**
+ * Allocate memory and count it
+ * @param size the number of bytes wanted
+ * @return the block or NULL
+ */
+void *stats_malloc( size_t size )
+{
+    return stats_charge( malloc(size) );
+}
+/**
+ * Allocate zeroed memory and count it
+ * @param n the number of elements
+ * @param size the size of each
+ * @return the block or NULL
+ */
+void *stats_calloc( size_t n, size_t size )
+{
+    return stats_charge( calloc(n,size) );
+}
+/**
+ * Resize a block and count the new size in place of the old
+ * @param ptr the old block or NULL
+ * @param size the new size
+ * @return the new block or NULL, when ptr is still valid
+ */
+void *stats_realloc( void *ptr, size_t size )
+{
+    long long old = (ptr!=NULL)?(long long)usable_size(ptr):0;
+    void *p = realloc( ptr, size );
+    if ( p != NULL )
+        current.live -= old;
+    return stats_charge( p );
+}
+/**
+ * Duplicate a string and count the copy
+ * @param str the string
+ * @return the copy or NULL
+ */
+char *stats_strdup( const char *str )
+{
+    return stats_charge( strdup(str) );
+}
+/**
+ * Free a block and take it off the live bytes
+ * @param ptr the block or NULL
+ */
+void stats_free( void *ptr )
+{
+    if ( ptr != NULL )
+    {
+        current.live -= (long long)usable_size( ptr );
+        free( ptr );
+    }
+}
+/**
+ * Copy the call so far on this thread, e.g. to hand a helper thread's 
+ * work back to the thread that is timing the call
+ * @param b the block to copy it into
+ */
+void stats_current( stats_block *b )
+{
+    *b = current;
+}
+/**
+ * Charge a helper thread's counts and allocations to the call on this 
+ * thread. Its times are not added, since the phase was timed here.
+ * @param b the helper's block from stats_current
+ */
+void stats_adopt( stats_block *b )
+{
+    int i;
+    for ( i=0;i<STATS_NUM_COUNTERS;i++ )
+        current.counts[i] += b->counts[i];
+    for ( i=0;i<=STATS_NUM_PHASES;i++ )
+    {
+        current.alloc_bytes[i] += b->alloc_bytes[i];
+        current.alloc_count[i] += b->alloc_count[i];
+    }
+    current.live += b->live;
+    if ( current.live > current.peak )
+        current.peak = current.live;
+}
+/**
+ * Get the last finished call on this thread
+ * @param b the block to copy it into
+ */
+void stats_last( stats_block *b )
+{
+    *b = last;
+}
+/**
+ * Print one block of stats as a JSON object
+ * @param b the block
+ * @param buf the buffer to print into
+ * @param len its length
+ * @return the number of chars printed
+ */
+static int stats_print_block( stats_block *b, char *buf, int len )
+{
+    int i,pos = snprintf( buf, len, "{" );
+    for ( i=0;i<STATS_NUM_PHASES&&pos<len;i++ )
+        pos += snprintf( buf+pos, len-pos, "\"%s_ns\":%lld,", phase_names[i], 
+            __atomic_load_n(&b->ns[i],__ATOMIC_RELAXED) );
+    for ( i=0;i<STATS_NUM_COUNTERS&&pos<len;i++ )
+        pos += snprintf( buf+pos, len-pos, "\"%s\":%lld%s", counter_names[i], 
+            __atomic_load_n(&b->counts[i],__ATOMIC_RELAXED),
+            (i<STATS_NUM_COUNTERS-1)?",":"" );
+    for ( i=0;i<=STATS_NUM_PHASES&&pos<len;i++ )
+        pos += snprintf( buf+pos, len-pos, "%s\"%s\":[%lld,%lld]", 
+            (i==0)?",\"alloc\":{":",", phase_names[i], 
+            __atomic_load_n(&b->alloc_bytes[i],__ATOMIC_RELAXED),
+            __atomic_load_n(&b->alloc_count[i],__ATOMIC_RELAXED) );
+    if ( pos < len )
+        pos += snprintf( buf+pos, len-pos, "},\"peak_bytes\":%lld}", 
+            __atomic_load_n(&b->peak,__ATOMIC_RELAXED) );
+    return pos;
+}
+/**
+ * Write the last call on this thread and the process totals as JSON
+ * @param buf the buffer to write to
+ * @param len its length
+ * @return 1 if it all fitted, else 0
+ */
+int stats_json( char *buf, int len )
+{
+    int pos = snprintf( buf, len, "{\"calls\":%lld,\"last\":", 
+        __atomic_load_n(&calls,__ATOMIC_RELAXED) );
+    if ( pos < len )
+        pos += stats_print_block( &last, buf+pos, len-pos );
+    if ( pos < len )
+        pos += snprintf( buf+pos, len-pos, ",\"total\":" );
+    if ( pos < len )
+        pos += stats_print_block( &totals, buf+pos, len-pos );
+    if ( pos < len )
+        pos += snprintf( buf+pos, len-pos, "}" );
+    return pos < len;
+}
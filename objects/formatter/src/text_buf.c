@@ -26,6 +26,7 @@
 #include "text_buf.h"
 #include "error.h"
 #include "memwatch.h"
+#include "stats_alloc.h"
 /** a dynamically resizeable text buffer to hold output */
 struct text_buf_struct
 {
@@ -23,6 +23,14 @@ JNIEXPORT jboolean JNICALL Java_calliope_AeseSpeller_initialise
 JNIEXPORT void JNICALL Java_calliope_AeseSpeller_cleanup
   (JNIEnv *, jobject);
 
+/*
+ * Class:     calliope_AeseSpeller
+ * Method:    prewarm
+ * Signature: ([Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_calliope_AeseSpeller_prewarm
+  (JNIEnv *, jobject, jobjectArray);
+
 /*
  * Class:     calliope_AeseSpeller
  * Method:    hasWord
@@ -31,6 +39,22 @@ JNIEXPORT void JNICALL Java_calliope_AeseSpeller_cleanup
 JNIEXPORT jboolean JNICALL Java_calliope_AeseSpeller_hasWord
   (JNIEnv *, jobject, jstring, jstring);
 
+/*
+ * Class:     calliope_AeseSpeller
+ * Method:    checkText
+ * Signature: (Ljava/lang/String;Ljava/lang/String;)[I
+ */
+JNIEXPORT jintArray JNICALL Java_calliope_AeseSpeller_checkText
+  (JNIEnv *, jobject, jstring, jstring);
+
+/*
+ * Class:     calliope_AeseSpeller
+ * Method:    checkWords
+ * Signature: ([Ljava/lang/String;Ljava/lang/String;)[Z
+ */
+JNIEXPORT jbooleanArray JNICALL Java_calliope_AeseSpeller_checkWords
+  (JNIEnv *, jobject, jobjectArray, jstring);
+
 /*
  * Class:     calliope_AeseSpeller
  * Method:    listDicts
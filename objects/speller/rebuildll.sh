@@ -23,8 +23,8 @@ if [ $USER = "root" ]; then
     JDKINCLUDEDIRNAME="include"
   fi
   JDKINC=`getjdkinclude`
-  gcc -c -DHAVE_MEMMOVE -DJNI -I$JDKINC -Iinclude -O0 -Wall -g3 -fPIC src/aesespeller.c
-  gcc *.o -shared -laspell -o libAeseSpeller.$LIBSUFFIX
+  gcc -c -DHAVE_MEMMOVE -DJNI -I$JDKINC -Iinclude -I../dictionary/include -O0 -Wall -g3 -fPIC src/aesespeller.c
+  gcc *.o -shared -L/usr/local/lib -lAeseDictionary -laspell -o libAeseSpeller.$LIBSUFFIX
   cp libAeseSpeller.$LIBSUFFIX /usr/local/lib
   rm libAeseSpeller.$LIBSUFFIX
   rm *.o
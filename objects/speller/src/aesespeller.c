@@ -3,15 +3,7 @@
 #include <string.h>
 #include "calliope_AeseSpeller.h"
 #include "aspell.h"
-/** spell check object */
-typedef struct checker_struct checker;
-struct checker_struct
-{
-    AspellSpeller *spell_checker;
-    AspellConfig *spell_config;
-    char lang[24];
-    checker *next;
-};
+#include "speller_pool.h"
 struct dict_info_struct
 {
     const char *name;
@@ -19,7 +11,6 @@ struct dict_info_struct
     struct dict_info_struct *next;
 };
 typedef struct dict_info_struct dict_info;
-static checker *checkers = NULL;
 
 static void unload_string( JNIEnv *env, jstring jstr, const char *cstr, 
     jboolean copied )
@@ -31,63 +22,71 @@ static const char *load_string( JNIEnv *env, jstring jstr, jboolean *copied )
 {
     return (*env)->GetStringUTFChars(env, jstr, copied);  
 }
-static void checker_dispose( checker *c )
-{
-    if ( c->spell_config != NULL )
-        delete_aspell_config(c->spell_config);
-    if ( c->spell_checker != NULL )
-        delete_aspell_speller(c->spell_checker);
-    if ( c->next != NULL )
-        checker_dispose( c->next );
-    free( c );
-}
 /**
- * Create a spell checker for a language
- * @param language the language code e.g. en_GB or it
- * @return a checker or NULL
+ * Start loading the dictionaries named in AESE_LANGUAGES, a colon-
+ * separated list, as soon as the library is loaded
+ * @param vm the Java VM
+ * @param reserved unused
+ * @return the JNI version we need
  */
-static checker *checker_create( const char *language )
+JNIEXPORT jint JNICALL JNI_OnLoad( JavaVM *vm, void *reserved )
 {
-    int err = 0;
-    checker *c = calloc( 1, sizeof(checker) );
-    if ( c != NULL )
+    const char *list = getenv( "AESE_LANGUAGES" );
+    char *copy = (list==NULL)?NULL:strdup( list );
+    if ( copy != NULL )
     {
-        strncpy(c->lang,language,24);
-        c->spell_config = new_aspell_config();
-        if ( c->spell_config != NULL )
+        const char *languages[32];
+        int n = 0;
+        char *lang = strtok( copy, ":" );
+        while ( lang != NULL && n < 32 )
         {
-            aspell_config_replace( c->spell_config, "lang", language );
-            AspellCanHaveError *possible_err 
-                = new_aspell_speller(c->spell_config);
-            c->spell_checker = 0;
-            if (aspell_error_number(possible_err) != 0)
-            {
-                fprintf(stderr,"%s\n",aspell_error_message(possible_err));
-                err = 1;
-            }
-            else
-            {
-                c->spell_checker = to_aspell_speller(possible_err);
-                if ( c->spell_checker == NULL )
-                {
-                    fprintf(stderr,"checker: failed to initialise speller\n");
-                    err = 1;
-                }
-            }
-            if ( err )
+            languages[n++] = lang;
+            lang = strtok( NULL, ":" );
+        }
+        speller_pool_prewarm( languages, n );
+        free( copy );
+    }
+    return JNI_VERSION_1_6;
+}
+/*
+ * Load dictionaries in the background
+ * Class:     calliope_AeseSpeller
+ * Method:    prewarm
+ * Signature: ([Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_calliope_AeseSpeller_prewarm
+  (JNIEnv *env, jobject obj, jobjectArray langs)
+{
+    int res = 0;
+    int i,n = (*env)->GetArrayLength( env, langs );
+    const char **languages = calloc( n+1, sizeof(char*) );
+    if ( languages != NULL )
+    {
+        for ( i=0;i<n;i++ )
+        {
+            jboolean copied;
+            jstring lang = (*env)->GetObjectArrayElement( env, langs, i );
+            if ( lang != NULL )
             {
-                checker_dispose( c );
-                c = NULL;
+                const char *language = load_string( env, lang, &copied );
+                languages[i] = strdup( language );
+                unload_string( env, lang, language, copied );
+                (*env)->DeleteLocalRef( env, lang );
             }
+            if ( languages[i] == NULL )
+                break;
         }
-        else
-            fprintf(stderr,"checker: failed to create speller\n");
+        res = speller_pool_prewarm( languages, i );
+        while ( i-- > 0 )
+            free( (char*)languages[i] );
+        free( languages );
     }
-    else
-        fprintf(stderr,"checker: failed to create object\n");
-    return c;
+    return res;
 }
 /*
+ * The dictionaries belong to libAeseDictionary and are shared with the 
+ * stripper, so they live as long as the process and there is nothing 
+ * to clean up here.
  * Class:     calliope_AeseSpeller
  * Method:    cleanup
  * Signature: ()V
@@ -95,23 +94,149 @@ static checker *checker_create( const char *language )
 JNIEXPORT void JNICALL Java_calliope_AeseSpeller_cleanup
   (JNIEnv *env, jobject obj)
 {
-    if ( checkers != NULL )
-    {
-        checker_dispose( checkers );
-        checkers = NULL;
-    }
 }
 JNIEXPORT jboolean JNICALL Java_calliope_AeseSpeller_initialise
   (JNIEnv *env, jobject obj, jstring lang)
 {
     jboolean copied;
-    if ( checkers == NULL )
-    {    
-        const char *language = load_string( env, lang, &copied );
-        checkers = checker_create( language );
-        unload_string( env, lang, language, copied );
+    const char *language = load_string( env, lang, &copied );
+    speller *sp = speller_pool_checkout( language );
+    unload_string( env, lang, language, copied );
+    if ( sp != NULL )
+        speller_pool_checkin( sp );
+    return sp != NULL;
+}
+/**
+ * Decode one character of the modified UTF-8 that JNI hands us
+ * @param text the text
+ * @param len its length in bytes
+ * @param pos the offset of the character, advanced past it
+ * @return the character's code point (surrogates are not joined)
+ */
+static int next_char( const char *text, int len, int *pos )
+{
+    const unsigned char *u = (const unsigned char*)text;
+    int c = u[(*pos)++];
+    int extra = (c>=0xE0)?2:(c>=0xC0)?1:0;
+    c &= (extra==2)?0x0F:(extra==1)?0x1F:0x7F;
+    while ( extra-- > 0 && *pos < len && (u[*pos]&0xC0)==0x80 )
+        c = (c<<6)|(u[(*pos)++]&0x3F);
+    return c;
+}
+/**
+ * Is a character part of a word? Punctuation, spaces and symbols in the
+ * Latin-1 and general punctuation blocks are not, nor are surrogates.
+ * @param c the character's code point
+ * @return 1 if it is a letter, else 0
+ */
+static int is_letter( int c )
+{
+    if ( c < 0x80 )
+        return (c>='a'&&c<='z')||(c>='A'&&c<='Z');
+    else if ( c < 0xC0 || c == 0xD7 || c == 0xF7 )
+        return 0;
+    else if ( (c>=0x2000&&c<=0x206F)||(c>=0x3000&&c<=0x303F)
+        ||(c>=0xD800&&c<=0xDFFF)||(c>=0xFE30&&c<=0xFE4F) )
+        return 0;
+    else
+        return 1;
+}
+/**
+ * Is a character an apostrophe, which may join the letters of a word?
+ * @param c the character's code point
+ * @return 1 if it is ' or a right single quote
+ */
+static int is_apostrophe( int c )
+{
+    return c == '\'' || c == 0x2019;
+}
+/**
+ * Check one word, replacing curly apostrophes, which aspell doesn't know
+ * @param sp the speller to use
+ * @param word the word in UTF-8
+ * @param len its length in bytes
+ * @return 1 if it is correct or couldn't be checked, else 0
+ */
+static int check_word( speller *sp, const char *word, int len )
+{
+    char buf[128];
+    const char *curly = "\xE2\x80\x99";
+    const char *lead = memchr( word, curly[0], len );
+    if ( len < 128 && lead != NULL )
+    {
+        int i,j;
+        for ( i=0,j=0;i<len;i++ )
+        {
+            if ( i+2<len && memcmp(&word[i],curly,3)==0 )
+            {
+                buf[j++] = '\'';
+                i += 2;
+            }
+            else
+                buf[j++] = word[i];
+        }
+        word = buf;
+        len = j;
     }
-    return checkers != NULL;
+    return speller_check( sp, word, len );
+}
+/**
+ * Tokenise a text and check each word. Words are runs of letters with
+ * apostrophes between them. Offsets are counted in UTF-16 units so they 
+ * index the original Java string. JNI's modified UTF-8 encodes each unit 
+ * separately, so there is one unit per lead byte.
+ * @param sp the speller to use
+ * @param text the text in modified UTF-8
+ * @param len its length in bytes
+ * @param errors store the offset, length pairs of bad words here
+ * @param size the number of ints errors can hold, grown as needed
+ * @return the number of ints stored in errors or -1 on failure
+ */
+static int check_text( speller *sp, const char *text, int len, jint **errors,
+    int *size )
+{
+    int pos = 0, unit = 0, n = 0;
+    while ( pos < len )
+    {
+        int start = pos, ustart = unit;
+        int ch = next_char( text, len, &pos );
+        unit++;
+        if ( is_letter(ch) )
+        {
+            int end = pos, uend = unit;
+            while ( pos < len )
+            {
+                int p = pos;
+                ch = next_char( text, len, &pos );
+                unit++;
+                if ( is_letter(ch) )
+                {
+                    end = pos;
+                    uend = unit;
+                }
+                else if ( !is_apostrophe(ch) || end != p )
+                    break;
+            }
+            if ( !check_word(sp,&text[start],end-start) )
+            {
+                if ( n+2 > *size )
+                {
+                    jint *bigger = realloc( *errors, 
+                        (*size*2+2)*sizeof(jint) );
+                    if ( bigger == NULL )
+                        return -1;
+                    *errors = bigger;
+                    *size = *size*2+2;
+                }
+                (*errors)[n++] = ustart;
+                (*errors)[n++] = uend-ustart;
+            }
+            // resume from the character after the word
+            pos = end;
+            unit = uend;
+        }
+    }
+    return n;
 }
 /*
  * Class:     calliope_AeseSpeller
@@ -123,43 +248,104 @@ JNIEXPORT jboolean JNICALL Java_calliope_AeseSpeller_hasWord
 {
     int correct = 0;
     jboolean copied1, copied2;
-    checker *c = checkers;
     const char *word = load_string( env, jword, &copied1 );
     const char *language = load_string( env, lang, &copied2 );
-    while ( c != NULL )
-        if ( strcmp(language,c->lang)!=0 )
-            c = c->next;
-        else
-            break;
-    if ( c == NULL )
+    speller *sp = speller_pool_checkout( language );
+    if ( sp != NULL )
     {
-        c = checker_create( language );
-        if ( c != NULL )
-        {
-            if ( checkers == NULL )
-                checkers = c;
-            else
-            {
-                checker *temp = checkers;
-                while ( temp->next != NULL )
-                    temp = temp->next;
-                temp->next = c;
-            }
-        }
-    }
-    if ( c != NULL )
-    {
-        correct = aspell_speller_check(c->spell_checker, word, 
-            strlen(word));
+        correct = speller_check( sp, word, strlen(word) );
+        speller_pool_checkin( sp );
     }
-    else
-        fprintf(stderr,"checker: no dict for language %s\n",language);
     if ( copied1 )
         unload_string( env, jword, word, copied1 );
     if ( copied2 )
         unload_string( env, lang, language, copied2 );
     return correct;
 }
+/*
+ * Spell-check a whole text in one call
+ * Class:     calliope_AeseSpeller
+ * Method:    checkText
+ * Signature: (Ljava/lang/String;Ljava/lang/String;)[I
+ * @return offset, length pairs of the misspelt words in the text or 
+ * NULL if there is no dictionary for the language
+ */
+JNIEXPORT jintArray JNICALL Java_calliope_AeseSpeller_checkText
+  (JNIEnv *env, jobject obj, jstring jtext, jstring lang)
+{
+    jintArray ret = NULL;
+    jboolean copied1, copied2;
+    const char *text = load_string( env, jtext, &copied1 );
+    const char *language = load_string( env, lang, &copied2 );
+    speller *sp = speller_pool_checkout( language );
+    if ( sp != NULL )
+    {
+        int n = -1, size = 64;
+        jint *errors = malloc( size*sizeof(jint) );
+        if ( errors != NULL )
+            n = check_text( sp, text, (*env)->GetStringUTFLength(env,jtext),
+                &errors, &size );
+        speller_pool_checkin( sp );
+        if ( n >= 0 )
+        {
+            ret = (*env)->NewIntArray( env, n );
+            if ( ret != NULL )
+                (*env)->SetIntArrayRegion( env, ret, 0, n, errors );
+        }
+        else
+            fprintf(stderr,"checker: failed to allocate errors\n");
+        if ( errors != NULL )
+            free( errors );
+    }
+    unload_string( env, jtext, text, copied1 );
+    unload_string( env, lang, language, copied2 );
+    return ret;
+}
+/*
+ * Spell-check an array of words in one call
+ * Class:     calliope_AeseSpeller
+ * Method:    checkWords
+ * Signature: ([Ljava/lang/String;Ljava/lang/String;)[Z
+ * @return a flag for each word, true if it is correct, or NULL if there 
+ * is no dictionary for the language
+ */
+JNIEXPORT jbooleanArray JNICALL Java_calliope_AeseSpeller_checkWords
+  (JNIEnv *env, jobject obj, jobjectArray jwords, jstring lang)
+{
+    jbooleanArray ret = NULL;
+    jboolean copied;
+    const char *language = load_string( env, lang, &copied );
+    speller *sp = speller_pool_checkout( language );
+    if ( sp != NULL )
+    {
+        int i,n = (*env)->GetArrayLength( env, jwords );
+        jboolean *flags = calloc( n+1, sizeof(jboolean) );
+        if ( flags != NULL )
+        {
+            for ( i=0;i<n;i++ )
+            {
+                jboolean copied1;
+                jstring jword = (*env)->GetObjectArrayElement(env,jwords,i);
+                if ( jword != NULL )
+                {
+                    const char *word = load_string( env, jword, &copied1 );
+                    flags[i] = check_word( sp, word, strlen(word) );
+                    unload_string( env, jword, word, copied1 );
+                    (*env)->DeleteLocalRef( env, jword );
+                }
+            }
+            ret = (*env)->NewBooleanArray( env, n );
+            if ( ret != NULL )
+                (*env)->SetBooleanArrayRegion( env, ret, 0, n, flags );
+            free( flags );
+        }
+        else
+            fprintf(stderr,"checker: failed to allocate flags\n");
+        speller_pool_checkin( sp );
+    }
+    unload_string( env, lang, language, copied );
+    return ret;
+}
 /*
  * Return an array of strings, each being the dict's code:name
  * Class:     calliope_AeseSpeller
@@ -0,0 +1,3 @@
+# build the STIL<->BSTIL converter in the current directory
+gcc -DBSTIL_TOOL -Iinclude -O2 -Wall -o bstil src/bstil_tool.c src/BSTIL.c \
+  src/STIL.c src/cJSON.c src/hashmap.c src/error.c src/utils.c -lm
@@ -0,0 +1,27 @@
+/*
+ * BSTIL.h
+ *
+ *  Binary encoding of STIL
+ */
+
+#ifndef BSTIL_H_
+#define BSTIL_H_
+/** every BSTIL file starts with this */
+#define BSTIL_MAGIC "BSTL"
+#define BSTIL_MAGIC_LEN 4
+#define BSTIL_VERSION 1
+/** record flags */
+#define BSTIL_REMOVED 1
+#define BSTIL_CONTENT 2
+#define BSTIL_ANNOTATIONS 4
+/** marks the end of the records */
+#define BSTIL_END 0xFF
+
+int BSTIL_write_header(void *arg, DST_FILE *dst, const char *style );
+int BSTIL_write_tail(void *arg, DST_FILE *dst);
+int BSTIL_write_range( char *name, char **atts, int removed,
+	int offset, int len, char *content, int content_len, int first, 
+    DST_FILE *dst );
+int BSTIL_transcode( const char *data, int len, format *f, DST_FILE *dst );
+char *BSTIL_base64( const char *data, int len );
+#endif /* BSTIL_H_ */
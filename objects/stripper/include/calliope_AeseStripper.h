@@ -23,6 +23,14 @@ JNIEXPORT jint JNICALL Java_calliope_AeseStripper_strip
 JNIEXPORT jobjectArray JNICALL Java_calliope_AeseStripper_formats
   (JNIEnv *, jobject);
 
+/*
+ * Class:     calliope_AeseStripper
+ * Method:    prewarm
+ * Signature: ([Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_calliope_AeseStripper_prewarm
+  (JNIEnv *, jobject, jobjectArray);
+
 #ifdef __cplusplus
 }
 #endif
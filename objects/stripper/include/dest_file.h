@@ -26,6 +26,7 @@ int dest_file_open( dest_file *df );
 int dest_file_close( dest_file *df, int tlen );
 int dest_file_len( dest_file *df );
 int dest_file_write( dest_file *df, char *data, int len );
+void dest_file_set_sink( dest_file *df, range_sink *sink, int write_markup );
 
 
 #ifdef	__cplusplus
@@ -47,5 +47,7 @@ typedef struct
 	const char *text_suffix;
 	const char *markup_suffix;
 	const char *middle_name;
+	/** 1 if the markup is binary and must be encoded for Java */
+	int binary;
 } format;
 #endif /* FORMAT_H_ */
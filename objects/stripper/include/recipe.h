@@ -26,6 +26,7 @@ typedef struct recipe_struct recipe;
 recipe *recipe_new();
 recipe *recipe_load( const char *buf, int len );
 recipe *recipe_dispose( recipe *r );
+recipe *recipe_share( recipe *r );
 char * recipe_simplify( recipe *r, char *name, char **attrs );
 simplification *recipe_has_rule( recipe *r, const char *name,
     const char **attrs );
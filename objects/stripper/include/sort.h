@@ -0,0 +1,28 @@
+/*
+ * This file is part of stripper.
+ *
+ *  stripper is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  stripper is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with stripper.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SORT_H
+#define	SORT_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+typedef int (*sort_compare)( void *key1, void *key2 );
+void sort_stable( void **items, int n, sort_compare cmp );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* SORT_H */
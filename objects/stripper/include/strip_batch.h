@@ -0,0 +1,22 @@
+/*
+ * File:   strip_batch.h
+ * Author: desmond
+ *
+ * Strip every XML file in a directory or manifest on several threads.
+ * Include recipe.h and hh_exceptions.h first.
+ */
+
+#ifndef STRIP_BATCH_H
+#define	STRIP_BATCH_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+int strip_batch_run( const char *dir, const char *manifest, int threads, 
+    const char *format, const char *style, const char *language, 
+    recipe *rules, hh_exceptions *hhe );
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* STRIP_BATCH_H */
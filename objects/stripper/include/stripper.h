@@ -0,0 +1,30 @@
+/*
+ * File:   stripper.h
+ * Author: desmond
+ *
+ * Strip one XML document to a text file and its markup files, for the
+ * tools built around the stripper. Include recipe.h and hh_exceptions.h
+ * first.
+ */
+
+#ifndef STRIPPER_H
+#define	STRIPPER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+typedef struct stripper_struct stripper;
+#ifndef JNI
+stripper *stripper_open( const char *barefile, const char *format,
+    const char *style, const char *language, recipe *rules,
+    hh_exceptions *hhe );
+int stripper_parse( stripper *s, const char *xml, int len );
+void stripper_save( stripper *s );
+int stripper_is_markup( const char *name );
+#endif
+void stripper_dispose( stripper *s );
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* STRIPPER_H */
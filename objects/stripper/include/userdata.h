@@ -48,9 +48,16 @@ dest_file *userdata_text_dest( userdata *u );
 #ifdef JNI
 void userdata_write_files( JNIEnv *env, userdata *u, jobject text, 
     jobject markup );
+int userdata_deliver( userdata *u, range_sink *sink, char **stil, 
+    int *stil_len );
 #else
 void userdata_write_files( userdata *u );
 #endif
+#if STRIPPER_BENCH
+extern int userdata_bench_spell;
+extern long long userdata_bench_spell_ns;
+long long userdata_bench_now();
+#endif
 #ifdef	__cplusplus
 }
 #endif
@@ -0,0 +1,28 @@
+/*
+ * This file is part of stripper.
+ *
+ *  stripper is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  stripper is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with stripper.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef XML_POOL_H
+#define	XML_POOL_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+XML_Parser xml_pool_checkout();
+void xml_pool_checkin( XML_Parser parser );
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* XML_POOL_H */
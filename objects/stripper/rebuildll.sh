@@ -23,8 +23,8 @@ if [ $USER = "root" ]; then
     JDKINCLUDEDIRNAME="include"
   fi
   JDKINC=`getjdkinclude`
-  gcc -c -DHAVE_EXPAT_CONFIG_H -DHAVE_MEMMOVE -DJNI -I$JDKINC -Iinclude -I../formatter/include -I../formatter/include/STIL -O0 -Wall -g3 -fPIC ../formatter/src/STIL/cJSON.c src/*.c  
-  gcc *.o -shared -lexpat -laspell -o libAeseStripper.$LIBSUFFIX
+  gcc -c -DHAVE_EXPAT_CONFIG_H -DHAVE_MEMMOVE -DJNI -I$JDKINC -Iinclude -I../dictionary/include -I../formatter/include -I../formatter/include/STIL -O0 -Wall -g3 -fPIC ../formatter/src/STIL/cJSON.c src/*.c  
+  gcc *.o -shared -L/usr/local/lib -lexpat -lAeseDictionary -o libAeseStripper.$LIBSUFFIX
   cp libAeseStripper.$LIBSUFFIX /usr/local/lib
   rm libAeseStripper.$LIBSUFFIX
   rm *.o
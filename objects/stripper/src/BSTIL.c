@@ -0,0 +1,494 @@
+/*
+ * BSTIL.c
+ *
+ *  Created on: 19/10/2026
+ */
+/* This file is part of stripper.
+ *
+ *  stripper is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  stripper is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with stripper.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * BSTIL is STIL in binary. After the magic "BSTL", a version byte and 
+ * the style there is one record per range:
+ *
+ *   flags      1 byte: BSTIL_REMOVED|BSTIL_CONTENT|BSTIL_ANNOTATIONS
+ *   name       string reference
+ *   reloff     zigzag varint
+ *   len        varint
+ *   content    varint length + bytes, if BSTIL_CONTENT
+ *   annotations varint block length, then varint count and count pairs 
+ *              of key (string reference) and value (varint length + 
+ *              bytes), if BSTIL_ANNOTATIONS
+ *
+ * and a final BSTIL_END byte. A string reference is a varint v. If v is 
+ * odd a new string of length v>>1 follows and gets the next number in 
+ * the string table, else it refers to string number v>>1. Range names 
+ * and annotation keys share the table.
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include "ramfile.h"
+#include "format.h"
+#include "hashmap.h"
+#include "BSTIL.h"
+#include "error.h"
+#include "memwatch.h"
+#define VARINT_MAX 5
+#define LOCAL_BUF_SIZE 512
+/** a small growable byte buffer, on the stack until it overflows */
+typedef struct
+{
+    unsigned char local[LOCAL_BUF_SIZE];
+    unsigned char *buf;
+    int len;
+    int allocated;
+} bytes;
+/** string table of the file being written, reset by the first range */
+static __thread hashmap *strings = NULL;
+static __thread int num_strings = 0;
+/**
+ * Make a byte buffer empty
+ * @param b the buffer
+ */
+static void bytes_init( bytes *b )
+{
+    b->buf = b->local;
+    b->len = 0;
+    b->allocated = LOCAL_BUF_SIZE;
+}
+/**
+ * Free a byte buffer's heap store if it has any
+ * @param b the buffer
+ */
+static void bytes_clear( bytes *b )
+{
+    if ( b->buf != b->local )
+        free( b->buf );
+    bytes_init( b );
+}
+/**
+ * Append data to a byte buffer
+ * @param b the buffer
+ * @param data the data
+ * @param len its length
+ * @return 1 if it worked, else 0
+ */
+static int bytes_add( bytes *b, const void *data, int len )
+{
+    if ( b->len+len > b->allocated )
+    {
+        int new_size = (b->len+len)*2;
+        unsigned char *tmp = malloc( new_size );
+        if ( tmp == NULL )
+        {
+            warning("BSTIL: failed to grow buffer to %d bytes\n",new_size);
+            return 0;
+        }
+        memcpy( tmp, b->buf, b->len );
+        if ( b->buf != b->local )
+            free( b->buf );
+        b->buf = tmp;
+        b->allocated = new_size;
+    }
+    memcpy( &b->buf[b->len], data, len );
+    b->len += len;
+    return 1;
+}
+/**
+ * Append an unsigned varint: 7 bits per byte, low bits first
+ * @param b the buffer
+ * @param value the value to encode
+ * @return 1 if it worked, else 0
+ */
+static int bytes_add_varint( bytes *b, unsigned value )
+{
+    unsigned char tmp[VARINT_MAX];
+    int n = 0;
+    do
+    {
+        tmp[n] = value & 0x7F;
+        value >>= 7;
+        if ( value != 0 )
+            tmp[n] |= 0x80;
+        n++;
+    }
+    while ( value != 0 );
+    return bytes_add( b, tmp, n );
+}
+/**
+ * Append a string with its length
+ * @param b the buffer
+ * @param str the string
+ * @param len its length
+ * @return 1 if it worked, else 0
+ */
+static int bytes_add_string( bytes *b, const char *str, int len )
+{
+    return bytes_add_varint( b, len ) && bytes_add( b, str, len );
+}
+/**
+ * Append a reference to the string table, defining the string if new
+ * @param b the buffer
+ * @param str the string
+ * @return 1 if it worked, else 0
+ */
+static int bytes_add_ref( bytes *b, char *str )
+{
+    long index = (long)hashmap_get( strings, str );
+    if ( index > 0 )
+        return bytes_add_varint( b, (unsigned)(index-1)<<1 );
+    else
+    {
+        int len = strlen( str );
+        hashmap_put( strings, str, (void*)(long)(++num_strings) );
+        return bytes_add_varint( b, ((unsigned)len<<1)|1 ) 
+            && bytes_add( b, str, len );
+    }
+}
+/**
+ * Write out a byte buffer
+ * @param b the buffer
+ * @param dst the destination file
+ * @return 1 if it was all written, else 0
+ */
+static int bytes_write( bytes *b, DST_FILE *dst )
+{
+    return b->len == 0 || DST_WRITE( (char*)b->buf, b->len, dst ) == b->len;
+}
+/**
+ * Write the header information
+ * @param arg ignored optional user param
+ * @param dst the destination markup file handle
+ * @param style the name of the format style (for transformation)
+ * @return 1 if successful, 0 otherwise
+ */
+int BSTIL_write_header( void *arg, DST_FILE *dst, const char *style )
+{
+    int res;
+    bytes b;
+    unsigned char version = BSTIL_VERSION;
+    bytes_init( &b );
+    res = bytes_add( &b, BSTIL_MAGIC, BSTIL_MAGIC_LEN )
+        && bytes_add( &b, &version, 1 )
+        && bytes_add_string( &b, style, strlen(style) )
+        && bytes_write( &b, dst );
+    bytes_clear( &b );
+    return res;
+}
+/**
+ * Write the tail and forget the string table
+ * @param arg ignored optional user param
+ * @param dst the destination markup file handle
+ * @return 1 if successful, 0 otherwise
+ */
+int BSTIL_write_tail( void *arg, DST_FILE *dst )
+{
+    char end = (char)BSTIL_END;
+    if ( strings != NULL )
+    {
+        hashmap_dispose( strings );
+        strings = NULL;
+    }
+    return DST_WRITE( &end, 1, dst ) == 1;
+}
+/**
+ * Write one range. Called once per range in order.
+ * @param name the name of the range
+ * @param atts a NULL-terminated array of XML attributes
+ * @param removed 1 if the range is removed
+ * @param reloff relative offset for this range
+ * @param len length of the range
+ * @param content the contents of an empty range or NULL
+ * @param content_len length of the content
+ * @param first 1 if this is the first range
+ * @param dst the open file descriptor to write to
+ * @return 1 if successful, 0 otherwise
+ */
+int BSTIL_write_range( char *name, char **atts, int removed,
+	int reloff, int len, char *content, int content_len, int first,
+    DST_FILE *dst )
+{
+    int i,res;
+    bytes b;
+    unsigned char flags = 0;
+    if ( first || strings == NULL )
+    {
+        if ( strings != NULL )
+            hashmap_dispose( strings );
+        strings = hashmap_create();
+        num_strings = 0;
+        if ( strings == NULL )
+            return 0;
+    }
+    if ( removed )
+        flags |= BSTIL_REMOVED;
+    if ( content != NULL )
+        flags |= BSTIL_CONTENT;
+    if ( atts != NULL && atts[0] != NULL )
+        flags |= BSTIL_ANNOTATIONS;
+    bytes_init( &b );
+    // zigzag the reloff in case the ranges are out of order
+    res = bytes_add( &b, &flags, 1 )
+        && bytes_add_ref( &b, name )
+        && bytes_add_varint( &b, ((unsigned)reloff<<1)^(unsigned)(reloff>>31) )
+        && bytes_add_varint( &b, len );
+    if ( res && content != NULL )
+        res = bytes_add_string( &b, content, content_len );
+    if ( res && (flags & BSTIL_ANNOTATIONS) )
+    {
+        bytes block;
+        bytes_init( &block );
+        for ( i=0;atts[i]!=NULL;i+=2 );
+        res = bytes_add_varint( &block, i/2 );
+        for ( i=0;res&&atts[i]!=NULL;i+=2 )
+            res = bytes_add_ref( &block, atts[i] )
+                && bytes_add_string( &block, atts[i+1], strlen(atts[i+1]) );
+        if ( res )
+            res = bytes_add_varint( &b, block.len )
+                && bytes_add( &b, block.buf, block.len );
+        bytes_clear( &block );
+    }
+    if ( res )
+        res = bytes_write( &b, dst );
+    else
+        warning("BSTIL: failed to encode range %s\n",name);
+    bytes_clear( &b );
+    return res;
+}
+/**
+ * Read an unsigned varint
+ * @param data the data
+ * @param len its length
+ * @param pos VAR param the current position, updated
+ * @param value VAR param the value read
+ * @return 1 if it worked, 0 if the data was truncated
+ */
+static int read_varint( const unsigned char *data, int len, int *pos, 
+    unsigned *value )
+{
+    int shift = 0;
+    *value = 0;
+    while ( *pos < len && shift < 7*VARINT_MAX )
+    {
+        unsigned char c = data[(*pos)++];
+        *value |= (unsigned)(c & 0x7F) << shift;
+        if ( (c & 0x80) == 0 )
+            return 1;
+        shift += 7;
+    }
+    return 0;
+}
+/**
+ * Read a string with its length into an allocated copy
+ * @param data the data
+ * @param len its length
+ * @param pos VAR param the current position
+ * @param slen the length of the string
+ * @return an allocated NUL-terminated string or NULL
+ */
+static char *read_chars( const unsigned char *data, int len, int *pos, 
+    unsigned slen )
+{
+    char *str = NULL;
+    if ( slen <= (unsigned)(len-*pos) )
+    {
+        str = malloc( slen+1 );
+        if ( str != NULL )
+        {
+            memcpy( str, &data[*pos], slen );
+            str[slen] = 0;
+            *pos += slen;
+        }
+    }
+    return str;
+}
+/**
+ * Read a string reference, adding new strings to the table
+ * @param data the data
+ * @param len its length
+ * @param pos VAR param the current position
+ * @param table VAR param the string table
+ * @param n_strings VAR param the number of strings in it
+ * @param allocated VAR param the table's size
+ * @return the string (belongs to the table) or NULL
+ */
+static char *read_ref( const unsigned char *data, int len, int *pos, 
+    char ***table, int *n_strings, int *allocated )
+{
+    unsigned v;
+    if ( !read_varint(data,len,pos,&v) )
+        return NULL;
+    else if ( v & 1 )
+    {
+        char *str = read_chars( data, len, pos, v>>1 );
+        if ( str != NULL && *n_strings == *allocated )
+        {
+            int new_size = (*allocated==0)?32:*allocated*2;
+            char **tmp = realloc( *table, new_size*sizeof(char*) );
+            if ( tmp == NULL )
+            {
+                free( str );
+                return NULL;
+            }
+            *table = tmp;
+            *allocated = new_size;
+        }
+        if ( str != NULL )
+            (*table)[(*n_strings)++] = str;
+        return str;
+    }
+    else if ( (v>>1) < (unsigned)*n_strings )
+        return (*table)[v>>1];
+    else
+        return NULL;
+}
+/**
+ * Free a NULL-terminated attribute array but not its keys
+ * @param atts the array of key/value pairs
+ */
+static void free_values( char **atts )
+{
+    int i;
+    for ( i=0;atts[i]!=NULL;i+=2 )
+        free( atts[i+1] );
+    free( atts );
+}
+/**
+ * Decode BSTIL and write it out again in another format
+ * @param data the BSTIL data
+ * @param len its length
+ * @param f the format to write, e.g. STIL
+ * @param dst the destination file
+ * @return 1 if it worked, else 0
+ */
+int BSTIL_transcode( const char *data, int len, format *f, DST_FILE *dst )
+{
+    const unsigned char *d = (const unsigned char*)data;
+    char **table = NULL;
+    int n_strings = 0, allocated = 0;
+    int pos = BSTIL_MAGIC_LEN+1;
+    int res = 0,first = 1;
+    unsigned slen;
+    char *style;
+    if ( len < pos || memcmp(data,BSTIL_MAGIC,BSTIL_MAGIC_LEN)!=0 
+        || d[BSTIL_MAGIC_LEN] != BSTIL_VERSION )
+    {
+        warning("BSTIL: not BSTIL version %d\n",BSTIL_VERSION);
+        return 0;
+    }
+    if ( read_varint(d,len,&pos,&slen) 
+        && (style=read_chars(d,len,&pos,slen)) != NULL )
+    {
+        res = f->hfunc( NULL, dst, style );
+        free( style );
+    }
+    while ( res && pos < len && d[pos] != BSTIL_END )
+    {
+        unsigned flags = d[pos++];
+        unsigned reloff,rlen,clen=0,alen,count=0,i;
+        char *content = NULL;
+        char **atts = NULL;
+        char *name = read_ref( d, len, &pos, &table, &n_strings, &allocated );
+        res = name != NULL 
+            && read_varint( d, len, &pos, &reloff )
+            && read_varint( d, len, &pos, &rlen );
+        if ( res && (flags & BSTIL_CONTENT) )
+            res = read_varint( d, len, &pos, &clen )
+                && (content=read_chars(d,len,&pos,clen)) != NULL;
+        if ( res && (flags & BSTIL_ANNOTATIONS) )
+            res = read_varint( d, len, &pos, &alen )
+                && read_varint( d, len, &pos, &count ) 
+                && count < alen;
+        atts = calloc( (res?count:0)*2+1, sizeof(char*) );
+        if ( atts == NULL )
+            res = 0;
+        for ( i=0;res&&(flags&BSTIL_ANNOTATIONS)&&i<count;i++ )
+        {
+            atts[i*2] = read_ref( d, len, &pos, &table, &n_strings, 
+                &allocated );
+            res = atts[i*2] != NULL && read_varint( d, len, &pos, &slen )
+                && (atts[i*2+1]=read_chars(d,len,&pos,slen)) != NULL;
+            if ( !res )
+                atts[i*2] = NULL;
+        }
+        if ( res )
+            res = f->rfunc( name, atts, flags & BSTIL_REMOVED, 
+                (int)(reloff>>1)^-(int)(reloff&1), (int)rlen, content, 
+                (int)clen, first, dst );
+        else
+            warning("BSTIL: truncated or corrupt range at %d\n",pos);
+        first = 0;
+        if ( atts != NULL )
+            free_values( atts );
+        if ( content != NULL )
+            free( content );
+    }
+    if ( res && pos < len )
+        res = f->tfunc( NULL, dst );
+    else if ( res )
+    {
+        warning("BSTIL: missing end of ranges\n");
+        res = 0;
+    }
+    while ( n_strings > 0 )
+        free( table[--n_strings] );
+    if ( table != NULL )
+        free( table );
+    return res;
+}
+/**
+ * Encode binary data in base64 so it can go into a Java String
+ * @param data the data to encode
+ * @param len its length
+ * @return an allocated NUL-terminated string or NULL
+ */
+char *BSTIL_base64( const char *data, int len )
+{
+    static const char *alphabet = 
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const unsigned char *d = (const unsigned char*)data;
+    char *out = malloc( ((len+2)/3)*4+1 );
+    if ( out != NULL )
+    {
+        int i,j=0;
+        for ( i=0;i+2<len;i+=3 )
+        {
+            out[j++] = alphabet[d[i]>>2];
+            out[j++] = alphabet[((d[i]&3)<<4)|(d[i+1]>>4)];
+            out[j++] = alphabet[((d[i+1]&15)<<2)|(d[i+2]>>6)];
+            out[j++] = alphabet[d[i+2]&63];
+        }
+        if ( i < len )
+        {
+            out[j++] = alphabet[d[i]>>2];
+            if ( i+1 < len )
+            {
+                out[j++] = alphabet[((d[i]&3)<<4)|(d[i+1]>>4)];
+                out[j++] = alphabet[(d[i+1]&15)<<2];
+            }
+            else
+            {
+                out[j++] = alphabet[(d[i]&3)<<4];
+                out[j++] = '=';
+            }
+            out[j++] = '=';
+        }
+        out[j] = 0;
+    }
+    else
+        warning("BSTIL: failed to allocate base64 buffer\n");
+    return out;
+}
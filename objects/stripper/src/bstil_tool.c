@@ -0,0 +1,161 @@
+/*
+ * bstil_tool.c
+ *
+ *  Created on: 19/10/2026
+ */
+/* This file is part of stripper.
+ *
+ *  stripper is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  stripper is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with stripper.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * Convert markup between STIL and BSTIL without loss. The direction is 
+ * worked out from the input. Build it with buildbstil.sh.
+ */
+#ifdef BSTIL_TOOL
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "format.h"
+#include "STIL.h"
+#include "BSTIL.h"
+#include "cJSON.h"
+#include "utils.h"
+#include "memwatch.h"
+static format stil_format = {"STIL",STIL_write_header,STIL_write_tail,
+    STIL_write_range,".txt",".json","-stil",0};
+static format bstil_format = {"BSTIL",BSTIL_write_header,BSTIL_write_tail,
+    BSTIL_write_range,".txt",".bstl","-bstil",1};
+/**
+ * Convert one STIL range into the other format
+ * @param item the JSON object for the range
+ * @param f the format to write
+ * @param first 1 if this is the first range
+ * @param dst the output file
+ * @return 1 if it worked, else 0
+ */
+static int convert_range( cJSON *item, format *f, int first, FILE *dst )
+{
+    int res = 1,i = 0,n_atts = 0;
+    int removed=0,reloff=0,len=0;
+    char *name = NULL,*content = NULL;
+    char **atts;
+    cJSON *field = cJSON_GetObjectItem( item, "annotations" );
+    cJSON *a;
+    for ( a=(field!=NULL)?field->child:NULL;a!=NULL;a=a->next )
+        n_atts++;
+    atts = calloc( n_atts*2+1, sizeof(char*) );
+    if ( atts == NULL )
+        return 0;
+    for ( a=(field!=NULL)?field->child:NULL;a!=NULL;a=a->next )
+    {
+        if ( a->child != NULL && a->child->valuestring != NULL )
+        {
+            atts[i++] = a->child->string;
+            atts[i++] = a->child->valuestring;
+        }
+    }
+    for ( field=item->child;field!=NULL;field=field->next )
+    {
+        if ( strcmp(field->string,"name")==0 )
+            name = field->valuestring;
+        else if ( strcmp(field->string,"reloff")==0 )
+            reloff = field->valueint;
+        else if ( strcmp(field->string,"len")==0 )
+            len = field->valueint;
+        else if ( strcmp(field->string,"removed")==0 )
+            removed = field->type==cJSON_True;
+        else if ( strcmp(field->string,"content")==0 )
+            content = field->valuestring;
+    }
+    if ( name != NULL )
+        res = f->rfunc( name, atts, removed, reloff, len, content, 
+            (content==NULL)?0:strlen(content), first, dst );
+    else
+    {
+        fprintf(stderr,"bstil: range without a name\n");
+        res = 0;
+    }
+    free( atts );
+    return res;
+}
+/**
+ * Convert STIL to BSTIL
+ * @param data the STIL source
+ * @param dst the output file
+ * @return 1 if it worked, else 0
+ */
+static int stil_to_bstil( const char *data, FILE *dst )
+{
+    int res = 0;
+    cJSON *root = cJSON_Parse( data );
+    if ( root != NULL )
+    {
+        cJSON *style = cJSON_GetObjectItem( root, "style" );
+        cJSON *ranges = cJSON_GetObjectItem( root, "ranges" );
+        res = BSTIL_write_header( NULL, dst, 
+            (style!=NULL&&style->valuestring!=NULL)?style->valuestring:"" );
+        if ( res && ranges != NULL )
+        {
+            int first = 1;
+            cJSON *item;
+            for ( item=ranges->child;res&&item!=NULL;item=item->next )
+            {
+                res = convert_range( item, &bstil_format, first, dst );
+                first = 0;
+            }
+        }
+        if ( res )
+            res = BSTIL_write_tail( NULL, dst );
+        cJSON_Delete( root );
+    }
+    else
+        fprintf(stderr,"bstil: failed to parse STIL\n");
+    return res;
+}
+/**
+ * Convert a file in either direction
+ * @param argc number of commandline args+1
+ * @param argv array of arguments, first is program name
+ * @return 0 if it worked, else 1
+ */
+int main( int argc, char **argv )
+{
+    int res = 0;
+    if ( argc == 3 )
+    {
+        int len;
+        const char *data = read_file( argv[1], &len );
+        if ( data != NULL )
+        {
+            FILE *dst = fopen( argv[2], "w" );
+            if ( dst != NULL )
+            {
+                if ( len >= BSTIL_MAGIC_LEN 
+                    && memcmp(data,BSTIL_MAGIC,BSTIL_MAGIC_LEN)==0 )
+                    res = BSTIL_transcode( data, len, &stil_format, dst );
+                else
+                    res = stil_to_bstil( data, dst );
+                fclose( dst );
+            }
+            else
+                fprintf(stderr,"bstil: couldn't open %s\n",argv[2]);
+            free( (char*)data );
+        }
+    }
+    else
+        fprintf(stderr,"usage: bstil in-file out-file\n"
+            "converts STIL to BSTIL or BSTIL to STIL\n");
+    return (res)?0:1;
+}
+#endif
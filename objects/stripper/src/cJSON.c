@@ -33,7 +33,7 @@
 #include "cJSON.h"
 #include "memwatch.h"
 
-static const char *ep;
+static __thread const char *ep;
 
 const char *cJSON_GetErrorPtr() {return ep;}
 
@@ -8,9 +8,14 @@
 #endif
 #include "format.h"
 #include "range.h"
+#include "range_sink.h"
 #include "dest_file.h"
+#include "sort.h"
 #include "log.h"
+#include "probes.h"
 #include "hashmap.h"
+/** write files in large blocks: collections are stripped many at once */
+#define DEST_BUFFER_SIZE (1<<20)
 /**
  * Manage the contents of an output file in memory or for writing to disk.
  */
@@ -31,6 +36,10 @@ struct dest_file_struct
     range *queue_end;
     format *f;
     dest_file *next;
+    // optional consumer of closed ranges
+    range_sink *sink;
+    // if 0 don't serialise ranges in the format
+    int write_markup;
 };
 /** the output queue to straighten out the range ordering */
 /*
@@ -65,6 +74,7 @@ dest_file *dest_file_create( dest_kind kind, layer *l, char *midname,
         if ( df != NULL )
         {
             df->first = 1;
+            df->write_markup = 1;
             df->kind = kind;
             df->f = f;
             df->l = l;
@@ -142,29 +152,14 @@ static int compute_range_lengths( dest_file *df, int tlen )
     return res;
 }
 /**
- * Sort the ranges using shellsort for printing
- * @param d the dom in question
+ * Sort the ranges on start offset for printing. They are enqueued 
+ * nearly in order, so this is usually one pass.
+ * @param ra the ranges
+ * @param len their number
  */
 void range_array_sort( range **ra, int len )
 {
-    int i, j, k, h; range *v;
-    int incs[16] = { 1391376, 463792, 198768, 86961, 33936,
-        13776, 4592, 1968, 861, 336, 
-        112, 48, 21, 7, 3, 1 };
-    for ( k = 0; k < 16; k++)
-    {
-        for ( h=incs[k],i=h;i<=len-1;i++ )
-        { 
-            v = ra[i]; 
-            j = i;
-            while (j >= h && range_compare(ra[j-h],v)>0 )
-            { 
-                ra[j] = ra[j-h]; 
-                j -= h; 
-            }
-            ra[j] = v; 
-        }
-    }
+    sort_stable( (void**)ra, len, range_compare );
 }
 /**
  * Convert a list of ranges to a sorted array
@@ -208,6 +203,7 @@ static int dest_file_dequeue( dest_file *df )
     int i,res = 1;
     int len = 0;
     range **array = ranges_to_array( df->queue, &len );
+    PROBE1( dequeue__entry, len );
     if ( array != NULL )
     {
         range *r = df->queue;
@@ -215,31 +211,39 @@ static int dest_file_dequeue( dest_file *df )
         for ( i=0;i<len;i++ )
         {
             r = array[i];
-            res = df->f->rfunc( 
-                range_get_name(r),
-                range_get_atts(r),
-                range_removed(r),
-                dest_file_reloff(df,range_get_start(r)),
-                range_get_len(r),
-                range_get_content(r),
-                range_get_content_len(r),
-                dest_file_first(df), 
-                dest_file_dst(df) );
+            if ( df->write_markup )
+                res = df->f->rfunc( 
+                    range_get_name(r),
+                    range_get_atts(r),
+                    range_removed(r),
+                    dest_file_reloff(df,range_get_start(r)),
+                    range_get_len(r),
+                    range_get_content(r),
+                    range_get_content_len(r),
+                    dest_file_first(df), 
+                    dest_file_dst(df) );
+            if ( res && df->sink != NULL )
+                res = df->sink->range( df->sink->arg,
+                    range_get_name(r),
+                    range_get_atts(r),
+                    range_removed(r),
+                    range_get_start(r),
+                    range_get_len(r) );
             dest_file_set_first( df, 0 );
             range_delete( r );
             if ( !res )
             {
                 fprintf(stderr, "stripper: failed to write range" );
-                res = 0;
+                // the rest would otherwise be freed twice on dispose
+                for ( i=i+1;i<len;i++ )
+                    range_delete( array[i] );
                 break;
             }
-            if ( !res )
-                break;
         }
         free( array );
+        df->queue = df->queue_end = NULL;
     }
-    if ( res )
-        df->queue = NULL;
+    PROBE2( dequeue__return, len, res );
     return res;
 }
 /**
@@ -264,7 +268,7 @@ int dest_file_close( dest_file *df, int tlen )
         tmplog("dest_file_dequeue returned %d\n",res);
 #endif
         // write tail
-        if ( res )
+        if ( res && df->write_markup )
             res = df->f->tfunc(NULL, dest_file_dst(df) );
 #ifdef JNI        
         tmplog("df->f->tfunc returned %d\n",res);
@@ -322,6 +326,17 @@ void dest_file_set_first( dest_file *df, int value )
 {
     df->first = value;
 }
+/**
+ * Send closed ranges to a sink as well as or instead of the format
+ * @param df the dest file
+ * @param sink the sink to receive ranges when the file is closed
+ * @param write_markup if 0 don't write the ranges out in the format
+ */
+void dest_file_set_sink( dest_file *df, range_sink *sink, int write_markup )
+{
+    df->sink = sink;
+    df->write_markup = write_markup;
+}
 /**
  * Get the actual destination file
  * @param df the dest file object
@@ -373,9 +388,13 @@ int dest_file_open( dest_file *df )
 		strcat( markup, suffix );
         df->dst = fopen( markup, "w" );
         if ( df->dst == NULL )
-            fprintf( stderr,"stripper: couldn't open %s", markup );
+            fprintf( stderr,"stripper: couldn't open %s\n", markup );
         else
+        {
+            setvbuf( df->dst, NULL, _IOFBF, DEST_BUFFER_SIZE );
             res = 1;
+        }
+        free( markup );
     }
     return res;
 #endif
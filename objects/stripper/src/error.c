@@ -20,7 +20,6 @@
 #include <stdio.h>
 #include "error.h"
 #include "memwatch.h"
-static char message[256];
 /**
  * Report an error. 
  * @param fmt the format of the error message
@@ -28,6 +27,7 @@ static char message[256];
  */
 static void display_error( const char *fmt, va_list l )
 {
+    char message[256];
     vsnprintf( message, 255, fmt, l );
     fprintf( stderr, "%s", message );
 }
@@ -7,7 +7,6 @@
 #include "memwatch.h"
 #define BLOCK_SIZE 8096
 #define PRINT_LIMIT 1024
-static char buf[PRINT_LIMIT];
 struct ramfile_struct
 {
     int allocated;
@@ -88,6 +87,7 @@ int ramfile_write( ramfile *rf, const char *data, int len )
 int ramfile_print( ramfile *rf, const char *fmt, ... )
 {
     int slen,res = 1;
+    char buf[PRINT_LIMIT];
     va_list ap;
     va_start( ap, fmt );
     vsnprintf( buf, PRINT_LIMIT, fmt, ap );
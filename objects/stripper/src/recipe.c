@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include "expat.h"
+#include "xml_pool.h"
 #include "attribute.h"
 #include "simplification.h"
 #include "milestone.h"
@@ -55,8 +56,11 @@ struct recipe_struct
     simplification **rules;
     /** list of extra layers */
     layer **layers;
+    /** the number of holders besides the first */
+    int shares;
 };
-static simplification *current_rule = NULL;
+/** the rule being read, per thread so recipes can load concurrently */
+static __thread simplification *current_rule = NULL;
 /**
  * Allocate a totally empty recipe
  * @return the newly allocated recipe
@@ -289,7 +293,7 @@ static void XMLCALL end_recipe_element(void *userData,
 static recipe *recipe_load_xml( const char *buf, int len )
 {
 	recipe *r = recipe_new();
-	XML_Parser lparser = XML_ParserCreate( NULL );
+	XML_Parser lparser = xml_pool_checkout();
 	if ( lparser == NULL )
         error("recipe: failed to create parser\n");
     else
@@ -304,7 +308,7 @@ static recipe *recipe_load_xml( const char *buf, int len )
                 XML_ErrorString(XML_GetErrorCode(lparser)),
                 XML_GetCurrentLineNumber(lparser));
         }
-        XML_ParserFree( lparser );
+        xml_pool_checkin( lparser );
     }
     return r;
 }
@@ -597,13 +601,27 @@ layer *recipe_layer( recipe *r, int i )
     return r->layers[i];
 }
 /**
- * Dispose of a recipe and all its children
+ * Share a recipe with another holder, e.g. the userdata of another 
+ * thread. A recipe is only read while stripping. Each holder disposes 
+ * of it and the last one frees it.
+ * @param r the recipe
+ * @return r
+ */
+recipe *recipe_share( recipe *r )
+{
+    __atomic_fetch_add( &r->shares, 1, __ATOMIC_RELAXED );
+    return r;
+}
+/**
+ * Dispose of a recipe and all its children, once all its holders have
  * @param r the recipe
  * @return NULL;
  */
 recipe *recipe_dispose( recipe *r )
 {
     int i;
+    if ( __atomic_fetch_sub(&r->shares,1,__ATOMIC_ACQ_REL) > 0 )
+        return NULL;
     if ( r->removals != NULL )
     {
         i = 0;
@@ -0,0 +1,287 @@
+/*
+ * This file is part of stripper.
+ *
+ *  stripper is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  stripper is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with stripper.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * A stable merge sort that takes advantage of order already present. 
+ * Ranges nearly always arrive sorted or in a few sorted runs, so the 
+ * array is first cut into its natural runs, short runs being lengthened 
+ * by insertion, and then adjacent runs are merged. Merging two runs that 
+ * are already in order costs one comparison, so sorted input is linear. 
+ * Very big arrays are cut into one piece per core, sorted and merged on 
+ * several threads.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sort.h"
+#include "memwatch.h"
+/** runs shorter than this are lengthened by insertion */
+#define SORT_MIN_RUN 32
+/** the smallest array worth sorting on several threads */
+#ifndef SORT_PARALLEL_MIN
+#define SORT_PARALLEL_MIN (1<<20)
+#endif
+/** the most threads one sort will use */
+#define SORT_MAX_THREADS 16
+/** one piece of a sort or merge done on its own thread */
+typedef struct
+{
+    void **items;
+    void **tmp;
+    int lo;
+    int mid;
+    int hi;
+    sort_compare cmp;
+    int started;
+    pthread_t thread;
+} sort_job;
+/**
+ * Reverse a strictly descending run, which keeps the sort stable
+ * @param items the start of the run
+ * @param n its length
+ */
+static void sort_reverse( void **items, int n )
+{
+    int i,j;
+    for ( i=0,j=n-1;i<j;i++,j-- )
+    {
+        void *t = items[i];
+        items[i] = items[j];
+        items[j] = t;
+    }
+}
+/**
+ * Extend a sorted prefix by binary insertion, putting each new item 
+ * after any equal ones
+ * @param items the items to sort
+ * @param sorted the length of the sorted prefix
+ * @param n the number of items
+ * @param cmp the comparison function
+ */
+static void sort_insert( void **items, int sorted, int n, sort_compare cmp )
+{
+    int i;
+    for ( i=sorted;i<n;i++ )
+    {
+        void *v = items[i];
+        int bot = 0;
+        int top = i;
+        while ( bot < top )
+        {
+            int mid = (bot+top)/2;
+            if ( cmp(v,items[mid]) < 0 )
+                top = mid;
+            else
+                bot = mid+1;
+        }
+        memmove( &items[bot+1], &items[bot], (i-bot)*sizeof(void*) );
+        items[bot] = v;
+    }
+}
+/**
+ * Merge two adjacent sorted runs
+ * @param items the array containing both runs
+ * @param tmp scratch space as big as items
+ * @param lo the start of the first run
+ * @param mid the start of the second
+ * @param hi the end of the second
+ * @param cmp the comparison function
+ */
+static void sort_merge( void **items, void **tmp, int lo, int mid, int hi, 
+    sort_compare cmp )
+{
+    if ( lo < mid && mid < hi && cmp(items[mid-1],items[mid]) > 0 )
+    {
+        int i = lo,j = mid,k = lo;
+        memcpy( &tmp[lo], &items[lo], (mid-lo)*sizeof(void*) );
+        while ( i < mid && j < hi )
+        {
+            // on ties the first run goes first
+            if ( cmp(items[j],tmp[i]) < 0 )
+                items[k++] = items[j++];
+            else
+                items[k++] = tmp[i++];
+        }
+        while ( i < mid )
+            items[k++] = tmp[i++];
+    }
+}
+/**
+ * Sort part of an array by finding and merging its natural runs
+ * @param items the array
+ * @param tmp scratch space as big as items
+ * @param lo the start of the part
+ * @param hi its end
+ * @param cmp the comparison function
+ */
+static void sort_runs( void **items, void **tmp, int lo, int hi, 
+    sort_compare cmp )
+{
+    int n = hi-lo;
+    int *bounds = malloc( (n/SORT_MIN_RUN+2)*sizeof(int) );
+    if ( bounds == NULL )
+        sort_insert( &items[lo], 0, n, cmp );
+    else
+    {
+        int i = lo,nruns = 0;
+        bounds[0] = lo;
+        while ( i < hi )
+        {
+            int j = i+1;
+            int end = (hi-i>SORT_MIN_RUN)?i+SORT_MIN_RUN:hi;
+            if ( j < hi && cmp(items[i],items[j]) > 0 )
+            {
+                while ( j < hi && cmp(items[j-1],items[j]) > 0 )
+                    j++;
+                sort_reverse( &items[i], j-i );
+            }
+            else
+            {
+                while ( j < hi && cmp(items[j-1],items[j]) <= 0 )
+                    j++;
+            }
+            if ( j < end )
+            {
+                sort_insert( &items[i], j-i, end-i, cmp );
+                j = end;
+            }
+            bounds[++nruns] = j;
+            i = j;
+        }
+        while ( nruns > 1 )
+        {
+            int k,m = 0;
+            for ( k=0;k+1<nruns;k+=2 )
+            {
+                sort_merge( items, tmp, bounds[k], bounds[k+1], bounds[k+2], 
+                    cmp );
+                bounds[++m] = bounds[k+2];
+            }
+            if ( k < nruns )
+                bounds[++m] = bounds[nruns];
+            nruns = m;
+        }
+        free( bounds );
+    }
+}
+/**
+ * Sort one piece of a big array on its own thread
+ * @param arg the sort_job
+ * @return NULL
+ */
+static void *sort_piece_thread( void *arg )
+{
+    sort_job *j = arg;
+    sort_runs( j->items, j->tmp, j->lo, j->hi, j->cmp );
+    return NULL;
+}
+/**
+ * Merge two sorted pieces of a big array on its own thread
+ * @param arg the sort_job
+ * @return NULL
+ */
+static void *sort_merge_thread( void *arg )
+{
+    sort_job *j = arg;
+    sort_merge( j->items, j->tmp, j->lo, j->mid, j->hi, j->cmp );
+    return NULL;
+}
+/**
+ * Run jobs on threads, the calling thread doing the first
+ * @param jobs the jobs
+ * @param n their number
+ * @param func the thread function
+ */
+static void sort_run_jobs( sort_job *jobs, int n, void *(*func)(void*) )
+{
+    int i;
+    for ( i=1;i<n;i++ )
+        jobs[i].started = pthread_create( &jobs[i].thread, NULL, func, 
+            &jobs[i] ) == 0;
+    for ( i=0;i<n;i++ )
+    {
+        if ( i == 0 || !jobs[i].started )
+            (*func)( &jobs[i] );
+        else
+            pthread_join( jobs[i].thread, NULL );
+    }
+}
+/**
+ * Sort an array of pointers, keeping equal items in their current order
+ * @param items the array to sort
+ * @param n its length
+ * @param cmp the comparison function, as for qsort but on the pointers
+ */
+void sort_stable( void **items, int n, sort_compare cmp )
+{
+    void **tmp = (n>1)?malloc( n*sizeof(void*) ):NULL;
+    if ( tmp == NULL )
+    {
+        // stable still, but quadratic: only when memory is short
+        if ( n > 1 )
+            sort_insert( items, 0, n, cmp );
+    }
+    else
+    {
+        int pieces = 1;
+        if ( n >= SORT_PARALLEL_MIN )
+        {
+            pieces = (int)sysconf( _SC_NPROCESSORS_ONLN );
+            if ( pieces > SORT_MAX_THREADS )
+                pieces = SORT_MAX_THREADS;
+        }
+        if ( pieces > 1 )
+        {
+            sort_job jobs[SORT_MAX_THREADS];
+            int i,size = (n+pieces-1)/pieces;
+            int bounds[SORT_MAX_THREADS+1];
+            memset( jobs, 0, sizeof(jobs) );
+            for ( i=0;i<=pieces;i++ )
+                bounds[i] = (i*size<n)?i*size:n;
+            for ( i=0;i<pieces;i++ )
+            {
+                jobs[i].items = items;
+                jobs[i].tmp = tmp;
+                jobs[i].lo = bounds[i];
+                jobs[i].hi = bounds[i+1];
+                jobs[i].cmp = cmp;
+            }
+            sort_run_jobs( jobs, pieces, sort_piece_thread );
+            // merge neighbouring pieces in rounds, each pair on a thread
+            while ( pieces > 1 )
+            {
+                int k,m = 0;
+                for ( k=0;k+1<pieces;k+=2 )
+                {
+                    jobs[m].lo = bounds[k];
+                    jobs[m].mid = bounds[k+1];
+                    jobs[m].hi = bounds[k+2];
+                    m++;
+                }
+                sort_run_jobs( jobs, m, sort_merge_thread );
+                for ( k=0;k+1<pieces;k+=2 )
+                    bounds[k/2+1] = bounds[k+2];
+                if ( k < pieces )
+                    bounds[++m] = bounds[pieces];
+                pieces = (pieces+1)/2;
+            }
+        }
+        else
+            sort_runs( items, tmp, 0, n, cmp );
+        free( tmp );
+    }
+}
@@ -0,0 +1,330 @@
+/*
+ * This file is part of stripper.
+ *
+ *  stripper is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  stripper is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with stripper.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#if COMMANDLINE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include "attribute.h"
+#include "simplification.h"
+#include "milestone.h"
+#include "layer.h"
+#include "recipe.h"
+#include "hh_exceptions.h"
+#include "speller_pool.h"
+#include "stripper.h"
+#include "strip_batch.h"
+#include "utils.h"
+#include "error.h"
+#include "memwatch.h"
+#define FILE_NAME_LEN 1024
+/*
+ * Strip a whole collection: every XML file under a directory, or every
+ * file listed in a manifest, on several threads. The files are written
+ * next to each source, as for a single file. The recipe and the 
+ * hard-hyphen exceptions are read once and shared, and each thread 
+ * borrows a speller from the pool.
+ */
+#define PROGRESS_STEPS 20
+/** state shared by the strip threads */
+typedef struct
+{
+    const char *format;
+    const char *style;
+    const char *language;
+    recipe *rules;
+    hh_exceptions *hhe;
+    char **files;
+    int num_files;
+    int next_file;
+    int stripped;
+    int failed;
+    long long bytes;
+    long long start;
+    pthread_mutex_t lock;
+} strip_batch;
+/**
+ * Read the monotonic clock
+ * @return the time in nanoseconds
+ */
+static long long batch_now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (long long)ts.tv_sec*1000000000LL+ts.tv_nsec;
+}
+/**
+ * Add a file to the batch
+ * @param sb the batch
+ * @param path the path to the file
+ * @param size the allocated size of the files array, updated
+ * @return 1 if it was added, else 0
+ */
+static int batch_add( strip_batch *sb, const char *path, int *size )
+{
+    if ( sb->num_files == *size )
+    {
+        int new_size = (*size==0)?256:*size*2;
+        char **bigger = realloc( sb->files, new_size*sizeof(char*) );
+        if ( bigger == NULL )
+            return 0;
+        sb->files = bigger;
+        *size = new_size;
+    }
+    sb->files[sb->num_files] = strdup( path );
+    if ( sb->files[sb->num_files] == NULL )
+        return 0;
+    sb->num_files++;
+    return 1;
+}
+/**
+ * Is this an XML source and not the markup written by an earlier run?
+ * @param name the file name without its directory
+ * @return 1 if it should be stripped, else 0
+ */
+static int is_source( const char *name )
+{
+    int len = strlen( name );
+    return len >= 4 && strcasecmp(&name[len-4],".xml") == 0 
+        && !stripper_is_markup(name);
+}
+/**
+ * Add every XML file under a directory to the batch
+ * @param sb the batch
+ * @param dir the directory
+ * @param size the allocated size of the files array, updated
+ * @return 1 if it was read, else 0
+ */
+static int batch_add_dir( strip_batch *sb, const char *dir, int *size )
+{
+    int res = 1;
+    DIR *d = opendir( dir );
+    if ( d != NULL )
+    {
+        struct dirent *de;
+        while ( res && (de=readdir(d)) != NULL )
+        {
+            struct stat st;
+            char path[FILE_NAME_LEN];
+            if ( de->d_name[0] == '.' )
+                continue;
+            if ( snprintf(path,FILE_NAME_LEN,"%s/%s",dir,de->d_name) 
+                >= FILE_NAME_LEN )
+                warning("stripper: path too long %s/%s\n",dir,de->d_name);
+            else if ( stat(path,&st) == 0 && S_ISDIR(st.st_mode) )
+                res = batch_add_dir( sb, path, size );
+            else if ( is_source(de->d_name) )
+                res = batch_add( sb, path, size );
+        }
+        closedir( d );
+    }
+    else
+        warning("stripper: can't read directory %s\n",dir);
+    return res;
+}
+/**
+ * Add every file listed in a manifest to the batch
+ * @param sb the batch
+ * @param manifest the path to the manifest, one file per line
+ * @param size the allocated size of the files array, updated
+ * @return 1 if it was read, else 0
+ */
+static int batch_add_manifest( strip_batch *sb, const char *manifest, 
+    int *size )
+{
+    int len,res = 0;
+    char *data = (char*)read_file( manifest, &len );
+    if ( data != NULL )
+    {
+        char *save,*line = strtok_r( data, "\r\n", &save );
+        res = 1;
+        while ( res && line != NULL )
+        {
+            if ( line[0] != 0 && line[0] != '#' )
+            {
+                if ( strlen(line) >= FILE_NAME_LEN )
+                    warning("stripper: path too long %s\n",line);
+                else
+                    res = batch_add( sb, line, size );
+            }
+            line = strtok_r( NULL, "\r\n", &save );
+        }
+        free( data );
+    }
+    else
+        warning("stripper: can't read manifest %s\n",manifest);
+    return res;
+}
+/**
+ * Strip one file of a batch, as main does for a single file
+ * @param sb the batch
+ * @param src the XML file to strip
+ * @param len set to its length
+ * @return 1 if it worked, else 0
+ */
+static int batch_strip( strip_batch *sb, const char *src, int *len )
+{
+    int res = 0;
+    char barefile[FILE_NAME_LEN];
+    char *dot_pos;
+    stripper *s;
+    *len = 0;
+    strncpy( barefile, src, FILE_NAME_LEN-1 );
+    barefile[FILE_NAME_LEN-1] = 0;
+    dot_pos = strrchr( barefile, '.' );
+    if ( dot_pos != NULL && strchr(dot_pos,'/') == NULL )
+        dot_pos[0] = 0;
+    // the stripper disposes of its share of the recipe
+    s = stripper_open( barefile, sb->format, sb->style, sb->language, 
+        recipe_share(sb->rules), sb->hhe );
+    if ( s != NULL )
+    {
+        const char *data = read_file( src, len );
+        res = data != NULL && stripper_parse( s, data, *len );
+        if ( data != NULL )
+            free( (char*)data );
+        stripper_save( s );
+        stripper_dispose( s );
+    }
+    if ( !res )
+        warning("stripper: failed to strip %s\n",src);
+    return res;
+}
+/**
+ * Print how far the batch has got. Call with the lock held.
+ * @param sb the batch
+ */
+static void batch_progress( strip_batch *sb )
+{
+    int done = sb->stripped+sb->failed;
+    long long ns = batch_now()-sb->start;
+    fprintf( stderr, "stripper: %d/%d files (%d%%), %.1f MB/s\n", done,
+        sb->num_files, done*100/sb->num_files, 
+        (ns>0)?sb->bytes*1e3/ns:0.0 );
+}
+/**
+ * Strip files until there are none left
+ * @param arg the shared batch
+ * @return NULL
+ */
+static void *batch_thread( void *arg )
+{
+    strip_batch *sb = arg;
+    int step = (sb->num_files+PROGRESS_STEPS-1)/PROGRESS_STEPS;
+    while ( 1 )
+    {
+        char *src;
+        int res,len;
+        pthread_mutex_lock( &sb->lock );
+        src = (sb->next_file<sb->num_files)?sb->files[sb->next_file++]:NULL;
+        pthread_mutex_unlock( &sb->lock );
+        if ( src == NULL )
+            break;
+        res = batch_strip( sb, src, &len );
+        pthread_mutex_lock( &sb->lock );
+        if ( res )
+            sb->stripped++;
+        else
+            sb->failed++;
+        sb->bytes += len;
+        if ( (sb->stripped+sb->failed)%step == 0 
+            && sb->stripped+sb->failed < sb->num_files )
+            batch_progress( sb );
+        pthread_mutex_unlock( &sb->lock );
+    }
+    return NULL;
+}
+/**
+ * Strip every file in a directory or manifest on several threads
+ * @param dir the directory to strip or NULL
+ * @param manifest the list of files to strip, if dir is NULL
+ * @param threads the number of threads, or 0 for one per core
+ * @param format the name of the markup format
+ * @param style the style name
+ * @param language the language code for hyphenation
+ * @param rules the recipe to share, which the caller still owns
+ * @param hhe the hard-hyphen exceptions to share
+ * @return 1 if every file was stripped, else 0
+ */
+int strip_batch_run( const char *dir, const char *manifest, int threads, 
+    const char *format, const char *style, const char *language, 
+    recipe *rules, hh_exceptions *hhe )
+{
+    int i,res = 0,size = 0,started = 0;
+    strip_batch sb;
+    pthread_t *workers;
+    memset( &sb, 0, sizeof(strip_batch) );
+    sb.format = format;
+    sb.style = style;
+    sb.language = language;
+    sb.rules = rules;
+    sb.hhe = hhe;
+    // load the dictionary while we look for files
+    speller_pool_prewarm( &language, 1 );
+    if ( dir != NULL )
+        res = batch_add_dir( &sb, dir, &size );
+    else
+        res = batch_add_manifest( &sb, manifest, &size );
+    if ( threads == 0 )
+        threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    if ( threads <= 0 )
+        threads = 1;
+    if ( threads > sb.num_files && sb.num_files > 0 )
+        threads = sb.num_files;
+    workers = calloc( threads, sizeof(pthread_t) );
+    if ( res && sb.num_files > 0 && workers != NULL )
+    {
+        long long ns;
+        pthread_mutex_init( &sb.lock, NULL );
+        sb.start = batch_now();
+        for ( i=0;i<threads;i++ )
+        {
+            if ( pthread_create(&workers[i],NULL,batch_thread,&sb) != 0 )
+                break;
+            started++;
+        }
+        // if no thread started strip on this one
+        if ( started == 0 )
+            batch_thread( &sb );
+        for ( i=0;i<started;i++ )
+            pthread_join( workers[i], NULL );
+        pthread_mutex_destroy( &sb.lock );
+        ns = batch_now()-sb.start;
+        fprintf( stderr, "stripper: stripped %d, failed %d, %.1f MB in "
+            "%.2f s on %d threads (%.1f MB/s, %.0f files/s)\n", sb.stripped, 
+            sb.failed, sb.bytes/1e6, ns/1e9, threads, 
+            (ns>0)?sb.bytes*1e3/ns:0.0, 
+            (ns>0)?(sb.stripped+sb.failed)*1e9/ns:0.0 );
+        res = sb.failed == 0;
+    }
+    else if ( res && sb.num_files == 0 )
+        fprintf( stderr, "stripper: no XML files found\n" );
+    if ( workers != NULL )
+        free( workers );
+    for ( i=0;i<sb.num_files;i++ )
+        free( sb.files[i] );
+    if ( sb.files != NULL )
+        free( sb.files );
+    speller_pool_clear();
+    return res;
+}
+#endif
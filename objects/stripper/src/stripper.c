@@ -32,10 +32,13 @@
 #include "utils.h"
 #endif
 #include "format.h"
+#include "range_sink.h"
 #include "expat.h"
+#include "xml_pool.h"
 #include "stack.h"
 #include "AESE.h"
 #include "STIL.h"
+#include "BSTIL.h"
 #include "hashset.h"
 #include "error.h"
 #include "range.h"
@@ -47,11 +50,15 @@
 #include "dest_file.h"
 #include "hashmap.h"
 #include "log.h"
+#include "probes.h"
 #include "memwatch.h"
 #include "hh_exceptions.h"
 #include "userdata.h"
+#include "speller_pool.h"
+#include "stripper.h"
+#include "strip_batch.h"
 
-#define FILE_NAME_LEN 128
+#define FILE_NAME_LEN 1024
 #ifdef XML_LARGE_SIZE
 #if defined(XML_USE_MSC_EXTENSIONS) && _MSC_VER < 1400
 #define XML_FMT_INT_MOD "I64"
@@ -64,12 +71,14 @@
 
 /** array of available formats - add more here */
 static format formats[]={{"STIL",STIL_write_header,STIL_write_tail,
-    STIL_write_range,".txt",".json","-stil"},
+    STIL_write_range,".txt",".json","-stil",0},
     {"AESE",AESE_write_header,AESE_write_tail,
-    AESE_write_range,".txt",".xml","-aese"}};
+    AESE_write_range,".txt",".xml","-aese",0},
+    {"BSTIL",BSTIL_write_header,BSTIL_write_tail,
+    BSTIL_write_range,".txt",".bstl","-bstil",1}};
 /** size of formats array */
 static int num_formats = sizeof(formats)/sizeof(format);
-typedef struct 
+struct stripper_struct
 {
     userdata *user_data;
     /** source file */
@@ -92,7 +101,7 @@ typedef struct
     char *hh_except_string;
     /** the parser */
     XML_Parser parser;
-} stripper;
+};
 /**
  * Copy an array of attributes as returned by expat
  * @param atts the attributes
@@ -432,6 +441,7 @@ static XML_Char *combine_words( XML_Char *w1, XML_Char *w2 )
  */
 static void process_hyphen( userdata *u, XML_Char *text, int len )
 {
+    PROBE2( hyphen__entry, userdata_hoffset(u), len );
     XML_Char *next = first_word(text,len);
     if ( next != NULL && strlen(next)>0 )
     {
@@ -470,6 +480,7 @@ static void process_hyphen( userdata *u, XML_Char *text, int len )
     }
     if ( next != NULL )
         free( next );
+    PROBE2( hyphen__return, userdata_hoffset(u), len );
 }
 /**
  * Handle characters during stripping. We basically write
@@ -539,30 +550,33 @@ static void XMLCALL charhndl( void *userData, const XML_Char *s, int len )
 static int scan_source( const char *buf, int len, stripper *s )
 {
 	int res = 1;
+    PROBE1( scan__entry, len );
 	userdata_set_last_char_type(s->user_data, CHAR_TYPE_LF);
-    s->parser = XML_ParserCreate( NULL );
+    s->parser = xml_pool_checkout();
     if ( s->parser != NULL )
     {
         XML_SetElementHandler( s->parser, start_element_scan,
             end_element_scan );
         XML_SetCharacterDataHandler( s->parser, charhndl );
         XML_SetUserData( s->parser, s->user_data );
+        // a bad file is reported, not fatal: others may be stripping
         if ( XML_Parse(s->parser,buf,len,1) == XML_STATUS_ERROR )
         {
-            error(
+            warning(
                 "stripper: %s at line %" XML_FMT_INT_MOD "u\n",
                 XML_ErrorString(XML_GetErrorCode(s->parser)),
                 XML_GetCurrentLineNumber(s->parser));
-            return 0;
+            res = 0;
         }
-        XML_ParserFree( s->parser );
-        
+        xml_pool_checkin( s->parser );
+        s->parser = NULL;
     }
     else
     {
         fprintf(stderr,"stripper: failed to create parser\n");
         res = 0;
     }
+    PROBE2( scan__return, len, res );
 	return res;
 }
 /**
@@ -611,6 +625,99 @@ stripper *stripper_create()
         fprintf(stderr,"stripper: failed to allocate object\n");
     return s;
 }
+#ifndef JNI
+/**
+ * Make a stripper for one document and write the headers of its markup 
+ * files
+ * @param barefile the path of the files to write, minus their suffixes
+ * @param format the name of the markup format, e.g. "STIL"
+ * @param style the style name
+ * @param language the language code for hyphenation
+ * @param rules the recipe, which the stripper takes over
+ * @param hhe the hard-hyphen exceptions, which the caller still owns
+ * @return the stripper, ready to parse, or NULL
+ */
+stripper *stripper_open( const char *barefile, const char *format, 
+    const char *style, const char *language, recipe *rules, 
+    hh_exceptions *hhe )
+{
+    stripper *s = stripper_create();
+    if ( s != NULL )
+    {
+        int i = 0,res = 1;
+        s->style = (char*)style;
+        s->language = (char*)language;
+        s->selected_format = lookup_format( format );
+        if ( s->selected_format == -1 )
+        {
+            fprintf(stderr,"stripper: format %s not supported\n",format);
+            recipe_dispose( rules );
+            res = 0;
+        }
+        else
+        {
+            strncpy( s->barefile, barefile, FILE_NAME_LEN-1 );
+            s->user_data = userdata_create( s->language, s->barefile, 
+                rules, &formats[s->selected_format], hhe );
+            if ( s->user_data == NULL )
+            {
+                fprintf(stderr,"stripper: failed to initialise userdata\n");
+                res = 0;
+            }
+        }
+        while ( res && userdata_markup_dest(s->user_data,i) )
+        {
+            res = formats[s->selected_format].hfunc( NULL, 
+                dest_file_dst(userdata_markup_dest(s->user_data,i)), 
+                s->style );
+            i++;
+        }
+        if ( !res )
+        {
+            stripper_dispose( s );
+            s = NULL;
+        }
+    }
+    else
+        recipe_dispose( rules );
+    return s;
+}
+/**
+ * Parse the document of an open stripper
+ * @param s the stripper from stripper_open
+ * @param xml the XML source
+ * @param len its length in bytes
+ * @return 1 if it worked, else 0
+ */
+int stripper_parse( stripper *s, const char *xml, int len )
+{
+    return scan_source( xml, len, s );
+}
+/**
+ * Write out the text and markup files of a parsed document
+ * @param s the stripper from stripper_open
+ */
+void stripper_save( stripper *s )
+{
+    userdata_write_files( s->user_data );
+}
+/**
+ * Was a file written by the stripper as XML markup, and so not a source?
+ * @param name the file name
+ * @return 1 if it is the stripper's own output, else 0
+ */
+int stripper_is_markup( const char *name )
+{
+    int i;
+    for ( i=0;i<num_formats;i++ )
+    {
+        if ( strcmp(formats[i].markup_suffix,".xml")==0 
+            && strstr(name,formats[i].middle_name) != NULL )
+            return 1;
+    }
+    return 0;
+}
+#endif
 #ifdef JNI
 static void unload_string( JNIEnv *env, jstring jstr, const char *cstr, 
     jboolean copied )
@@ -622,6 +729,67 @@ static const char *load_string( JNIEnv *env, jstring jstr, jboolean *copied )
 {
     return (*env)->GetStringUTFChars(env, jstr, copied);  
 }
+/**
+ * Strip an XML document and hand the text and closed ranges of the 
+ * default layer straight to a sink, e.g. the formatter. This skips 
+ * writing STIL unless a copy is asked for. Exported for dlsym.
+ * @param xml the XML source
+ * @param xlen its length
+ * @param rules the recipe in XML or JSON or NULL
+ * @param rlen its length
+ * @param style the style name for a STIL copy
+ * @param language the language code for hyphenation or NULL
+ * @param hh_excepts space-delimited hard-hyphen exceptions or NULL
+ * @param sink the sink to deliver the text and ranges to
+ * @param stil if not NULL set to an allocated STIL copy of the markup
+ * @param stil_len if not NULL set to the length of the STIL copy
+ * @return 1 if it worked, else 0
+ */
+int stripper_scan( const char *xml, int xlen, const char *rules, int rlen, 
+    const char *style, const char *language, const char *hh_excepts, 
+    range_sink *sink, char **stil, int *stil_len )
+{
+    int res = 0;
+    stripper *s = stripper_create();
+    if ( s != NULL )
+    {
+        recipe *ruleset;
+        // STIL is the only format a sink copy can be made in
+        s->selected_format = lookup_format( "STIL" );
+        if ( language != NULL )
+            s->language = (char*)language;
+        if ( style != NULL )
+            s->style = (char*)style;
+        s->hh_except_string = (hh_excepts==NULL)?NULL:strdup(hh_excepts);
+        if ( rules == NULL )
+            ruleset = recipe_new();
+        else
+            ruleset = recipe_load( rules, rlen );
+        s->hh_except = hh_exceptions_create( s->hh_except_string );
+        if ( ruleset != NULL && s->hh_except != NULL )
+        {
+            s->user_data = userdata_create( s->language, s->barefile, 
+                ruleset, &formats[s->selected_format], s->hh_except );
+            if ( s->user_data != NULL )
+            {
+                res = 1;
+                if ( stil != NULL )
+                    res = formats[s->selected_format].hfunc( NULL, 
+                        dest_file_dst(userdata_markup_dest(s->user_data,0)),
+                        s->style );
+                if ( res )
+                    res = scan_source( xml, xlen, s );
+                if ( res )
+                    res = userdata_deliver( s->user_data, sink, stil, 
+                        stil_len );
+            }
+        }
+        else if ( ruleset != NULL )
+            recipe_dispose( ruleset );
+        stripper_dispose( s );
+    }
+    return res;
+}
 /*
  * Class:     calliope_AeseStripper
  * Method:    strip
@@ -698,6 +866,66 @@ JNIEXPORT jint JNICALL Java_calliope_AeseStripper_strip
     }
     return res;
 }
+/**
+ * Start loading the dictionaries named in AESE_LANGUAGES (a colon-
+ * separated list, by default the stripper's default language) as soon as 
+ * the library is loaded, so the first strip doesn't wait for aspell
+ * @param vm the Java VM
+ * @param reserved unused
+ * @return the JNI version we need
+ */
+JNIEXPORT jint JNICALL JNI_OnLoad( JavaVM *vm, void *reserved )
+{
+    const char *list = getenv( "AESE_LANGUAGES" );
+    char *copy = strdup( (list==NULL)?"en_GB":list );
+    if ( copy != NULL )
+    {
+        const char *languages[32];
+        int n = 0;
+        char *lang = strtok( copy, ":" );
+        while ( lang != NULL && n < 32 )
+        {
+            languages[n++] = lang;
+            lang = strtok( NULL, ":" );
+        }
+        speller_pool_prewarm( languages, n );
+        free( copy );
+    }
+    return JNI_VERSION_1_6;
+}
+/*
+ * Load dictionaries in the background. A strip that needs one of them 
+ * before it is ready waits for it instead of loading it again.
+ * Class:     calliope_AeseStripper
+ * Method:    prewarm
+ * Signature: ([Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_calliope_AeseStripper_prewarm
+  (JNIEnv *env, jobject obj, jobjectArray langs)
+{
+    int res = 0;
+    int i,n = (*env)->GetArrayLength( env, langs );
+    const char **languages = calloc( n+1, sizeof(char*) );
+    if ( languages != NULL )
+    {
+        for ( i=0;i<n;i++ )
+        {
+            jboolean copied;
+            jstring lang = (*env)->GetObjectArrayElement( env, langs, i );
+            const char *l_str = (lang==NULL)?NULL:load_string(env,lang,&copied);
+            languages[i] = (l_str==NULL)?NULL:strdup( l_str );
+            if ( l_str != NULL )
+                unload_string( env, lang, l_str, copied );
+            if ( languages[i] == NULL )
+                break;
+        }
+        res = speller_pool_prewarm( languages, i );
+        while ( i-- > 0 )
+            free( (char*)languages[i] );
+        free( languages );
+    }
+    return res;
+}
 /*
  * Class:     AeseStripper
  * Method:    version
@@ -735,6 +963,12 @@ JNIEXPORT jobjectArray JNICALL Java_calliope_AeseStripper_formats
 	return ret;
 }
 #elif COMMANDLINE
+/** directory to strip, or NULL */
+static char *batch_dir = NULL;
+/** manifest of files to strip, or NULL */
+static char *batch_manifest = NULL;
+/** threads for a batch, or 0 for one per core */
+static int num_threads = 0;
 /**
  * Print a simple help message. If we get time we can
  * make a man page later.
@@ -743,7 +977,9 @@ static void print_help()
 {
 	printf(
 		"usage: stripper [-h] [-v] [-s style] [-l] [-f format] "
-        "[-r recipe] XML-file\n"
+        "[-r recipe] [-e hh_exceptions] XML-file\n"
+		"       stripper [-s style] [-f format] [-r recipe] "
+        "[-e hh_exceptions] [-j threads] (-d dir | -m manifest)\n"
 		"stripper removes tags from an XML file and saves "
 			"them to a separate file\n"
 		"in a standoff markup format. The original text is "
@@ -757,6 +993,9 @@ static void print_help()
         "-e hh_exceptions ensure these space-delimited compound words ARE "
         "hyphenated\nIF both halves are words and the compound is also, e.g. safeguard\n"
 		"-r recipe-file specifying removals and simplifications in XML or JSON\n"
+		"-d dir strip every XML file in dir and its subdirectories\n"
+		"-m manifest strip every XML file listed in manifest, one per line\n"
+		"-j the number of threads for -d or -m (default: one per core)\n"
 		"XML-file the only real argument is the name of an XML "
 			"file to split.\n");
 }
@@ -844,13 +1083,25 @@ static int check_args( int argc, char **argv, stripper *s )
                         break;
                     case 'e':
                         s->hh_except_string = strdup(argv[i+1]);
+                        break;
+                    case 'd':
+                        batch_dir = argv[i+1];
+                        break;
+                    case 'm':
+                        batch_manifest = argv[i+1];
+                        break;
+                    case 'j':
+                        num_threads = atoi( argv[i+1] );
+                        sane = num_threads > 0;
                         break;
 				}
 			}
 			if ( !sane )
 				break;
 		}
-		if ( !s->doing_help )
+		if ( !s->doing_help && (batch_dir != NULL || batch_manifest != NULL) )
+			sane = (batch_dir == NULL) != (batch_manifest == NULL);
+		else if ( !s->doing_help )
 		{
 			strncpy( s->src, argv[argc-1], FILE_NAME_LEN );
 			sane = file_exists( s->src );
@@ -873,23 +1124,26 @@ static int check_args( int argc, char **argv, stripper *s )
 static void usage()
 {
 	printf( "usage: stripper [-h] [-v] [-s style] [-l] [-f format] "
-        "[-r recipe] [-e hh_exceptions] XML-file\n" );
+        "[-r recipe] [-e hh_exceptions] XML-file\n"
+		"       stripper [-s style] [-f format] [-r recipe] "
+        "[-e hh_exceptions] [-j threads] (-d dir | -m manifest)\n" );
 }
 /**
  * The main entry point
  * @param argc number of commandline args+1
  * @param argv array of arguments, first is program name
- * @return 0 to the system
+ * @return 0 to the system, or 1 if a batch had failures
  */
 int main( int argc, char **argv )
 {
+    int status = 0;
     stripper *s = stripper_create();
     if ( s != NULL )
     {
         int res = 1;
         if ( check_args(argc,argv,s) )
 		{
-            recipe *rules;
+            recipe *rules = NULL;
             if ( s->recipe_file == NULL )
                 rules = recipe_new();
             else
@@ -902,7 +1156,20 @@ int main( int argc, char **argv )
                     free( (char*)rdata );
                 }
             }
-            if ( rules != NULL )
+            if ( rules != NULL && !s->doing_help 
+                && (batch_dir != NULL || batch_manifest != NULL) )
+            {
+                hh_exceptions *hhe = hh_exceptions_create( s->hh_except_string );
+                if ( hhe == NULL || !strip_batch_run(batch_dir,
+                    batch_manifest,num_threads,
+                    formats[s->selected_format].name,s->style,
+                    s->language,rules,hhe) )
+                    status = 1;
+                recipe_dispose( rules );
+                if ( hhe != NULL )
+                    hh_exceptions_dispose( hhe );
+            }
+            else if ( rules != NULL )
             {
                 hh_exceptions *hhe = hh_exceptions_create( s->hh_except_string );
                 s->user_data = userdata_create( s->language, s->barefile, 
@@ -942,6 +1209,6 @@ int main( int argc, char **argv )
             usage();
         stripper_dispose( s );
     }
-	return 0;
+	return status;
 }
 #endif
@@ -0,0 +1,367 @@
+/*
+ * This file is part of stripper.
+ *
+ *  stripper is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  stripper is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with stripper.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#if STRIPPER_BENCH
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "format.h"
+#include "expat.h"
+#include "stack.h"
+#include "hashmap.h"
+#include "attribute.h"
+#include "simplification.h"
+#include "milestone.h"
+#include "layer.h"
+#include "recipe.h"
+#include "range.h"
+#include "range_sink.h"
+#include "dest_file.h"
+#include "hh_exceptions.h"
+#include "userdata.h"
+#include "speller_pool.h"
+#include "stripper.h"
+#include "memwatch.h"
+#define FILE_NAME_LEN 1024
+/*
+ * Time the stripper on generated TEI of increasing size, in each format,
+ * with and without a recipe, layers, hyphens and speller lookups. The
+ * output files go to one directory and are overwritten by each run.
+ */
+#define MAX_SIZES 16
+/** one way of stripping the same kind of document */
+typedef struct
+{
+    const char *name;
+    const char *recipe;
+    int hyphens;
+    int spell;
+} bench_variant;
+static bench_variant variants[] = {
+    {"plain",NULL,0,1},
+    {"recipe","{\"type\":\"stripper\",\"removals\":[\"note\",\"teiHeader\"],"
+        "\"rules\":[{\"xml_name\":\"hi\",\"prop_name\":\"italics\","
+        "\"attribute\":{\"rend\":\"italic\"}}]}",0,1},
+    {"layers","{\"type\":\"stripper\",\"removals\":[\"note\",\"teiHeader\"],"
+        "\"layers\":[{\"name\":\"pages\",\"milestones\":"
+        "[{\"xml_name\":\"pb\"}]}]}",0,1},
+    {"hyphens",NULL,1,1},
+    {"hyphens-nospell",NULL,1,0}};
+#define NUM_VARIANTS (sizeof(variants)/sizeof(bench_variant))
+static const char *bench_formats[] = {"STIL","AESE"};
+static const char *words[] = {"the","quick","brown","fox","jumps","over",
+    "lazy","dog","sea","moon","liberty","poetry","safe","guard","land",
+    "mother","queen","quiet"};
+#define NUM_WORDS (sizeof(words)/sizeof(char*))
+static int sizes[MAX_SIZES] = {65536,262144,1048576};
+static int num_sizes = 3;
+static int runs = 3;
+static char *out_dir = "/tmp";
+static char *language = "en_GB";
+/**
+ * Print a simple help message
+ */
+static void print_help()
+{
+    fprintf( stderr,
+        "usage: stripper-bench [-h] [-s size,size,...] [-n runs] "
+            "[-o dir] [-l language]\n"
+        "stripper-bench strips generated TEI and prints the throughput "
+            "as JSON.\n"
+        "Options are: \n"
+        "-h print this help message\n"
+        "-s the document sizes in bytes (default 65536,262144,1048576)\n"
+        "-n the number of runs of each, the fastest is kept (default 3)\n"
+        "-o the directory to write the stripped files to (default /tmp)\n"
+        "-l the language of the speller (default en_GB)\n");
+}
+/**
+ * Check the commandline arguments
+ * @param argc number of commandline args+1
+ * @param argv array of arguments, first is program name
+ * @return 1 if they were OK, 0 otherwise
+ */
+static int check_args( int argc, char **argv )
+{
+    int i,sane = 1;
+    for ( i=1;i<argc&&sane;i++ )
+    {
+        if ( strlen(argv[i])==2 && argv[i][0]=='-' && i<argc-1 )
+        {
+            char *arg = argv[++i];
+            switch ( argv[i-1][1] )
+            {
+                case 's':
+                {
+                    char *tok = strtok( arg, "," );
+                    num_sizes = 0;
+                    while ( tok != NULL && num_sizes < MAX_SIZES && sane )
+                    {
+                        sizes[num_sizes] = atoi( tok );
+                        sane = sizes[num_sizes++] > 0;
+                        tok = strtok( NULL, "," );
+                    }
+                    sane = sane && num_sizes > 0;
+                    break;
+                }
+                case 'n':
+                    runs = atoi( arg );
+                    sane = runs > 0;
+                    break;
+                case 'o':
+                    out_dir = arg;
+                    break;
+                case 'l':
+                    language = arg;
+                    break;
+                default:
+                    sane = 0;
+                    break;
+            }
+        }
+        else
+            sane = 0;
+    }
+    return sane;
+}
+/**
+ * Get the next pseudo-random number (xorshift)
+ * @param state the generator's state, never 0
+ * @return a number in 0..2^32-1
+ */
+static unsigned bench_rand( unsigned *state )
+{
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+/**
+ * Append to the document being generated
+ * @param doc the document
+ * @param len its length so far, updated
+ * @param size its allocated size
+ * @param fmt the format of what to add
+ */
+static void append( char *doc, int *len, int size, const char *fmt, ... )
+{
+    va_list ap;
+    va_start( ap, fmt );
+    if ( *len < size )
+    {
+        int n = vsnprintf( doc+*len, size-*len, fmt, ap );
+        *len = (*len+n<size)?*len+n:size-1;
+    }
+    va_end( ap );
+}
+/**
+ * Make a TEI document: a header, then chapters of paragraphs and line 
+ * groups with highlighting, notes and page-breaks among the words
+ * @param size roughly how many bytes to make
+ * @param hyphens 1 if some lines should end in a hyphenated word
+ * @param elements set to the number of elements, i.e. ranges
+ * @param len set to the length of the document
+ * @return the document or NULL
+ */
+static char *make_tei( int size, int hyphens, int *elements, int *len )
+{
+    int alloc = size+4096;
+    char *doc = malloc( alloc );
+    if ( doc != NULL )
+    {
+        unsigned state = 1;
+        int chapter = 0,page = 0;
+        *len = 0;
+        *elements = 6;
+        append( doc, len, alloc, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+            "\n<TEI><teiHeader><title>bench</title></teiHeader>"
+            "<text><body>\n" );
+        while ( *len < size )
+        {
+            int i,j,verse = bench_rand(&state)%4==0;
+            append( doc, len, alloc, "<head>Chapter %d</head>\n%s", 
+                chapter++, verse?"<lg>":"<p>" );
+            *elements += 2;
+            for ( i=0;i<12&&*len<size;i++ )
+            {
+                int nwords = 4+bench_rand(&state)%8;
+                if ( verse )
+                {
+                    append( doc, len, alloc, "<l>" );
+                    (*elements)++;
+                }
+                for ( j=0;j<nwords;j++ )
+                {
+                    const char *w = words[bench_rand(&state)%NUM_WORDS];
+                    switch ( bench_rand(&state)%24 )
+                    {
+                        case 0:
+                            append( doc, len, alloc, 
+                                "<hi rend=\"italic\">%s</hi> ", w );
+                            (*elements)++;
+                            break;
+                        case 1:
+                            append( doc, len, alloc, "<emph>%s</emph> ", w );
+                            (*elements)++;
+                            break;
+                        case 2:
+                            append( doc, len, alloc, "<unclear reason="
+                                "\"damage\">%s</unclear> ", w );
+                            (*elements)++;
+                            break;
+                        case 3:
+                            append( doc, len, alloc, "%s <note place="
+                                "\"foot\">a note about %s</note> ", w, w );
+                            (*elements)++;
+                            break;
+                        case 4:
+                            append( doc, len, alloc, "%s <pb n=\"%d\"/> ", 
+                                w, ++page );
+                            (*elements)++;
+                            break;
+                        default:
+                            append( doc, len, alloc, "%s ", w );
+                            break;
+                    }
+                }
+                if ( hyphens && bench_rand(&state)%3==0 )
+                    append( doc, len, alloc, "%s-\n%s\n", 
+                        words[bench_rand(&state)%NUM_WORDS],
+                        words[bench_rand(&state)%NUM_WORDS] );
+                else
+                    append( doc, len, alloc, "\n" );
+                if ( verse )
+                    append( doc, len, alloc, "</l>" );
+            }
+            append( doc, len, alloc, verse?"</lg>\n":"</p>\n" );
+        }
+        append( doc, len, alloc, "</body></text></TEI>\n" );
+    }
+    else
+        fprintf(stderr,"stripper-bench: failed to allocate document\n");
+    return doc;
+}
+/**
+ * Strip one document the way the commandline tool does
+ * @param doc the TEI document
+ * @param len its length
+ * @param fmt the name of the format
+ * @param v the variant
+ * @param scan_ns set to the time spent parsing
+ * @param write_ns set to the time spent writing the files
+ * @return 1 if it worked, else 0
+ */
+static int bench_strip( const char *doc, int len, const char *fmt, 
+    bench_variant *v, long long *scan_ns, long long *write_ns )
+{
+    int res = 0;
+    hh_exceptions *hhe = hh_exceptions_create( NULL );
+    recipe *rules = (v->recipe==NULL)?recipe_new()
+        :recipe_load(v->recipe,strlen(v->recipe));
+    if ( rules != NULL && hhe != NULL )
+    {
+        char barefile[FILE_NAME_LEN];
+        stripper *s;
+        snprintf( barefile, FILE_NAME_LEN, "%s/stripper-bench", out_dir );
+        s = stripper_open( barefile, fmt, "TEI", language, rules, hhe );
+        if ( s != NULL )
+        {
+            long long start = userdata_bench_now();
+            res = stripper_parse( s, doc, len );
+            *scan_ns = userdata_bench_now()-start;
+            start = userdata_bench_now();
+            stripper_save( s );
+            *write_ns = userdata_bench_now()-start;
+            stripper_dispose( s );
+        }
+    }
+    else if ( rules != NULL )
+        recipe_dispose( rules );
+    if ( hhe != NULL )
+        hh_exceptions_dispose( hhe );
+    return res;
+}
+/**
+ * The main entry point
+ * @param argc number of commandline args+1
+ * @param argv array of arguments, first is program name
+ * @return 0 if every run worked, else 1
+ */
+int main( int argc, char **argv )
+{
+    int i,j,k,res = 1,first = 1;
+    if ( !check_args(argc,argv) )
+    {
+        print_help();
+        return 1;
+    }
+    printf( "[\n" );
+    for ( i=0;i<num_sizes;i++ )
+    {
+        for ( k=0;k<(int)NUM_VARIANTS;k++ )
+        {
+            int len,elements;
+            bench_variant *v = &variants[k];
+            char *doc = make_tei( sizes[i], v->hyphens, &elements, &len );
+            if ( doc == NULL )
+                break;
+            for ( j=0;j<2;j++ )
+            {
+                long long best = -1,best_scan = 0,best_spell = 0;
+                int r;
+                userdata_bench_spell = v->spell;
+                for ( r=0;r<runs;r++ )
+                {
+                    long long scan_ns,write_ns;
+                    userdata_bench_spell_ns = 0;
+                    if ( !bench_strip(doc,len,bench_formats[j],v,&scan_ns,
+                        &write_ns) )
+                    {
+                        fprintf(stderr,"stripper-bench: %s %s failed\n",
+                            bench_formats[j],v->name);
+                        res = 0;
+                        break;
+                    }
+                    if ( best < 0 || scan_ns+write_ns < best )
+                    {
+                        best = scan_ns+write_ns;
+                        best_scan = scan_ns;
+                        best_spell = userdata_bench_spell_ns;
+                    }
+                }
+                if ( best > 0 )
+                {
+                    printf( "%s {\"format\": \"%s\", \"variant\": \"%s\", "
+                        "\"bytes\": %d, \"ranges\": %d, \"ns\": %lld, "
+                        "\"scan_ns\": %lld, \"mb_per_s\": %.2f, "
+                        "\"ranges_per_s\": %.0f, \"spell_share\": %.3f}",
+                        first?"":",\n", bench_formats[j], v->name, len, 
+                        elements, best, best_scan, len*1000.0/best,
+                        elements*1e9/best, (double)best_spell/best );
+                    first = 0;
+                }
+            }
+            free( doc );
+        }
+    }
+    printf( "\n]\n" );
+    speller_pool_clear();
+    return res?0:1;
+}
+#endif
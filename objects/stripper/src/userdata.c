@@ -3,6 +3,9 @@
 #include <string.h>
 #include <wchar.h>
 #include <ctype.h>
+#if STRIPPER_BENCH
+#include <time.h>
+#endif
 #ifdef JNI
 #include <jni.h>
 #include "log.h"
@@ -18,11 +21,29 @@
 #include "ramfile.h"
 #include "format.h"
 #include "range.h"
+#include "range_sink.h"
 #include "dest_file.h"
 #include "hh_exceptions.h"
 #include "userdata.h"
-#include "aspell.h"
+#include "BSTIL.h"
+#include "speller_pool.h"
 #include "utils.h"
+#if STRIPPER_BENCH
+/** stripper-bench: look words up or treat them all as known */
+int userdata_bench_spell = 1;
+/** stripper-bench: time spent in the speller */
+long long userdata_bench_spell_ns = 0;
+/**
+ * Read the monotonic clock for stripper-bench
+ * @return the time in nanoseconds
+ */
+long long userdata_bench_now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (long long)ts.tv_sec*1000000000LL+ts.tv_nsec;
+}
+#endif
 struct userdata_struct
 {
     /** flag to remove multiple white space */
@@ -50,9 +71,10 @@ struct userdata_struct
     hashmap *dest_map;
     /** hard hyphen exceptions */
     hh_exceptions *hhe;
-    /** spell check object */
-    AspellSpeller *spell_checker;
-    AspellConfig *spell_config;
+    /** the markup format */
+    format *fmt;
+    /** spell checker borrowed from the pool for the language */
+    speller *spell;
 };
 /**
  * Open the dest files
@@ -137,29 +159,17 @@ userdata *userdata_create( const char *language, char *barefile, recipe *rules,
     if ( u != NULL )
     {
         u->rules = rules;
+        u->fmt = fmt;
         if ( hhe != NULL )
             u->hhe = hhe;
-        u->spell_config = new_aspell_config();
-        if ( u->spell_config != NULL )
+        u->spell = speller_pool_checkout( language );
+        if ( u->spell == NULL )
+        {
+            fprintf(stderr,"userdata: failed to initialise speller\n");
+            err = 1;
+        }
+        else
         {
-            aspell_config_replace( u->spell_config, "lang", language );
-            AspellCanHaveError *possible_err 
-                = new_aspell_speller(u->spell_config);
-            u->spell_checker = 0;
-            if (aspell_error_number(possible_err) != 0)
-            {
-                fprintf(stderr,"%s\n",aspell_error_message(possible_err));
-                err = 1;
-            }
-            else
-            {
-                u->spell_checker = to_aspell_speller(possible_err);
-                if ( u->spell_checker == NULL )
-                {
-                    fprintf(stderr,"userdata: failed to initialise speller\n");
-                    err = 1;
-                }
-            }
             u->range_stack = stack_create();
             if ( u->range_stack == NULL )
             {
@@ -180,11 +190,6 @@ userdata *userdata_create( const char *language, char *barefile, recipe *rules,
                 fprintf(stderr,"stripper: couldn't open dest files\n");
             }
         }
-        else
-        {
-            fprintf(stderr, "userdata: failed to initialise speller\n");
-            err = 1;
-        }
     }
     else
         fprintf(stderr, "userdata:failed to allocate object\n");
@@ -209,10 +214,8 @@ void userdata_dispose( userdata *u )
             stack_delete( u->ignoring );
         if ( u->range_stack != NULL )
             stack_delete( u->range_stack );
-        if ( u->spell_config != NULL )
-            delete_aspell_config(u->spell_config);
-        if ( u->spell_checker != NULL )
-            delete_aspell_speller(u->spell_checker);
+        if ( u->spell != NULL )
+            speller_pool_checkin( u->spell );
         if ( u->last_word != NULL )
             free( u->last_word );
         if ( u->dest_map != NULL )
@@ -298,18 +301,68 @@ void userdata_write_files( JNIEnv *env, userdata *u, jobject text,
         if ( res ) 
         {
             DST_FILE *df = dest_file_dst(u->markup_dest[i]);
-            if ( i == 0 )
+            // binary markup would stop at the first NUL byte
+            char *body = (u->fmt->binary)
+                ?BSTIL_base64(ramfile_get_buf(df),ramfile_get_len(df))
+                :ramfile_get_buf(df);
+            if ( body == NULL )
+                res = 0;
+            else if ( i == 0 )
             {
-                res = set_string_field( env, markup, "body", 
-                    ramfile_get_buf(df) );
+                res = set_string_field( env, markup, "body", body );
             }
             else
             {
-                res = add_layer( env, markup, ramfile_get_buf(df) );
+                res = add_layer( env, markup, body );
+            }
+            if ( body != NULL && u->fmt->binary )
+                free( body );
+        }
+        dest_file_dispose( u->markup_dest[i++] );
+    }
+}
+/**
+ * Close the text and markup files, sending the text and the ranges of 
+ * the default layer to a sink instead of to Java objects
+ * @param u userdata
+ * @param sink the sink to receive text and ranges
+ * @param stil if not NULL set to an allocated copy of the default markup
+ * @param stil_len if not NULL set to the length of the markup copy
+ * @return 1 if it worked else 0
+ */
+int userdata_deliver( userdata *u, range_sink *sink, char **stil, 
+    int *stil_len )
+{
+    int i=0,tlen,res;
+    DST_FILE *dst;
+    dest_file_close( u->text_dest, 0 );
+    tlen = dest_file_len( u->text_dest );
+    dst = dest_file_dst( u->text_dest );
+    res = sink->text( sink->arg, ramfile_get_buf(dst), ramfile_get_len(dst) );
+    dest_file_dispose( u->text_dest );
+    u->text_dest = NULL;
+    while ( u->markup_dest[i] != NULL )
+    {
+        if ( res && i == 0 )
+        {
+            dest_file_set_sink( u->markup_dest[i], sink, stil != NULL );
+            res = dest_file_close( u->markup_dest[i], tlen );
+            if ( res && stil != NULL )
+            {
+                dst = dest_file_dst( u->markup_dest[i] );
+                *stil = strdup( ramfile_get_buf(dst) );
+                if ( *stil == NULL )
+                    res = 0;
+                else if ( stil_len != NULL )
+                    *stil_len = ramfile_get_len( dst );
             }
         }
+        // other layers are not delivered
         dest_file_dispose( u->markup_dest[i++] );
     }
+    free( u->markup_dest );
+    u->markup_dest = NULL;
+    return res;
 }
 #else
 void userdata_write_files( userdata *u )
@@ -428,9 +481,19 @@ hashmap *userdata_dest_map( userdata *u )
  */
 int userdata_has_word( userdata *u, XML_Char *word )
 {
-    int correct = aspell_speller_check(u->spell_checker, word, 
-        strlen((char*)word));
-    return correct;
+#if STRIPPER_BENCH
+    if ( userdata_bench_spell )
+    {
+        long long start = userdata_bench_now();
+        int res = speller_check( u->spell, (char*)word, strlen((char*)word) );
+        userdata_bench_spell_ns += userdata_bench_now()-start;
+        return res;
+    }
+    else
+        return 1;
+#else
+    return speller_check( u->spell, (char*)word, strlen((char*)word) );
+#endif
 }
 /**
  * Get the character offset (not byte offset!)
@@ -469,10 +532,24 @@ void userdata_set_hyphen_state( userdata *u, int hstate )
 }
 int userdata_has_hh_exception( userdata *u, char *combination )
 {
-    if ( u->hhe != NULL )
-        return hh_exceptions_lookup(u->hhe,combination);
+    if ( u->hhe != NULL && hh_exceptions_lookup(u->hhe,combination) )
+        return 1;
+#if STRIPPER_BENCH
+    else if ( userdata_bench_spell )
+    {
+        long long start = userdata_bench_now();
+        int res = speller_is_hh_exception( u->spell, combination, 
+            strlen(combination) );
+        userdata_bench_spell_ns += userdata_bench_now()-start;
+        return res;
+    }
     else
         return 0;
+#else
+    else
+        return speller_is_hh_exception( u->spell, combination, 
+            strlen(combination) );
+#endif
 }
 /**
  * Duplicate the last word of a text fragment
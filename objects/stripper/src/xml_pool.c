@@ -0,0 +1,102 @@
+/*
+ * This file is part of stripper.
+ *
+ *  stripper is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  stripper is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with stripper.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <pthread.h>
+#include "expat.h"
+#include "xml_pool.h"
+#include "memwatch.h"
+/** the most idle parsers a thread keeps */
+#define XML_POOL_SIZE 4
+/**
+ * Creating an expat parser allocates its hash tables, name pools and 
+ * buffers, which costs more than parsing a small layer or recipe. So 
+ * each thread keeps the parsers it has finished with, reset but with 
+ * their memory intact. Handlers and user data are cleared by the reset, 
+ * so the caller binds them again after each checkout. A stack rather 
+ * than a single parser lets a handler parse a nested document.
+ */
+typedef struct
+{
+    int n;
+    XML_Parser idle[XML_POOL_SIZE];
+} xml_pool;
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+/**
+ * Free a thread's idle parsers when it exits
+ * @param arg the thread's xml_pool
+ */
+static void pool_dispose( void *arg )
+{
+    xml_pool *p = arg;
+    int i;
+    for ( i=0;i<p->n;i++ )
+        XML_ParserFree( p->idle[i] );
+    free( p );
+}
+/**
+ * Make the key for the per-thread pools, once per process
+ */
+static void pool_init()
+{
+    pthread_key_create( &pool_key, pool_dispose );
+}
+/**
+ * Get the calling thread's pool, creating it on first use
+ * @return the pool or NULL if it couldn't be allocated
+ */
+static xml_pool *pool_get()
+{
+    xml_pool *p;
+    pthread_once( &pool_once, pool_init );
+    p = pthread_getspecific( pool_key );
+    if ( p == NULL )
+    {
+        p = calloc( 1, sizeof(xml_pool) );
+        if ( p != NULL && pthread_setspecific(pool_key,p) != 0 )
+        {
+            free( p );
+            p = NULL;
+        }
+    }
+    return p;
+}
+/**
+ * Borrow a parser with no handlers set
+ * @return a fresh or recycled parser or NULL if none could be made
+ */
+XML_Parser xml_pool_checkout()
+{
+    xml_pool *p = pool_get();
+    if ( p != NULL && p->n > 0 )
+        return p->idle[--p->n];
+    else
+        return XML_ParserCreate( NULL );
+}
+/**
+ * Give back a parser from xml_pool_checkout, on the same thread
+ * @param parser the parser, which the caller must not use again
+ */
+void xml_pool_checkin( XML_Parser parser )
+{
+    xml_pool *p = pool_get();
+    if ( p != NULL && p->n < XML_POOL_SIZE 
+        && XML_ParserReset(parser,NULL) )
+        p->idle[p->n++] = parser;
+    else
+        XML_ParserFree( parser );
+}